@@ -0,0 +1,377 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	ArrowTable.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Building tables from and encoding Apache Arrow arrays and Parquet files
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _ARROWTABLE_H
+#define _ARROWTABLE_H
+
+// Optional; needs Arrow and Parquet (C++17, or C++20 for Arrow 23 and later). Build with cmake -DPPH_ARROW=ON.
+// Like pph.h, include it from one translation unit only.
+//
+// Keys are read from the offsets and data buffers of string and binary
+// arrays (utf8, large_utf8, binary, large_binary) in place, without a
+// std::string per key. load_table() builds a Table whose values are the
+// positions of the keys in the array. ArrowEncoder maps string arrays to
+// UInt32 or UInt64 arrays of values, or to dictionary arrays whose
+// dictionary is the keys of the table in the order of their values;
+// values that are not keys, and nulls, become nulls. encode_parquet()
+// does the same to columns of a Parquet file, one row group at a time.
+
+#include "pph.h"
+
+#include <arrow/api.h>
+#include <arrow/io/file.h>
+#include <arrow/util/config.h>
+#include <parquet/arrow/reader.h>
+#include <parquet/arrow/writer.h>
+
+namespace pph {
+
+typedef enum _arrow_encoding {
+  ARROW_ENCODE_UINT32,
+  ARROW_ENCODE_UINT64,
+  ARROW_ENCODE_DICTIONARY
+} arrow_encoding_t;
+
+static const char* const ARROW_ENCODING_NAMES[] = {"uint32", "uint64", "dictionary"};
+
+// Calls f(keys, lengths, count, first) for the strings of array in batches
+// of at most SIMD_GROUP_SIZE; keys point into the data buffer of the array
+// and null entries have length 0
+template<typename ArrayType, typename F>
+inline void arrow_for_each_batch(const ArrayType& array, F f) {
+  const auto* offsets = array.raw_value_offsets();
+  const char* data    = reinterpret_cast<const char*>(array.raw_data());
+  const char* keys[SIMD_GROUP_SIZE];
+  size_t      lengths[SIMD_GROUP_SIZE];
+
+  for (int64_t first = 0; first < array.length(); first += SIMD_GROUP_SIZE) {
+    size_t count = static_cast<size_t>(std::min<int64_t>(SIMD_GROUP_SIZE, array.length() - first));
+
+    for (size_t i = 0; i < count; i++) {
+      keys[i]    = data + offsets[first + i];
+      lengths[i] = static_cast<size_t>(offsets[first + i + 1] - offsets[first + i]);
+    }
+
+    f(keys, lengths, count, first);
+  }
+}
+
+// Dispatches on the type of array: f(const BinaryArray&) or f(const LargeBinaryArray&)
+template<typename F>
+inline arrow::Status arrow_visit_strings(const arrow::Array& array, F f) {
+  switch (array.type_id()) {
+    case arrow::Type::STRING:
+    case arrow::Type::BINARY:
+      return f(static_cast<const arrow::BinaryArray&>(array));
+    case arrow::Type::LARGE_STRING:
+    case arrow::Type::LARGE_BINARY:
+      return f(static_cast<const arrow::LargeBinaryArray&>(array));
+    default:
+      return arrow::Status::TypeError("pph: keys must be a string or binary array, not ",
+                                      array.type()->ToString());
+  }
+}
+
+// Loads the keys of the chunks into table, after table.setup() with their
+// total length; the value of a key is its position. Keys must not be null.
+inline arrow::Status load_table(Table& table, const arrow::ChunkedArray& keys) {
+  std::vector<const char*> ptrs;
+  std::vector<size_t>      lengths;
+
+  ptrs.reserve(keys.length());
+  lengths.reserve(keys.length());
+
+  for (const auto& chunk : keys.chunks()) {
+    if (chunk->null_count() != 0) {
+      return arrow::Status::Invalid("pph: keys must not be null");
+    }
+
+    ARROW_RETURN_NOT_OK(arrow_visit_strings(*chunk, [&](const auto& strings) {
+      arrow_for_each_batch(strings, [&](const char* const* k, const size_t* len, size_t count, int64_t) {
+        ptrs.insert(ptrs.end(), k, k + count);
+        lengths.insert(lengths.end(), len, len + count);
+      });
+      return arrow::Status::OK();
+    }));
+  }
+
+  std::vector<uint64_t> values(ptrs.size());
+
+  std::iota(values.begin(), values.end(), 0);
+
+  if (!table.load(ptrs.data(), lengths.data(), values.data(), ptrs.size())) {
+    return arrow::Status::Invalid("pph: building the table failed (duplicate keys or timeout)");
+  }
+
+  return arrow::Status::OK();
+}
+
+inline arrow::Status load_table(Table& table, const arrow::Array& keys) {
+  return load_table(table, arrow::ChunkedArray(arrow::ArrayVector{arrow::MakeArray(keys.data())}));
+}
+
+class ArrowEncoder {
+public:
+  ArrowEncoder(const FrozenTable& table, arrow_encoding_t encoding,
+               arrow::MemoryPool* pool = arrow::default_memory_pool()) :
+    table_(table), encoding_(encoding), pool_(pool), misses_(0) {}
+
+  // Type of the encoded arrays
+  std::shared_ptr<arrow::DataType> type() const {
+    switch (encoding_) {
+      case ARROW_ENCODE_UINT32:
+        return arrow::uint32();
+      case ARROW_ENCODE_UINT64:
+        return arrow::uint64();
+      default:
+        return arrow::dictionary(index_type(), arrow::utf8());
+    }
+  }
+
+  // Values of the strings; nulls for nulls and strings that are not keys
+  arrow::Result<std::shared_ptr<arrow::Array>> encode(const arrow::Array& strings) {
+    std::shared_ptr<arrow::Array> values;
+
+    if ((encoding_ == ARROW_ENCODE_UINT32) ||
+        ((encoding_ == ARROW_ENCODE_DICTIONARY) && (index_type()->id() == arrow::Type::INT32))) {
+      ARROW_ASSIGN_OR_RAISE(values, encode_values<uint32_t>(strings));
+    } else {
+      ARROW_ASSIGN_OR_RAISE(values, encode_values<uint64_t>(strings));
+    }
+
+    if (encoding_ != ARROW_ENCODE_DICTIONARY) {
+      return values;
+    }
+
+    if (dictionary_ == nullptr) {
+      ARROW_ASSIGN_OR_RAISE(dictionary_, make_dictionary());
+    }
+
+    // the values are the indices; they were checked to be below the size
+    std::shared_ptr<arrow::ArrayData> indices = values->data()->Copy();
+
+    indices->type = index_type();
+
+    return arrow::DictionaryArray::FromArrays(type(), arrow::MakeArray(indices), dictionary_);
+  }
+
+  arrow::Result<std::shared_ptr<arrow::ChunkedArray>> encode(const arrow::ChunkedArray& strings) {
+    arrow::ArrayVector chunks;
+
+    for (const auto& chunk : strings.chunks()) {
+      ARROW_ASSIGN_OR_RAISE(auto encoded, encode(*chunk));
+      chunks.push_back(encoded);
+    }
+
+    return std::make_shared<arrow::ChunkedArray>(chunks, type());
+  }
+
+  // Non-null strings that were not keys
+  uint64_t misses() const {
+    return misses_;
+  }
+
+private:
+  std::shared_ptr<arrow::DataType> index_type() const {
+    return (table_.size() <= static_cast<uint64_t>(INT32_MAX)) ? arrow::int32() : arrow::int64();
+  }
+
+  template<typename T>
+  arrow::Result<std::shared_ptr<arrow::Array>> encode_values(const arrow::Array& strings) {
+    const int64_t length = strings.length();
+
+    ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Buffer> values,
+                          arrow::AllocateBuffer(length * sizeof(T), pool_));
+    ARROW_ASSIGN_OR_RAISE(std::shared_ptr<arrow::Buffer> validity,
+                          arrow::AllocateBuffer((length + 7) / 8, pool_));
+
+    T*       out   = reinterpret_cast<T*>(values->mutable_data());
+    uint8_t* valid = validity->mutable_data();
+    int64_t  nulls = 0;
+    bool     fits  = true;
+
+    std::memset(valid, 0, static_cast<size_t>(validity->size()));
+
+    ARROW_RETURN_NOT_OK(arrow_visit_strings(strings, [&](const auto& array) {
+      arrow_for_each_batch(array, [&](const char* const* k, const size_t* len, size_t count, int64_t first) {
+        uint64_t vals[SIMD_GROUP_SIZE];
+
+        table_.find_vals(k, len, count, vals);
+
+        for (size_t i = 0; i < count; i++) {
+          int64_t j = first + static_cast<int64_t>(i);
+
+          if (array.IsNull(j) || table_.notfound_val(vals[i])) {
+            misses_ += array.IsNull(j) ? 0 : 1;
+            out[j]   = 0;
+            nulls++;
+            continue;
+          }
+
+          fits = fits && (vals[i] <= std::numeric_limits<T>::max()) &&
+                 ((encoding_ != ARROW_ENCODE_DICTIONARY) || (vals[i] < table_.size()));
+
+          out[j] = static_cast<T>(vals[i]);
+          valid[j >> 3] |= static_cast<uint8_t>(1 << (j & 7));
+        }
+      });
+      return arrow::Status::OK();
+    }));
+
+    if (!fits) {
+      return arrow::Status::Invalid("pph: a value of the table does not fit the ",
+                                    ARROW_ENCODING_NAMES[encoding_], " encoding");
+    }
+
+    std::shared_ptr<arrow::DataType> type = (sizeof(T) == 4) ? arrow::uint32() : arrow::uint64();
+
+    return arrow::MakeArray(arrow::ArrayData::Make(type, length, {validity, values}, nulls));
+  }
+
+  // The keys in the order of their values, which must be 0..n-1
+  arrow::Result<std::shared_ptr<arrow::Array>> make_dictionary() const {
+    std::vector<std::pair<const char*, size_t> > keys(table_.size(), std::make_pair(nullptr, 0));
+    bool dense = true;
+
+    table_.for_each([&](const char* key, size_t len, uint64_t val) {
+      if (val < keys.size()) {
+        keys[val] = std::make_pair(key, len);
+      } else {
+        dense = false;
+      }
+    });
+
+    if (!dense) {
+      return arrow::Status::Invalid("pph: dictionary encoding needs values 0..n-1");
+    }
+
+    arrow::StringBuilder builder(pool_);
+
+    for (const auto& key : keys) {
+      ARROW_RETURN_NOT_OK(builder.Append(key.first, static_cast<int32_t>(key.second)));
+    }
+
+    std::shared_ptr<arrow::Array> dictionary;
+
+    ARROW_RETURN_NOT_OK(builder.Finish(&dictionary));
+
+    return dictionary;
+  }
+
+  const FrozenTable&            table_;
+  arrow_encoding_t              encoding_;
+  arrow::MemoryPool*            pool_;
+  uint64_t                      misses_;
+  std::shared_ptr<arrow::Array> dictionary_;
+};
+
+// Arrow 24 replaced the reads into out parameters with ones returning Results
+inline arrow::Result<std::shared_ptr<arrow::Table>> parquet_read_table(parquet::arrow::FileReader& reader,
+                                                                       int row_group = -1) {
+#if ARROW_VERSION_MAJOR >= 24
+  return (row_group < 0) ? reader.ReadTable() : reader.ReadRowGroup(row_group);
+#else
+  std::shared_ptr<arrow::Table> table;
+
+  ARROW_RETURN_NOT_OK((row_group < 0) ? reader.ReadTable(&table) : reader.ReadRowGroup(row_group, &table));
+
+  return table;
+#endif
+}
+
+// Reads a Parquet file into an Arrow table
+inline arrow::Result<std::shared_ptr<arrow::Table>> read_parquet(const std::string& path) {
+  ARROW_ASSIGN_OR_RAISE(auto input, arrow::io::ReadableFile::Open(path));
+
+  parquet::arrow::FileReaderBuilder           builder;
+  std::unique_ptr<parquet::arrow::FileReader> reader;
+
+  ARROW_RETURN_NOT_OK(builder.Open(input));
+  ARROW_RETURN_NOT_OK(builder.Build(&reader));
+
+  return parquet_read_table(*reader);
+}
+
+inline arrow::Status write_parquet(const arrow::Table& table, const std::string& path) {
+  ARROW_ASSIGN_OR_RAISE(auto output, arrow::io::FileOutputStream::Open(path));
+  ARROW_RETURN_NOT_OK(parquet::arrow::WriteTable(table, arrow::default_memory_pool(), output));
+  return output->Close();
+}
+
+// Writes input to output with the named columns encoded, one row group at
+// a time; returns the number of non-null values that were not keys
+inline arrow::Result<uint64_t> encode_parquet(const FrozenTable& table, const std::string& input,
+                                              const std::string& output,
+                                              const std::vector<std::string>& columns,
+                                              arrow_encoding_t encoding) {
+  ARROW_ASSIGN_OR_RAISE(auto in, arrow::io::ReadableFile::Open(input));
+
+  parquet::arrow::FileReaderBuilder           builder;
+  std::unique_ptr<parquet::arrow::FileReader> reader;
+  std::shared_ptr<arrow::Schema>              schema;
+
+  ARROW_RETURN_NOT_OK(builder.Open(in));
+  ARROW_RETURN_NOT_OK(builder.Build(&reader));
+  ARROW_RETURN_NOT_OK(reader->GetSchema(&schema));
+
+  ArrowEncoder     encoder(table, encoding);
+  std::vector<int> indices;
+
+  for (const std::string& column : columns) {
+    int i = schema->GetFieldIndex(column);
+
+    if (i < 0) {
+      return arrow::Status::KeyError("pph: no column '", column, "' in ", input);
+    }
+
+    indices.push_back(i);
+    ARROW_ASSIGN_OR_RAISE(schema, schema->SetField(i, schema->field(i)->WithType(encoder.type())));
+  }
+
+  ARROW_ASSIGN_OR_RAISE(auto out, arrow::io::FileOutputStream::Open(output));
+  ARROW_ASSIGN_OR_RAISE(auto writer,
+                        parquet::arrow::FileWriter::Open(*schema, arrow::default_memory_pool(), out));
+
+  for (int g = 0; g < reader->num_row_groups(); g++) {
+    ARROW_ASSIGN_OR_RAISE(auto group, parquet_read_table(*reader, g));
+
+    for (int i : indices) {
+      ARROW_ASSIGN_OR_RAISE(auto encoded, encoder.encode(*group->column(i)));
+      ARROW_ASSIGN_OR_RAISE(group, group->SetColumn(i, schema->field(i), encoded));
+    }
+
+    ARROW_RETURN_NOT_OK(writer->WriteTable(*group, group->num_rows()));
+  }
+
+  ARROW_RETURN_NOT_OK(writer->Close());
+  ARROW_RETURN_NOT_OK(out->Close());
+
+  return encoder.misses();
+}
+
+}  // namespace pph
+
+#endif  // _ARROWTABLE_H
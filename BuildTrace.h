@@ -0,0 +1,264 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	BuildTrace.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Trace of the construction of a table
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _BUILDTRACE_H
+#define _BUILDTRACE_H
+
+// A BuildTrace attached to a Table (Table::set_trace) records one event
+// per inserted key: the bucket it went to, how hard it was to find a hash
+// function for the grown bucket, and how far find_r() had to search D_
+// for room. write_json() adds a summary per bucket; write_chrome() writes
+// the events in the Chrome trace event format (chrome://tracing, Perfetto).
+
+typedef struct _trace_event {
+  _trace_event() : val_(0), bucket_(0), keys_(0), r_(0), candidates_(0),
+                   attempts_(0), reused_(false), scan_(0), grown_(0),
+                   start_ns_(0), duration_ns_(0), ok_(false) {}
+
+  std::string key_;
+  uint64_t    val_;
+  // h(k) of the key
+  uint64_t    bucket_;
+  // keys in the bucket after the insert (the ideal r)
+  uint64_t    keys_;
+  // slots of the bucket after the insert
+  uint64_t    r_;
+  // existing functions in func_ that were tried
+  uint64_t    candidates_;
+  // new functions that were tried
+  uint64_t    attempts_;
+  // an existing function was reused
+  bool        reused_;
+  // slots of D_ examined by find_r()
+  uint64_t    scan_;
+  // slots find_r() added to D_
+  uint64_t    grown_;
+  // from the start of the build
+  uint64_t    start_ns_;
+  uint64_t    duration_ns_;
+  bool        ok_;
+} trace_event_t;
+
+// Parameters and outcome of the build
+typedef struct _trace_build {
+  _trace_build() : n_(0), s_(0), p_(0), seed_(0), multiplier_(0), adjustment_(0),
+                   slots_(0), funcs_(0), duration_ns_(0), ok_(false) {}
+
+  uint64_t    n_;
+  uint64_t    s_;
+  double      p_;
+  uint64_t    seed_;
+  uint64_t    multiplier_;
+  uint64_t    adjustment_;
+  std::string uuid_;
+  uint64_t    slots_;
+  uint64_t    funcs_;
+  uint64_t    duration_ns_;
+  bool        ok_;
+} trace_build_t;
+
+inline std::string json_string(const std::string& s) {
+  std::ostringstream stream;
+
+  stream << '"';
+
+  for (unsigned char c : s) {
+    if ((c == '"') || (c == '\\')) {
+      stream << '\\' << c;
+    } else if (c < 0x20) {
+      stream << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(c)
+             << std::dec << std::setfill(' ');
+    } else {
+      stream << c;
+    }
+  }
+
+  stream << '"';
+
+  return stream.str();
+}
+
+class BuildTrace {
+public:
+  BuildTrace() : start_(0) {}
+
+  void begin(const trace_build_t& build) {
+    build_ = build;
+    start_ = stats_clock();
+    events_.clear();
+  }
+
+  void end(bool ok, uint64_t slots, uint64_t funcs) {
+    build_.ok_          = ok;
+    build_.slots_       = slots;
+    build_.funcs_       = funcs;
+    build_.duration_ns_ = stats_clock() - start_;
+  }
+
+  // Nanoseconds since begin()
+  uint64_t now() const {
+    return stats_clock() - start_;
+  }
+
+  void add(const trace_event_t& event) {
+    events_.push_back(event);
+  }
+
+  const trace_build_t& build() const {
+    return build_;
+  }
+
+  const std::vector<trace_event_t>& events() const {
+    return events_;
+  }
+
+  bool write_json(std::ostream& ostr) const {
+    ostr << "{" << std::endl;
+    ostr << "  \"build\": ";
+    write_build(ostr);
+    ostr << "," << std::endl;
+
+    // one entry per bucket that was inserted into, in bucket order
+
+    std::map<uint64_t, std::vector<size_t> > buckets;
+
+    for (size_t e = 0; e < events_.size(); e++) {
+      buckets[events_[e].bucket_].push_back(e);
+    }
+
+    ostr << "  \"buckets\": [";
+
+    bool first = true;
+
+    for (const auto& bucket : buckets) {
+      const trace_event_t& last = events_[bucket.second.back()];
+      uint64_t attempts = 0;
+      uint64_t reused   = 0;
+      uint64_t scan     = 0;
+      uint64_t time     = 0;
+
+      for (size_t e : bucket.second) {
+        attempts += events_[e].attempts_;
+        reused   += events_[e].reused_ ? 1 : 0;
+        scan     += events_[e].scan_;
+        time     += events_[e].duration_ns_;
+      }
+
+      ostr << (first ? "" : ",") << std::endl;
+      ostr << "    {\"bucket\": " << bucket.first
+           << ", \"keys\": " << last.keys_
+           << ", \"r\": " << last.r_
+           << ", \"ideal_r\": " << last.keys_
+           << ", \"inserts\": " << bucket.second.size()
+           << ", \"attempts\": " << attempts
+           << ", \"reused\": " << reused
+           << ", \"scan\": " << scan
+           << ", \"time_ns\": " << time
+           << ", \"ok\": " << (last.ok_ ? "true" : "false") << "}";
+
+      first = false;
+    }
+
+    ostr << std::endl << "  ]," << std::endl;
+
+    ostr << "  \"events\": [";
+
+    for (size_t e = 0; e < events_.size(); e++) {
+      ostr << ((e == 0) ? "" : ",") << std::endl << "    ";
+      write_event(ostr, events_[e]);
+    }
+
+    ostr << std::endl << "  ]" << std::endl;
+    ostr << "}" << std::endl;
+
+    return ostr.good();
+  }
+
+  bool write_chrome(std::ostream& ostr) const {
+    ostr << "{" << std::endl;
+    ostr << "  \"displayTimeUnit\": \"ns\"," << std::endl;
+    ostr << "  \"otherData\": ";
+    write_build(ostr);
+    ostr << "," << std::endl;
+    ostr << "  \"traceEvents\": [" << std::endl;
+    ostr << "    {\"name\": \"build\", \"cat\": \"pph\", \"ph\": \"X\", \"pid\": 1, \"tid\": 1"
+         << ", \"ts\": 0, \"dur\": " << (build_.duration_ns_ / 1000.0) << "}";
+
+    for (const trace_event_t& event : events_) {
+      ostr << "," << std::endl;
+      ostr << "    {\"name\": \"bucket " << event.bucket_ << "\", \"cat\": \"insert\", \"ph\": \"X\""
+           << ", \"pid\": 1, \"tid\": 1"
+           << ", \"ts\": " << (event.start_ns_ / 1000.0)
+           << ", \"dur\": " << (event.duration_ns_ / 1000.0)
+           << ", \"args\": ";
+      write_event(ostr, event);
+      ostr << "}";
+    }
+
+    ostr << std::endl << "  ]" << std::endl;
+    ostr << "}" << std::endl;
+
+    return ostr.good();
+  }
+
+private:
+  void write_build(std::ostream& ostr) const {
+    ostr << "{\"n\": " << build_.n_
+         << ", \"s\": " << build_.s_
+         << ", \"p\": " << build_.p_
+         << ", \"seed\": " << build_.seed_
+         << ", \"multiplier\": " << build_.multiplier_
+         << ", \"adjustment\": " << build_.adjustment_
+         << ", \"uuid\": " << json_string(build_.uuid_)
+         << ", \"slots\": " << build_.slots_
+         << ", \"functions\": " << build_.funcs_
+         << ", \"time_ns\": " << build_.duration_ns_
+         << ", \"ok\": " << (build_.ok_ ? "true" : "false") << "}";
+  }
+
+  void write_event(std::ostream& ostr, const trace_event_t& event) const {
+    ostr << "{\"key\": " << json_string(event.key_)
+         << ", \"val\": " << event.val_
+         << ", \"bucket\": " << event.bucket_
+         << ", \"keys\": " << event.keys_
+         << ", \"r\": " << event.r_
+         << ", \"ideal_r\": " << event.keys_
+         << ", \"candidates\": " << event.candidates_
+         << ", \"attempts\": " << event.attempts_
+         << ", \"reused\": " << (event.reused_ ? "true" : "false")
+         << ", \"scan\": " << event.scan_
+         << ", \"grown\": " << event.grown_
+         << ", \"start_ns\": " << event.start_ns_
+         << ", \"time_ns\": " << event.duration_ns_
+         << ", \"ok\": " << (event.ok_ ? "true" : "false") << "}";
+  }
+
+  trace_build_t              build_;
+  uint64_t                   start_;
+  std::vector<trace_event_t> events_;
+};
+
+#endif  // _BUILDTRACE_H
@@ -0,0 +1,117 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	CaseFold.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	ASCII case folding for case-insensitive tables
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _CASEFOLD_H
+#define _CASEFOLD_H
+
+// Tables with set_fold_case(true) store their keys with 'A' to 'Z' folded
+// to lower case and fold each key they look up the same way, so "Select",
+// "SELECT" and "select" find the same key. Other bytes, including UTF-8,
+// are left as they are. Folding works on 8 bytes at a time with integer
+// operations only (no table, no branch per byte), which compilers turn
+// into vector code for long keys.
+
+static constexpr uint64_t FOLD_ONES  = UINT64_C(0x0101010101010101);
+static constexpr uint64_t FOLD_HIGH  = UINT64_C(0x8080808080808080);
+
+// Keys of a batch are folded into a buffer on the stack when they fit
+static constexpr size_t   FOLD_BUFFER_SIZE = 4096;
+
+// Adds 0x20 to the bytes of x from 'A' to 'Z'
+inline uint64_t fold_word(uint64_t x) {
+  uint64_t low7  = x & ~FOLD_HIGH;
+  // high bit set in bytes >= 'A', and in bytes > 'Z'
+  uint64_t ge_a  = low7 + (0x80 - 'A') * FOLD_ONES;
+  uint64_t gt_z  = low7 + (0x7F - 'Z') * FOLD_ONES;
+  uint64_t upper = (ge_a ^ gt_z) & ~x & FOLD_HIGH;
+
+  return x | (upper >> 2);
+}
+
+inline char fold_char(char c) {
+  return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c + ('a' - 'A')) : c;
+}
+
+// dst may be src
+inline void fold_ascii(const char* src, size_t len, char* dst) {
+  size_t i = 0;
+
+  for (; i + 8 <= len; i += 8) {
+    uint64_t word;
+    std::memcpy(&word, src + i, sizeof(word));
+    word = fold_word(word);
+    std::memcpy(dst + i, &word, sizeof(word));
+  }
+
+  for (; i < len; i++) {
+    dst[i] = fold_char(src[i]);
+  }
+}
+
+inline void fold_ascii(std::string& str) {
+  if (!str.empty()) {
+    fold_ascii(&str[0], str.size(), &str[0]);
+  }
+}
+
+// Folded copies of a batch of at most SIMD_GROUP_SIZE keys
+class FoldedKeys {
+public:
+  FoldedKeys() : data_(buffer_) {}
+
+  void fold(const char* const* keys, const size_t* lengths, size_t count) {
+    size_t total = 0;
+
+    for (size_t i = 0; i < count; i++) {
+      total += lengths[i];
+    }
+
+    data_ = buffer_;
+
+    // only batches of long keys allocate
+    if (total > FOLD_BUFFER_SIZE) {
+      overflow_.resize(total);
+      data_ = overflow_.data();
+    }
+
+    for (size_t i = 0, offset = 0; i < count; offset += lengths[i], i++) {
+      fold_ascii(keys[i], lengths[i], data_ + offset);
+      keys_[i] = data_ + offset;
+    }
+  }
+
+  const char* const* keys() const {
+    return keys_;
+  }
+
+private:
+  char              buffer_[FOLD_BUFFER_SIZE];
+  std::vector<char> overflow_;
+  char*             data_;
+  const char*       keys_[SIMD_GROUP_SIZE];
+};
+
+#endif  // _CASEFOLD_H
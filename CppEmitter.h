@@ -0,0 +1,342 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	CppEmitter.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Self-contained C++ headers generated from tables
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _CPPEMITTER_H
+#define _CPPEMITTER_H
+
+// CppEmitter writes a FrozenTable as a header that needs nothing from pph:
+// the groups and slots are constexpr arrays, the keys are string literals
+// and find_val() has the key functions, the multipliers, the adjustments
+// and the moduli written in as constants, so the compiler can turn each
+// modulo into a multiply. Lookups need no file I/O, no allocation and no
+// startup; from C++14 on they are constexpr and can be used in constant
+// expressions.
+//
+// Only key functions that are simple loops over the bytes of the key can
+// be emitted: djb_hash, fnv64a_hash and oat_hash. Tables with folded keys
+// (Table::set_fold_case) fold each byte of the key looked up as it is
+// hashed and compared, so they stay case-insensitive.
+
+class CppEmitter {
+public:
+  // name is the namespace of the generated code; guard its include guard
+  CppEmitter(const FrozenTable& table, const std::string& name, const std::string& guard) :
+    table_(table), name_(name), guard_(guard) {
+    if (!emittable(table_.key_) || !emittable(table_.func_key_)) {
+      throw std::invalid_argument("the key function of the table (" + table_.uuid() +
+                                  ") cannot be emitted as C++; use djb_hash, fnv64a_hash or oat_hash");
+    }
+  }
+
+  // Namespace or include guard name for a file name: its stem, or the
+  // whole name, with characters that are not allowed replaced by '_'
+  static std::string identifier(const std::string& filename, bool upper) {
+    std::string stem = filename.substr(filename.find_last_of('/') + 1);
+    std::string id;
+
+    if (!upper) {
+      stem = stem.substr(0, stem.find('.'));
+    }
+
+    for (char c : stem) {
+      if (std::isalnum(static_cast<unsigned char>(c))) {
+        id += upper ? static_cast<char>(std::toupper(static_cast<unsigned char>(c))) : c;
+      } else {
+        id += '_';
+      }
+    }
+
+    if (id.empty() || std::isdigit(static_cast<unsigned char>(id[0]))) {
+      id.insert(id.begin(), '_');
+    }
+
+    return id;
+  }
+
+  void write(std::ostream& ostr) const {
+    const frozen_header_t& hdr = *table_.header_;
+    const uint64_t num_groups  = hdr.s_;
+
+    ostr << "// Generated by pph --emit-cpp; do not edit." << std::endl
+         << "//" << std::endl
+         << "// " << hdr.num_keys_ << " keys. " << name_ << "::find_val(key, length) returns the value of a key," << std::endl
+         << "// or " << name_ << "::NOT_FOUND. Key function " << table_.uuid() << "." << std::endl
+         << std::endl
+         << "#ifndef " << guard_ << std::endl
+         << "#define " << guard_ << std::endl
+         << std::endl
+         << "#include <cstddef>" << std::endl
+         << "#include <cstdint>" << std::endl
+         << std::endl
+         << "#ifndef PPH_GENERATED_CONSTEXPR" << std::endl
+         << "#if __cplusplus >= 201402L" << std::endl
+         << "#define PPH_GENERATED_CONSTEXPR constexpr" << std::endl
+         << "#else" << std::endl
+         << "#define PPH_GENERATED_CONSTEXPR inline" << std::endl
+         << "#endif" << std::endl
+         << "#endif" << std::endl
+         << std::endl
+         << "namespace " << name_ << " {" << std::endl
+         << std::endl
+         << "static constexpr uint64_t NOT_FOUND  = UINT64_C(0x" << std::hex << EMPTY_VAL << std::dec << ");" << std::endl
+         << "static constexpr size_t   SIZE       = " << hdr.num_keys_ << ";" << std::endl
+         << "static constexpr uint64_t MULTIPLIER = UINT64_C(" << hdr.multiplier_ << ");" << std::endl
+         << "static constexpr uint64_t ADJUSTMENT = UINT64_C(" << hdr.adjustment_ << ");" << std::endl
+         << "static constexpr uint64_t NUM_GROUPS = UINT64_C(" << num_groups << ");" << std::endl
+         << std::endl
+         << "typedef struct _group {" << std::endl
+         << "  uint64_t p_;" << std::endl
+         << "  uint32_t i_;" << std::endl
+         << "  uint32_t r_;" << std::endl
+         << "} group_t;" << std::endl
+         << std::endl
+         << "typedef struct _slot {" << std::endl
+         << "  const char* key_;" << std::endl
+         << "  uint32_t    len_;" << std::endl
+         << "  uint64_t    val_;" << std::endl
+         << "} slot_t;" << std::endl
+         << std::endl;
+
+    write_groups(ostr, num_groups);
+    write_slots(ostr);
+
+    const char* k_i = table_.fold_case() ? "key_char(k[i])" : "k[i]";
+
+    if (table_.fold_case()) {
+      ostr << "// Keys are case-insensitive for ASCII letters" << std::endl
+           << "PPH_GENERATED_CONSTEXPR char key_char(char c) {" << std::endl
+           << "  return ((c >= 'A') && (c <= 'Z')) ? static_cast<char>(c + ('a' - 'A')) : c;" << std::endl
+           << "}" << std::endl
+           << std::endl;
+    }
+
+    write_keyfunc(ostr, "top_hash", table_.key_, k_i);
+    write_keyfunc(ostr, "func_hash", table_.func_key_, k_i);
+
+    write_slot_index(ostr, num_groups);
+
+    ostr << "PPH_GENERATED_CONSTEXPR bool key_equal(const char* s, const char* k, size_t len) {" << std::endl
+         << "  for (size_t i = 0; i < len; i++) {" << std::endl
+         << "    if (s[i] != " << k_i << ") {" << std::endl
+         << "      return false;" << std::endl
+         << "    }" << std::endl
+         << "  }" << std::endl
+         << std::endl
+         << "  return true;" << std::endl
+         << "}" << std::endl
+         << std::endl
+         << "PPH_GENERATED_CONSTEXPR uint64_t find_val(const char* k, size_t len) {" << std::endl
+         << "  const group_t& g = GROUPS[(top_hash(k, len, MULTIPLIER) + ADJUSTMENT) % NUM_GROUPS];" << std::endl
+         << std::endl
+         << "  if (g.r_ == 0) {" << std::endl
+         << "    return NOT_FOUND;" << std::endl
+         << "  }" << std::endl
+         << std::endl
+         << "  const slot_t& s = SLOTS[slot_index(g, k, len)];" << std::endl
+         << std::endl
+         << "  return ((s.len_ == len) && key_equal(s.key_, k, len)) ? s.val_ : NOT_FOUND;" << std::endl
+         << "}" << std::endl
+         << std::endl
+         << "// String literals" << std::endl
+         << "template<size_t N>" << std::endl
+         << "PPH_GENERATED_CONSTEXPR uint64_t find_val(const char (&k)[N]) {" << std::endl
+         << "  return find_val(k, N - 1);" << std::endl
+         << "}" << std::endl
+         << std::endl
+         << "}  // namespace " << name_ << std::endl
+         << std::endl
+         << "#endif  // " << guard_ << std::endl;
+  }
+
+private:
+  static bool emittable(keyfunc_t key) {
+    return (key == djb_hash) || (key == fnv64a_hash) || (key == oat_hash);
+  }
+
+  // key as a C string literal
+  static std::string literal(const char* key, size_t len) {
+    std::ostringstream stream;
+
+    stream << '"';
+
+    for (size_t i = 0; i < len; i++) {
+      unsigned char c = static_cast<unsigned char>(key[i]);
+
+      if ((c == '"') || (c == '\\')) {
+        stream << '\\' << key[i];
+      } else if ((c < 0x20) || (c >= 0x7F) || (c == '?')) {
+        // three octal digits cannot run into the next character; '?' avoids trigraphs
+        stream << '\\' << std::oct << std::setw(3) << std::setfill('0') << static_cast<unsigned>(c)
+               << std::dec << std::setfill(' ');
+      } else {
+        stream << key[i];
+      }
+    }
+
+    stream << '"';
+
+    return stream.str();
+  }
+
+  void write_groups(std::ostream& ostr, uint64_t num_groups) const {
+    ostr << "static constexpr group_t GROUPS[" << num_groups << "] = {" << std::endl;
+
+    for (uint64_t i = 0; i < num_groups; i++) {
+      const hdr_t& g = table_.groups_[i];
+
+      ostr << (((i % 4) == 0) ? "  " : " ") << "{" << g.p_ << ", " << g.i_ << ", " << g.r_ << "}"
+           << ((i + 1 < num_groups) ? "," : "");
+
+      if (((i % 4) == 3) || (i + 1 == num_groups)) {
+        ostr << std::endl;
+      }
+    }
+
+    ostr << "};" << std::endl << std::endl;
+  }
+
+  void write_slots(std::ostream& ostr) const {
+    const uint64_t num_slots = std::max(table_.header_->num_slots_, UINT64_C(1));
+
+    ostr << "static constexpr slot_t SLOTS[" << num_slots << "] = {" << std::endl;
+
+    for (uint64_t i = 0; i < num_slots; i++) {
+      const char* sep = (i + 1 < num_slots) ? "," : "";
+
+      if ((i >= table_.header_->num_slots_) || (table_.slots_[i].val_ == EMPTY_VAL)) {
+        ostr << "  {\"\", 0, NOT_FOUND}" << sep << std::endl;
+        continue;
+      }
+
+      const frozen_slot_t& slot = table_.slots_[i];
+
+      ostr << "  {" << literal(table_.keys_ + slot.key_, slot.len_) << ", " << slot.len_ << ", "
+           << slot.val_ << "}" << sep << std::endl;
+    }
+
+    ostr << "};" << std::endl << std::endl;
+  }
+
+  // The same arithmetic as the key function's _buf form, adjustment 0;
+  // k_i is the expression for byte i of the key
+  static void write_keyfunc(std::ostream& ostr, const char* name, keyfunc_t key, const char* k_i) {
+    ostr << "PPH_GENERATED_CONSTEXPR uint64_t " << name
+         << "(const char* k, size_t len, uint64_t multiplier) {" << std::endl;
+
+    if (key == djb_hash) {
+      ostr << "  uint64_t h = 0;" << std::endl
+           << std::endl
+           << "  for (size_t i = 0; i < len; i++) {" << std::endl
+           << "    h = (h * multiplier) ^ static_cast<uint64_t>(" << k_i << ");" << std::endl
+           << "  }" << std::endl;
+    } else if (key == fnv64a_hash) {
+      ostr << "  uint64_t h = UINT64_C(0x" << std::hex << FNV1A_64_INIT << ");" << std::endl
+           << std::endl
+           << "  (void)multiplier;" << std::endl
+           << std::endl
+           << "  for (size_t i = 0; i < len; i++) {" << std::endl
+           << "    h = (h ^ static_cast<uint64_t>(" << k_i << ")) * UINT64_C(0x" << FNV_64_PRIME << ");" << std::endl
+           << "  }" << std::dec << std::endl;
+    } else {
+      ostr << "  uint64_t h = 0;" << std::endl
+           << std::endl
+           << "  (void)multiplier;" << std::endl
+           << std::endl
+           << "  for (size_t i = 0; i < len; i++) {" << std::endl
+           << "    h += static_cast<uint64_t>(" << k_i << ");" << std::endl
+           << "    h += (h << 10);" << std::endl
+           << "    h ^= (h >> 6);" << std::endl
+           << "  }" << std::endl
+           << std::endl
+           << "  h += (h << 3);" << std::endl
+           << "  h ^= (h >> 11);" << std::endl
+           << "  h += (h << 15);" << std::endl;
+    }
+
+    ostr << std::endl
+         << "  return h;" << std::endl
+         << "}" << std::endl
+         << std::endl;
+  }
+
+  // One case per second level function in use, with its constants
+  void write_slot_index(std::ostream& ostr, uint64_t num_groups) const {
+    std::vector<bool> used(table_.header_->num_funcs_, false);
+
+    for (uint64_t i = 0; i < num_groups; i++) {
+      const hdr_t& g = table_.groups_[i];
+
+      if ((g.r_ > 1) && (g.i_ < used.size())) {
+        used[g.i_] = true;
+      }
+    }
+
+    ostr << "// Groups of one key do not need the second hash" << std::endl
+         << "PPH_GENERATED_CONSTEXPR uint64_t slot_index(const group_t& g, const char* k, size_t len) {" << std::endl
+         << "  switch ((g.r_ > 1) ? g.i_ : UINT32_MAX) {" << std::endl;
+
+    for (uint64_t i = 0; i < used.size(); i++) {
+      if (!used[i]) {
+        continue;
+      }
+
+      const frozen_func_t& f = table_.funcs_[i];
+
+      std::ostringstream hash;
+
+      hash << "(func_hash(k, len, UINT64_C(" << f.multiplier_ << ")) + UINT64_C(" << f.adjustment_ << "))";
+
+      ostr << "    case " << i << ":" << std::endl
+           << "      return g.p_ + ";
+
+      // modulo() by 0 leaves the value unchanged
+      if (f.modulus_ == 0) {
+        ostr << hash.str() << " % g.r_;" << std::endl;
+      } else {
+        ostr << "(" << hash.str() << " % UINT64_C(" << f.modulus_ << ")) % g.r_;" << std::endl;
+      }
+    }
+
+    ostr << "    default:" << std::endl
+         << "      return g.p_;" << std::endl
+         << "  }" << std::endl
+         << "}" << std::endl
+         << std::endl;
+  }
+
+  const FrozenTable& table_;
+  std::string        name_;
+  std::string        guard_;
+};
+
+// Writes table as a header for #include; throws std::invalid_argument if
+// its key functions cannot be emitted
+inline void emit_cpp(const FrozenTable& table, std::ostream& ostr, const std::string& name,
+                     const std::string& guard) {
+  CppEmitter(table, name, guard).write(ostr);
+}
+
+#endif  // _CPPEMITTER_H
@@ -0,0 +1,82 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	CpuFeatures.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Runtime detection of instruction set extensions
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _CPUFEATURES_H
+#define _CPUFEATURES_H
+
+// Accelerated code paths are compiled with per-function target attributes
+// so the rest of the build does not need -msse4.2/-mavx2 and the binary
+// still runs on processors without them. Each query is evaluated once.
+//
+// https://gcc.gnu.org/onlinedocs/gcc/x86-Built-in-Functions.html
+// https://gcc.gnu.org/onlinedocs/gcc/x86-Function-Attributes.html
+
+#if defined(PPH_X86)
+#define PPH_TARGET(x) __attribute__((target(x)))
+#else
+#define PPH_TARGET(x)
+#endif
+
+inline bool cpu_has_sse42() {
+#if defined(PPH_X86)
+  static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("sse4.2"));
+  return has;
+#else
+  return false;
+#endif
+}
+
+inline bool cpu_has_pclmul() {
+#if defined(PPH_X86)
+  static const bool has = (__builtin_cpu_init(),
+                           __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1"));
+  return has;
+#else
+  return false;
+#endif
+}
+
+inline bool cpu_has_avx2() {
+#if defined(PPH_X86)
+  static const bool has = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+  return has;
+#else
+  return false;
+#endif
+}
+
+// AVX-512 kernels need AVX512DQ for the 64-bit multiply (vpmullq)
+inline bool cpu_has_avx512() {
+#if defined(PPH_X86)
+  static const bool has = (__builtin_cpu_init(),
+                           __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512dq"));
+  return has;
+#else
+  return false;
+#endif
+}
+
+#endif  // _CPUFEATURES_H
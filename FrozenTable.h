@@ -0,0 +1,497 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	FrozenTable.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Immutable copy of a hash table for concurrent lookups
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _FROZENTABLE_H
+#define _FROZENTABLE_H
+
+// A FrozenTable is a read-only copy of a built or loaded Table, stored in
+// one block of memory:
+//
+//   header | functions h[i] | groups H | slots D | key bytes
+//
+// Each section starts on a cache line. Lookups are const and use no
+// shared mutable state, so any number of threads can use the same
+// FrozenTable without locking. Copies share the block.
+//
+// The block holds no pointers, so it can be written out and used in
+// place by another process (attach(), SharedTable.h).
+
+static constexpr size_t   FROZEN_ALIGNMENT = 64;
+static constexpr uint32_t FROZEN_VERSION   = 1;
+static constexpr char     FROZEN_MAGIC[8]  = {'P', 'P', 'H', 'F', 'R', 'Z', 'N', '\0'};
+
+// frozen_header_t flags: the top level key function is the key function
+// of the UUID (Table::set_keyfunc) rather than djb_hash
+static constexpr uint32_t FROZEN_FLAG_UUID_KEY  = 1;
+// keys are folded to lower case, and so are the keys looked up (CaseFold.h)
+static constexpr uint32_t FROZEN_FLAG_FOLD_CASE = 2;
+
+typedef struct _frozen_header {
+  char     magic_[8];
+  uint32_t version_;
+  uint32_t flags_;
+  // size of the block in bytes
+  uint64_t bytes_;
+  // h(k) = mod(key(k, multiplier, adjustment), s)
+  uint64_t s_;
+  uint64_t multiplier_;
+  uint64_t adjustment_;
+  uint64_t num_funcs_;
+  uint64_t num_slots_;
+  uint64_t num_keys_;
+  uint64_t key_bytes_;
+  // byte offsets of the sections
+  uint64_t funcs_offset_;
+  uint64_t groups_offset_;
+  uint64_t slots_offset_;
+  uint64_t keys_offset_;
+  // UUID of the key function, NUL terminated
+  char     uuid_[40];
+} frozen_header_t;
+
+// h[i](k,r) = mod(mod(key(k, multiplier, adjustment), modulus), r)
+typedef struct _frozen_func {
+  uint64_t modulus_;
+  uint64_t multiplier_;
+  uint64_t adjustment_;
+} frozen_func_t;
+
+typedef struct _frozen_slot {
+  uint64_t val_;
+  // offset of the key in the key bytes (keys are NUL terminated)
+  uint32_t key_;
+  uint32_t len_;
+} frozen_slot_t;
+
+static_assert(sizeof(hdr_t) == 16, "hdr_t is stored in frozen tables");
+static_assert(sizeof(frozen_slot_t) == 16, "frozen_slot_t packs into 16 bytes");
+
+inline uint64_t frozen_align(uint64_t offset) {
+  return (offset + FROZEN_ALIGNMENT - 1) & ~static_cast<uint64_t>(FROZEN_ALIGNMENT - 1);
+}
+
+class FrozenTable {
+public:
+  // An empty table; every lookup misses
+  FrozenTable() {
+    Table empty;
+    freeze(empty);
+  }
+
+  explicit FrozenTable(const Table& table) {
+    freeze(table);
+  }
+
+  uint64_t find_val(const char* k, size_t len) const {
+    if (fold_case_) {
+      FoldedKeys folded;
+
+      folded.fold(&k, &len, 1);
+
+      return find_exact(folded.keys()[0], len);
+    }
+
+    return find_exact(k, len);
+  }
+
+  uint64_t find_val(const std::string& k) const {
+    return find_val(k.data(), k.size());
+  }
+
+  // Batched lookups; vals[i] is EMPTY_VAL for keys that are not found
+  void find_vals(const char* const* keys, const size_t* lengths, size_t count, uint64_t* vals) const {
+    FoldedKeys folded;
+
+    for (size_t base = 0; base < count; base += SIMD_GROUP_SIZE) {
+      size_t n = std::min(SIMD_GROUP_SIZE, count - base);
+
+      if (fold_case_) {
+        folded.fold(keys + base, lengths + base, n);
+        find_block(folded.keys(), lengths + base, n, vals + base);
+      } else {
+        find_block(keys + base, lengths + base, n, vals + base);
+      }
+    }
+  }
+
+  std::vector<uint64_t> find_vals(const std::vector<std::string>& keys) const {
+    std::vector<const char*> ptrs(keys.size());
+    std::vector<size_t>      lengths(keys.size());
+    std::vector<uint64_t>    vals(keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      ptrs[i]    = keys[i].data();
+      lengths[i] = keys[i].size();
+    }
+
+    find_vals(ptrs.data(), lengths.data(), keys.size(), vals.data());
+
+    return vals;
+  }
+
+  bool notfound_val(uint64_t v) const {
+    return (v == EMPTY_VAL);
+  }
+
+  // Number of keys
+  uint64_t size() const {
+    return header_->num_keys_;
+  }
+
+  std::string uuid() const {
+    return std::string(header_->uuid_);
+  }
+
+  // Keys are case-insensitive for ASCII letters (Table::set_fold_case)
+  bool fold_case() const {
+    return fold_case_;
+  }
+
+  // The block holding the table
+  const char* data() const {
+    return storage_.get();
+  }
+
+  uint64_t bytes() const {
+    return header_->bytes_;
+  }
+
+  // Calls f(key, length, val) for each key, in slot order
+  template<typename F>
+  void for_each(F f) const {
+    for (uint64_t i = 0; i < header_->num_slots_; i++) {
+      if (slots_[i].val_ != EMPTY_VAL) {
+        f(keys_ + slots_[i].key_, static_cast<size_t>(slots_[i].len_), slots_[i].val_);
+      }
+    }
+  }
+
+  // Uses a block written by another FrozenTable (data(), bytes()) in
+  // place; block must stay valid until the last copy is destroyed. The key
+  // functions are found from the UUID; key overrides the top level one
+  // for tables built with a custom key function. False if the block is
+  // not a complete frozen table.
+  bool attach(std::shared_ptr<char> block, uint64_t size, keyfunc_t key = nullptr) {
+    if ((block == nullptr) || !valid(block.get(), size)) {
+      return false;
+    }
+
+    const frozen_header_t* hdr = reinterpret_cast<const frozen_header_t*>(block.get());
+
+    func_key_ = uuid_to_keyfunc(std::string(hdr->uuid_));
+
+    if (key != nullptr) {
+      key_ = key;
+    } else {
+      key_ = ((hdr->flags_ & FROZEN_FLAG_UUID_KEY) != 0) ? func_key_ : djb_hash;
+    }
+
+    storage_ = block;
+
+    init();
+
+    return true;
+  }
+
+private:
+  friend class CppEmitter;
+
+  // True if count entries of the given size starting at offset lie within
+  // a block of bytes bytes
+  static bool section_fits(uint64_t offset, uint64_t count, uint64_t size, uint64_t bytes) {
+    return ((offset % FROZEN_ALIGNMENT) == 0) && (offset <= bytes) &&
+           (count <= (bytes - offset) / size);
+  }
+
+  // Checks a block for attach(): every section lies within the block and
+  // every group, function index and key a lookup can reach is in range
+  static bool valid(const char* base, uint64_t size) {
+    const frozen_header_t* hdr = reinterpret_cast<const frozen_header_t*>(base);
+
+    if ((size < sizeof(frozen_header_t)) ||
+        (std::memcmp(hdr->magic_, FROZEN_MAGIC, sizeof(FROZEN_MAGIC)) != 0) ||
+        (hdr->version_ != FROZEN_VERSION) || (hdr->bytes_ > size) ||
+        (hdr->bytes_ < sizeof(frozen_header_t)) || (hdr->s_ == 0) ||
+        (hdr->num_funcs_ == 0) || (hdr->uuid_[sizeof(hdr->uuid_) - 1] != '\0')) {
+      return false;
+    }
+
+    // groups are indexed by h(k) = mod(key, s)
+    if (!section_fits(hdr->funcs_offset_, hdr->num_funcs_, sizeof(frozen_func_t), hdr->bytes_) ||
+        !section_fits(hdr->groups_offset_, hdr->s_, sizeof(hdr_t), hdr->bytes_) ||
+        !section_fits(hdr->slots_offset_, hdr->num_slots_, sizeof(frozen_slot_t), hdr->bytes_) ||
+        !section_fits(hdr->keys_offset_, hdr->key_bytes_, 1, hdr->bytes_)) {
+      return false;
+    }
+
+    const frozen_func_t* funcs  = reinterpret_cast<const frozen_func_t*>(base + hdr->funcs_offset_);
+    const hdr_t*         groups = reinterpret_cast<const hdr_t*>(base + hdr->groups_offset_);
+    const frozen_slot_t* slots  = reinterpret_cast<const frozen_slot_t*>(base + hdr->slots_offset_);
+
+    for (uint64_t i = 0; i < hdr->s_; i++) {
+      const hdr_t& group = groups[i];
+
+      // find_block() reads the function of empty groups too
+      if ((group.i_ >= hdr->num_funcs_) || (group.p_ > hdr->num_slots_) ||
+          (group.r_ > hdr->num_slots_ - group.p_)) {
+        return false;
+      }
+
+      if ((group.r_ > 1) && (funcs[group.i_].modulus_ == 0)) {
+        return false;
+      }
+    }
+
+    for (uint64_t i = 0; i < hdr->num_slots_; i++) {
+      if ((slots[i].key_ > hdr->key_bytes_) || (slots[i].len_ > hdr->key_bytes_ - slots[i].key_)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  static uint64_t hash(keyfunc_t key, bufkeyfunc_t buf, const char* k, size_t len, uint64_t multiplier) {
+    if (buf != nullptr) {
+      return buf(k, len, multiplier, 0);
+    }
+
+    return key(std::string(k, len), multiplier, 0);
+  }
+
+  static void hash_keys(batchkeyfunc_t batch, keyfunc_t key, bufkeyfunc_t buf,
+                        const char* const* keys, const size_t* lengths,
+                        const uint64_t* multipliers, size_t count, uint64_t* hashes) {
+    if (batch != nullptr) {
+      batch(keys, lengths, multipliers, count, hashes);
+      return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      hashes[i] = hash(key, buf, keys[i], lengths[i], multipliers[i]);
+    }
+  }
+
+  // find_val() of a key as it is stored
+  uint64_t find_exact(const char* k, size_t len) const {
+    const hdr_t& group = groups_[modulo(hash(key_, key_buf_, k, len, multiplier_) + adjustment_, s_)];
+
+    if (group.r_ == 0) {
+      return EMPTY_VAL;
+    }
+
+    uint64_t idx = group.p_;
+
+    // groups of one key do not need the second hash
+    if (group.r_ > 1) {
+      const frozen_func_t& f = funcs_[group.i_];
+      uint64_t hash2 = hash(func_key_, func_key_buf_, k, len, f.multiplier_);
+      idx += modulo(modulo(hash2 + f.adjustment_, f.modulus_), group.r_);
+    }
+
+    return match(slots_[idx], k, len);
+  }
+
+  // find_vals() for a block of n <= SIMD_GROUP_SIZE keys
+  void find_block(const char* const* keys, const size_t* lengths, size_t n, uint64_t* vals) const {
+    uint64_t multipliers[SIMD_GROUP_SIZE];
+    uint64_t hashes[SIMD_GROUP_SIZE];
+    hdr_t    groups[SIMD_GROUP_SIZE];
+
+    std::fill(multipliers, multipliers + n, multiplier_);
+    hash_keys(key_batch_, key_, key_buf_, keys, lengths, multipliers, n, hashes);
+
+    for (size_t i = 0; i < n; i++) {
+      groups[i]      = groups_[modulo(hashes[i] + adjustment_, s_)];
+      multipliers[i] = funcs_[groups[i].i_].multiplier_;
+    }
+
+    hash_keys(func_batch_, func_key_, func_key_buf_, keys, lengths, multipliers, n, hashes);
+
+    for (size_t i = 0; i < n; i++) {
+      const hdr_t& group = groups[i];
+
+      if (group.r_ == 0) {
+        vals[i] = EMPTY_VAL;
+        continue;
+      }
+
+      const frozen_func_t& f = funcs_[group.i_];
+      uint64_t idx = group.p_ + modulo(modulo(hashes[i] + f.adjustment_, f.modulus_), group.r_);
+
+      vals[i] = match(slots_[idx], keys[i], lengths[i]);
+    }
+  }
+
+  uint64_t match(const frozen_slot_t& slot, const char* k, size_t len) const {
+    if ((slot.len_ == len) && (std::memcmp(keys_ + slot.key_, k, len) == 0)) {
+      return slot.val_;
+    }
+
+    return EMPTY_VAL;
+  }
+
+  void freeze(const Table& table) {
+    uint64_t num_slots = table.D_.size();
+    uint64_t num_keys  = 0;
+    uint64_t key_bytes = 0;
+
+    for (uint64_t i = 0; i < num_slots; i++) {
+      if (table.D_[i].key_[0] == 0)
+        continue;
+
+      num_keys++;
+      key_bytes += std::strlen(table.D_[i].key_) + 1;
+    }
+
+    if (key_bytes > UINT32_MAX) {
+      throw std::length_error("FrozenTable: keys exceed 4 GiB");
+    }
+
+    frozen_header_t hdr;
+
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic_, FROZEN_MAGIC, sizeof(hdr.magic_));
+    std::strncpy(hdr.uuid_, table.uuid_.c_str(), sizeof(hdr.uuid_) - 1);
+
+    // a table without groups gets one empty group, so lookups miss
+    uint64_t num_groups = std::max(static_cast<uint64_t>(table.H_.size()), UINT64_C(1));
+
+    hdr.version_       = FROZEN_VERSION;
+    hdr.flags_         = (table.key_ == table.func_.key_) ? FROZEN_FLAG_UUID_KEY : 0;
+
+    if (table.fold_case_) {
+      hdr.flags_      |= FROZEN_FLAG_FOLD_CASE;
+    }
+
+    hdr.s_             = table.H_.empty() ? 1 : table.s_;
+    hdr.multiplier_    = table.multiplier_;
+    hdr.adjustment_    = table.adjustment_;
+    hdr.num_funcs_     = table.func_.h_.size();
+    hdr.num_slots_     = num_slots;
+    hdr.num_keys_      = num_keys;
+    hdr.key_bytes_     = key_bytes;
+    hdr.funcs_offset_  = frozen_align(sizeof(hdr));
+    hdr.groups_offset_ = frozen_align(hdr.funcs_offset_ + hdr.num_funcs_ * sizeof(frozen_func_t));
+    hdr.slots_offset_  = frozen_align(hdr.groups_offset_ + num_groups * sizeof(hdr_t));
+    hdr.keys_offset_   = frozen_align(hdr.slots_offset_ + num_slots * sizeof(frozen_slot_t));
+    hdr.bytes_         = frozen_align(hdr.keys_offset_ + key_bytes);
+
+    void* block = nullptr;
+
+    if (posix_memalign(&block, FROZEN_ALIGNMENT, hdr.bytes_) != 0) {
+      throw std::bad_alloc();
+    }
+
+    storage_ = std::shared_ptr<char>(static_cast<char*>(block), std::free);
+
+    char* base = storage_.get();
+
+    std::memset(base, 0, hdr.bytes_);
+    std::memcpy(base, &hdr, sizeof(hdr));
+
+    frozen_func_t* funcs  = reinterpret_cast<frozen_func_t*>(base + hdr.funcs_offset_);
+    hdr_t*         groups = reinterpret_cast<hdr_t*>(base + hdr.groups_offset_);
+    frozen_slot_t* slots  = reinterpret_cast<frozen_slot_t*>(base + hdr.slots_offset_);
+    char*          keys   = base + hdr.keys_offset_;
+
+    for (uint64_t i = 0; i < hdr.num_funcs_; i++) {
+      funcs[i].modulus_    = table.func_.h_[i];
+      funcs[i].multiplier_ = table.func_.multiplier_[i];
+      funcs[i].adjustment_ = table.func_.adjustment_[i];
+    }
+
+    std::copy(table.H_.begin(), table.H_.end(), groups);
+
+    uint64_t offset = 0;
+
+    for (uint64_t i = 0; i < num_slots; i++) {
+      const data_t& dat = table.D_[i];
+
+      if (dat.key_[0] == 0) {
+        slots[i].val_ = EMPTY_VAL;
+        slots[i].key_ = 0;
+        slots[i].len_ = 0;
+        continue;
+      }
+
+      size_t len = std::strlen(dat.key_);
+
+      std::memcpy(keys + offset, dat.key_, len + 1);
+
+      slots[i].val_ = dat.val_;
+      slots[i].key_ = static_cast<uint32_t>(offset);
+      slots[i].len_ = static_cast<uint32_t>(len);
+
+      offset += len + 1;
+    }
+
+    // the top level key function is not recorded with the table
+    key_          = table.key_;
+    func_key_     = table.func_.key_;
+
+    init();
+  }
+
+  void init() {
+    const char* base = storage_.get();
+
+    header_       = reinterpret_cast<const frozen_header_t*>(base);
+    funcs_        = reinterpret_cast<const frozen_func_t*>(base + header_->funcs_offset_);
+    groups_       = reinterpret_cast<const hdr_t*>(base + header_->groups_offset_);
+    slots_        = reinterpret_cast<const frozen_slot_t*>(base + header_->slots_offset_);
+    keys_         = base + header_->keys_offset_;
+
+    s_            = header_->s_;
+    multiplier_   = header_->multiplier_;
+    adjustment_   = header_->adjustment_;
+    fold_case_    = ((header_->flags_ & FROZEN_FLAG_FOLD_CASE) != 0);
+
+    key_buf_      = keyfunc_to_bufkeyfunc(key_);
+    key_batch_    = keyfunc_to_batchkeyfunc(key_);
+    func_key_buf_ = keyfunc_to_bufkeyfunc(func_key_);
+    func_batch_   = keyfunc_to_batchkeyfunc(func_key_);
+  }
+
+  std::shared_ptr<char>  storage_;
+  const frozen_header_t* header_;
+  const frozen_func_t*   funcs_;
+  const hdr_t*           groups_;
+  const frozen_slot_t*   slots_;
+  const char*            keys_;
+  uint64_t               s_;
+  uint64_t               multiplier_;
+  uint64_t               adjustment_;
+  bool                   fold_case_;
+  keyfunc_t              key_;
+  bufkeyfunc_t           key_buf_;
+  batchkeyfunc_t         key_batch_;
+  keyfunc_t              func_key_;
+  bufkeyfunc_t           func_key_buf_;
+  batchkeyfunc_t         func_batch_;
+};
+
+#endif  // _FROZENTABLE_H
@@ -0,0 +1,543 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	IntTable.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Tables with 64-bit integer keys and 128-bit fingerprints
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _INTTABLE_H
+#define _INTTABLE_H
+
+// An IntTable maps uint64_t keys (sparse ids) to values without turning
+// them into strings. It has the two levels of Table, with the key function
+// replaced by the SplitMix64 finalizer (key_mix):
+//
+//   h(k)    = mix(k ^ seed) mod s                  s a power of two
+//   h[i](k) = (high 32 bits of mix(k ^ salt[i])) * r / 2^32
+//
+// A FingerprintTable is the same table over 128-bit keys, for keys that
+// were hashed before they reach us (a fingerprint column of a columnar
+// store). Both halves go through mix, so fingerprints that differ in
+// either half are separated:
+//
+//   mix(k, x) = mix(mix(k.hi ^ x) ^ k.lo)
+//
+// Neither table sees the original strings, so two keys whose fingerprints
+// are equal cannot be told apart. load() fails if keys has duplicates, and
+// collisions() then gives the positions of every repeat.
+//
+// Keys are stored in the slots of D next to their values, so a lookup
+// reads one group of H and one slot of D. As in StaticTable, the table is
+// built in one pass: keys are sorted into groups by h(k), and each group
+// takes the first salt with no collisions among its slots, growing by a
+// slot every DEFAULT_ATTEMPTS salts. Groups are placed one after another.
+//
+// serialize() writes a binary image (header, salts, H, D) with a CRC-64
+// of all of it; it is read back with unserialize() on hosts of the same
+// byte order.
+
+static constexpr uint32_t INT_TABLE_VERSION = 1;
+
+typedef struct _fingerprint128 {
+  uint64_t hi_;
+  uint64_t lo_;
+} fingerprint128_t;
+
+inline bool operator==(const fingerprint128_t& a, const fingerprint128_t& b) {
+  return (a.hi_ == b.hi_) && (a.lo_ == b.lo_);
+}
+
+inline bool operator!=(const fingerprint128_t& a, const fingerprint128_t& b) {
+  return !(a == b);
+}
+
+inline bool operator<(const fingerprint128_t& a, const fingerprint128_t& b) {
+  return (a.hi_ < b.hi_) || ((a.hi_ == b.hi_) && (a.lo_ < b.lo_));
+}
+
+// How a key type is mixed and named in serialized tables
+template<typename Key>
+struct int_key_traits;
+
+template<>
+struct int_key_traits<uint64_t> {
+  static uint64_t mix(uint64_t k, uint64_t x) {
+    return key_mix(k ^ x);
+  }
+
+  static const char* magic() {
+    return "PPHINT64";
+  }
+};
+
+template<>
+struct int_key_traits<fingerprint128_t> {
+  static uint64_t mix(const fingerprint128_t& k, uint64_t x) {
+    return key_mix(key_mix(k.hi_ ^ x) ^ k.lo_);
+  }
+
+  static const char* magic() {
+    return "PPHFP128";
+  }
+};
+
+template<typename Key>
+struct int_slot {
+  Key      key_;
+  // EMPTY_VAL in slots without a key
+  uint64_t val_;
+};
+
+typedef int_slot<uint64_t> int_slot_t;
+
+// A key given to load() more than once: second_ is the position of a
+// repeat and first_ the position of the key before it
+typedef struct _int_collision {
+  uint64_t first_;
+  uint64_t second_;
+} int_collision_t;
+
+typedef struct _int_table_header {
+  char     magic_[8];
+  uint32_t version_;
+  uint32_t flags_;
+  uint64_t seed_;
+  // number of keys
+  uint64_t n_;
+  // number of groups (H)
+  uint64_t s_;
+  uint64_t num_salts_;
+  uint64_t num_slots_;
+  // CRC-64 of the header (with checksum_ 0), salts, groups and slots
+  uint64_t checksum_;
+} int_table_header_t;
+
+static_assert(sizeof(int_slot<uint64_t>) == 16, "int_slot is stored in serialized tables");
+static_assert(sizeof(int_slot<fingerprint128_t>) == 24, "int_slot is stored in serialized tables");
+
+template<typename Key>
+class BasicIntTable {
+public:
+  typedef int_key_traits<Key> traits;
+  typedef int_slot<Key>       slot_t;
+
+  // An empty table; every lookup misses
+  BasicIntTable() : seed_(0), n_(0), s_(1), H_(1), D_(1, empty_slot()) {}
+
+  // Builds the table; values must not be EMPTY_VAL. False, leaving an
+  // empty table, if keys has duplicates, which collisions() lists.
+  bool load(const Key* keys, const uint64_t* values, uint64_t count, uint64_t seed = 0) {
+    collisions_.clear();
+
+    for (uint64_t j = 0; j < count; j++) {
+      if (values[j] == EMPTY_VAL) {
+        clear();
+        return false;
+      }
+    }
+
+    seed_ = seed;
+    n_    = count;
+    s_    = num_groups(n_);
+
+    // keys by group, from counts like a counting sort
+    std::vector<uint64_t> start(s_ + 1, 0);
+    std::vector<uint64_t> order(count);
+
+    for (uint64_t j = 0; j < count; j++) {
+      start[group(keys[j]) + 1]++;
+    }
+
+    for (uint64_t g = 0; g < s_; g++) {
+      start[g + 1] += start[g];
+    }
+
+    std::vector<uint64_t> fill(start.begin(), start.end() - 1);
+
+    for (uint64_t j = 0; j < count; j++) {
+      order[fill[group(keys[j])]++] = j;
+    }
+
+    // equal keys are in the same group; look for them before any salt is
+    // searched, since no salt separates them
+    for (uint64_t g = 0; g < s_; g++) {
+      if (start[g + 1] - start[g] > 1) {
+        uint64_t* first = order.data() + start[g];
+        uint64_t* last  = order.data() + start[g + 1];
+
+        std::sort(first, last, [keys](uint64_t a, uint64_t b) {
+          return (keys[a] < keys[b]) || (!(keys[b] < keys[a]) && (a < b));
+        });
+
+        for (uint64_t* j = first; j + 1 < last; j++) {
+          if (keys[j[0]] == keys[j[1]]) {
+            collisions_.push_back(int_collision_t{j[0], j[1]});
+          }
+        }
+      }
+    }
+
+    if (!collisions_.empty()) {
+      std::sort(collisions_.begin(), collisions_.end(), [](const int_collision_t& a, const int_collision_t& b) {
+        return (a.second_ < b.second_);
+      });
+      clear();
+      return false;
+    }
+
+    SplitMix64 random(seed_);
+    std::vector<Key>     members;
+    std::vector<uint8_t> used;
+
+    salts_.clear();
+    H_.assign(s_, hdr_t());
+    D_.clear();
+    D_.reserve(count + count / 8 + 1);
+
+    for (uint64_t g = 0; g < s_; g++) {
+      uint64_t r = start[g + 1] - start[g];
+
+      if (r == 0) {
+        continue;
+      }
+
+      members.clear();
+
+      for (uint64_t j = start[g]; j < start[g + 1]; j++) {
+        members.push_back(keys[order[j]]);
+      }
+
+      hdr_t& hdr = H_[g];
+
+      hdr.p_ = D_.size();
+      hdr.i_ = 0;
+      hdr.r_ = static_cast<uint32_t>(r);
+
+      if (r > 1) {
+        find_salt(members, random, used, hdr);
+      }
+
+      D_.resize(hdr.p_ + hdr.r_, empty_slot());
+
+      for (uint64_t j = start[g]; j < start[g + 1]; j++) {
+        const Key& k = keys[order[j]];
+
+        D_[hdr.p_ + slot(hdr, k)] = slot_t{k, values[order[j]]};
+      }
+    }
+
+    if (D_.empty()) {
+      D_.push_back(empty_slot());
+    }
+
+    return true;
+  }
+
+  bool load(const std::vector<Key>& keys, const std::vector<uint64_t>& values, uint64_t seed = 0) {
+    if (keys.size() != values.size()) {
+      return false;
+    }
+
+    return load(keys.data(), values.data(), keys.size(), seed);
+  }
+
+  // Repeated keys found by the last load(), in order of position
+  const std::vector<int_collision_t>& collisions() const {
+    return collisions_;
+  }
+
+  uint64_t find_val(const Key& k) const {
+    const hdr_t&  hdr = H_[group(k)];
+    const slot_t& dat = D_[hdr.p_ + slot(hdr, k)];
+
+    // a key of an empty group cannot be in slot p = 0, which belongs to another group
+    return (dat.key_ == k) ? dat.val_ : EMPTY_VAL;
+  }
+
+  // Looks up count keys. The groups of a block are prefetched, then its
+  // slots, so the cache misses of a block overlap.
+  void find_vals(const Key* keys, size_t count, uint64_t* vals) const {
+    uint64_t slots[SIMD_GROUP_SIZE];
+
+    for (size_t base = 0; base < count; base += SIMD_GROUP_SIZE) {
+      size_t n = std::min(SIMD_GROUP_SIZE, count - base);
+
+      for (size_t i = 0; i < n; i++) {
+        slots[i] = group(keys[base + i]);
+        __builtin_prefetch(&H_[slots[i]]);
+      }
+
+      for (size_t i = 0; i < n; i++) {
+        const hdr_t& hdr = H_[slots[i]];
+
+        slots[i] = hdr.p_ + slot(hdr, keys[base + i]);
+        __builtin_prefetch(&D_[slots[i]]);
+      }
+
+      for (size_t i = 0; i < n; i++) {
+        const slot_t& dat = D_[slots[i]];
+
+        vals[base + i] = (dat.key_ == keys[base + i]) ? dat.val_ : EMPTY_VAL;
+      }
+    }
+  }
+
+  std::vector<uint64_t> find_vals(const std::vector<Key>& keys) const {
+    std::vector<uint64_t> vals(keys.size());
+
+    find_vals(keys.data(), keys.size(), vals.data());
+
+    return vals;
+  }
+
+  bool notfound_val(uint64_t v) const {
+    return (v == EMPTY_VAL);
+  }
+
+  // Number of keys
+  uint64_t size() const {
+    return n_;
+  }
+
+  uint64_t seed() const {
+    return seed_;
+  }
+
+  // Salts of h; fewer is more cache friendly
+  uint64_t num_funcs() const {
+    return salts_.size();
+  }
+
+  uint64_t num_slots() const {
+    return D_.size();
+  }
+
+  // Bytes of the groups, slots and salts
+  uint64_t bytes() const {
+    return H_.size() * sizeof(hdr_t) + D_.size() * sizeof(slot_t) + salts_.size() * sizeof(uint64_t);
+  }
+
+  // Calls f(key, val) for each key, in slot order
+  template<typename F>
+  void for_each(F f) const {
+    for (const slot_t& dat : D_) {
+      if (dat.val_ != EMPTY_VAL) {
+        f(dat.key_, dat.val_);
+      }
+    }
+  }
+
+  bool serialize(std::ostream& ostr) const {
+    int_table_header_t hdr;
+
+    std::memset(&hdr, 0, sizeof(hdr));
+    std::memcpy(hdr.magic_, traits::magic(), sizeof(hdr.magic_));
+
+    hdr.version_   = INT_TABLE_VERSION;
+    hdr.seed_      = seed_;
+    hdr.n_         = n_;
+    hdr.s_         = s_;
+    hdr.num_salts_ = salts_.size();
+    hdr.num_slots_ = D_.size();
+    hdr.checksum_  = checksum(salts_.data(), H_.data(), D_.data(), hdr);
+
+    ostr.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+    ostr.write(reinterpret_cast<const char*>(salts_.data()), salts_.size() * sizeof(uint64_t));
+    ostr.write(reinterpret_cast<const char*>(H_.data()), H_.size() * sizeof(hdr_t));
+    ostr.write(reinterpret_cast<const char*>(D_.data()), D_.size() * sizeof(slot_t));
+
+    return ostr.good();
+  }
+
+  // Reads a serialized table from memory; false, leaving an empty table,
+  // if it is not a complete table or its checksum does not match
+  bool unserialize(const char* data, size_t size) {
+    int_table_header_t hdr;
+
+    if (size < sizeof(hdr)) {
+      clear();
+      return false;
+    }
+
+    std::memcpy(&hdr, data, sizeof(hdr));
+
+    if ((std::memcmp(hdr.magic_, traits::magic(), sizeof(hdr.magic_)) != 0) ||
+        (hdr.version_ != INT_TABLE_VERSION) || (hdr.s_ == 0) || ((hdr.s_ & (hdr.s_ - 1)) != 0) ||
+        (hdr.num_slots_ == 0) || (hdr.num_salts_ > size) || (hdr.s_ > size) || (hdr.num_slots_ > size) ||
+        (hdr.n_ > hdr.num_slots_) || (hdr.s_ != num_groups(hdr.n_)) ||
+        (size != sizeof(hdr) + hdr.num_salts_ * sizeof(uint64_t) + hdr.s_ * sizeof(hdr_t) +
+                 hdr.num_slots_ * sizeof(slot_t))) {
+      clear();
+      return false;
+    }
+
+    const char* salts = data + sizeof(hdr);
+    const char* H     = salts + hdr.num_salts_ * sizeof(uint64_t);
+    const char* D     = H + hdr.s_ * sizeof(hdr_t);
+
+    if (checksum(salts, H, D, hdr) != hdr.checksum_) {
+      clear();
+      return false;
+    }
+
+    salts_.resize(hdr.num_salts_);
+    H_.resize(hdr.s_);
+    D_.resize(hdr.num_slots_);
+
+    std::memcpy(salts_.data(), salts, salts_.size() * sizeof(uint64_t));
+    std::memcpy(H_.data(), H, H_.size() * sizeof(hdr_t));
+    std::memcpy(D_.data(), D, D_.size() * sizeof(slot_t));
+
+    // every group must lie within D and use a salt that exists
+    for (const hdr_t& g : H_) {
+      if ((g.p_ + std::max<uint64_t>(g.r_, 1) > D_.size()) || ((g.r_ > 1) && (g.i_ >= salts_.size()))) {
+        clear();
+        return false;
+      }
+    }
+
+    // and D must hold n keys
+    uint64_t keys = 0;
+
+    for (const slot_t& dat : D_) {
+      keys += (dat.val_ != EMPTY_VAL);
+    }
+
+    if (keys != hdr.n_) {
+      clear();
+      return false;
+    }
+
+    seed_ = hdr.seed_;
+    n_    = hdr.n_;
+    s_    = hdr.s_;
+
+    return true;
+  }
+
+  bool unserialize(std::istream& istr) {
+    std::string data((std::istreambuf_iterator<char>(istr)), std::istreambuf_iterator<char>());
+
+    return unserialize(data.data(), data.size());
+  }
+
+private:
+  void clear() {
+    seed_ = 0;
+    n_    = 0;
+    s_    = 1;
+
+    salts_.clear();
+    H_.assign(1, hdr_t());
+    D_.assign(1, empty_slot());
+  }
+
+  // Groups for n keys: n = ps as in Table::setup(), s a power of two
+  static uint64_t num_groups(uint64_t n) {
+    uint64_t s = 1;
+
+    while (s <= static_cast<uint64_t>(static_cast<double>(n) / DEFAULT_LOADING_FACTOR)) {
+      s <<= 1;
+    }
+
+    return s;
+  }
+
+  static slot_t empty_slot() {
+    return slot_t{Key(), EMPTY_VAL};
+  }
+
+  uint64_t group(const Key& k) const {
+    return traits::mix(k, seed_) & (s_ - 1);
+  }
+
+  // h[i](k), or 0 for groups of one key (or none)
+  uint64_t slot(const hdr_t& hdr, const Key& k) const {
+    return (hdr.r_ > 1) ? slot(salts_[hdr.i_], k, hdr.r_) : 0;
+  }
+
+  static uint64_t slot(uint64_t salt, const Key& k, uint64_t r) {
+    return ((traits::mix(k, salt) >> 32) * r) >> 32;
+  }
+
+  // The first salt with no collisions for the distinct keys of a group,
+  // trying DEFAULT_ATTEMPTS salts for each size from r up
+  void find_salt(const std::vector<Key>& members, SplitMix64& random, std::vector<uint8_t>& used,
+                 hdr_t& hdr) {
+    for (uint64_t r = members.size();; r++) {
+      for (uint64_t i = 0; i < DEFAULT_ATTEMPTS; i++) {
+        if (i == salts_.size()) {
+          salts_.push_back(random.next());
+        }
+
+        used.assign(r, 0);
+
+        bool found = true;
+
+        for (const Key& k : members) {
+          uint64_t idx = slot(salts_[i], k, r);
+
+          if (used[idx] != 0) {
+            found = false;
+            break;
+          }
+
+          used[idx] = 1;
+        }
+
+        if (found) {
+          hdr.i_ = static_cast<uint32_t>(i);
+          hdr.r_ = static_cast<uint32_t>(r);
+          return;
+        }
+      }
+    }
+  }
+
+  static uint64_t checksum(const void* salts, const void* H, const void* D, const int_table_header_t& hdr) {
+    crc_64_type        crc;
+    int_table_header_t fields = hdr;
+
+    fields.checksum_ = 0;
+    crc.process_bytes(&fields, sizeof(fields));
+    crc.process_bytes(salts, hdr.num_salts_ * sizeof(uint64_t));
+    crc.process_bytes(H, hdr.s_ * sizeof(hdr_t));
+    crc.process_bytes(D, hdr.num_slots_ * sizeof(slot_t));
+
+    return crc.checksum();
+  }
+
+  uint64_t seed_;
+  uint64_t n_;
+  uint64_t s_;
+  // salt of each second level function h[i]
+  std::vector<uint64_t>        salts_;
+  std::vector<hdr_t>           H_;
+  std::vector<slot_t>          D_;
+  // pairs of equal keys, when load() fails on them
+  std::vector<int_collision_t> collisions_;
+};
+
+typedef BasicIntTable<uint64_t>         IntTable;
+typedef BasicIntTable<fingerprint128_t> FingerprintTable;
+
+#endif  // _INTTABLE_H
@@ -0,0 +1,344 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	KeyGenerator.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Synthetic key sets for testing and benchmarks
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _KEYGENERATOR_H
+#define _KEYGENERATOR_H
+
+// KeyGenerator produces count distinct keys of a given shape. The same
+// shape, count, seed and length always give the same keys in the same
+// order. Keys are distinct by construction: each one embeds a bijection
+// of its index, and the rest of the key is random filler. Keys never
+// contain whitespace, so they can be written one per line for pph.
+
+typedef enum _key_shape {
+  // printable ASCII ('!' to '~') of a fixed length
+  KEYS_ASCII,
+  // https://www.host.tld/path/segments/id
+  KEYS_URL,
+  // random (version 4) UUIDs
+  KEYS_UUID,
+  // decimal numbers up to 20 digits
+  KEYS_NUMERIC,
+  // file paths sharing long prefixes
+  KEYS_PATH,
+  // printable ASCII, mostly short with a long tail up to length
+  KEYS_SKEWED
+} key_shape_t;
+
+static const char* const KEY_SHAPE_NAMES[] = {
+  "ascii", "url", "uuid", "numeric", "path", "skewed"
+};
+
+static constexpr size_t KEY_SHAPE_COUNT = sizeof(KEY_SHAPE_NAMES) / sizeof(KEY_SHAPE_NAMES[0]);
+
+// Characters of ASCII keys, and the base their index is written in
+static constexpr uint64_t KEY_ALPHABET_FIRST = '!';
+static constexpr uint64_t KEY_ALPHABET_SIZE  = '~' - '!' + 1;
+
+// Throws std::invalid_argument for an unknown name
+inline key_shape_t key_shape(const std::string& name) {
+  for (size_t i = 0; i < KEY_SHAPE_COUNT; i++) {
+    if (name == KEY_SHAPE_NAMES[i]) {
+      return static_cast<key_shape_t>(i);
+    }
+  }
+
+  throw std::invalid_argument("unknown key shape '" + name + "'");
+}
+
+inline std::string key_shape_name(key_shape_t shape) {
+  return KEY_SHAPE_NAMES[shape];
+}
+
+// SplitMix64 finalizer; a bijection on 64-bit values
+inline uint64_t key_mix(uint64_t x) {
+  x ^= x >> 30;
+  x *= UINT64_C(0xbf58476d1ce4e5b9);
+  x ^= x >> 27;
+  x *= UINT64_C(0x94d049bb133111eb);
+  x ^= x >> 31;
+  return x;
+}
+
+// (a * b) mod m
+inline uint64_t key_mulmod(uint64_t a, uint64_t b, uint64_t m) {
+#if defined(__SIZEOF_INT128__)
+  return static_cast<uint64_t>((static_cast<unsigned __int128>(a) * b) % m);
+#else
+  uint64_t result = 0;
+
+  a %= m;
+
+  for (; b != 0; b >>= 1) {
+    if (b & 1) {
+      result = (result >= m - a) ? result - (m - a) : result + a;
+    }
+
+    a = (a >= m - a) ? a - (m - a) : a + a;
+  }
+
+  return result;
+#endif
+}
+
+class KeyGenerator {
+public:
+  // length is the length of ASCII keys and the longest skewed key
+  KeyGenerator(key_shape_t shape, uint64_t count, uint64_t seed = 0, size_t length = 16) :
+    shape_(shape), count_(count), seed_(seed), length_(length), index_(0),
+    digits_(1), range_(KEY_ALPHABET_SIZE), step_(1), random_(seed) {
+    // digits_ base-94 digits number count_ keys
+    while (range_ < count_) {
+      if (range_ > (UINT64_MAX / KEY_ALPHABET_SIZE)) {
+        range_ = 0;  // 94^10 wraps; 2^64 values
+        digits_++;
+        break;
+      }
+
+      range_ *= KEY_ALPHABET_SIZE;
+      digits_++;
+    }
+
+    if (((shape_ == KEYS_ASCII) || (shape_ == KEYS_SKEWED)) && (length_ < digits_)) {
+      throw std::invalid_argument("KeyGenerator: length too short for the number of keys");
+    }
+
+    // an odd multiplier that is not a multiple of 47 permutes [0, 94^digits)
+    step_ = (key_mix(seed_) | 1);
+
+    while ((step_ % 47) == 0) {
+      step_ += 2;
+    }
+  }
+
+  uint64_t count() const {
+    return count_;
+  }
+
+  // Number of keys returned so far
+  uint64_t generated() const {
+    return index_;
+  }
+
+  void reset() {
+    index_ = 0;
+    random_.seed(seed_);
+  }
+
+  // Sets key to the next key; false after count() keys
+  bool next(std::string& key) {
+    if (index_ >= count_) {
+      return false;
+    }
+
+    switch (shape_) {
+      case KEYS_ASCII:
+        ascii_key(key, length_);
+        break;
+      case KEYS_URL:
+        url_key(key);
+        break;
+      case KEYS_UUID:
+        uuid_key(key);
+        break;
+      case KEYS_NUMERIC:
+        key = std::to_string(unique());
+        break;
+      case KEYS_PATH:
+        path_key(key);
+        break;
+      case KEYS_SKEWED:
+        ascii_key(key, skewed_length());
+        break;
+    }
+
+    index_++;
+
+    return true;
+  }
+
+private:
+  // Distinct for each index
+  uint64_t unique() const {
+    return key_mix(index_ + seed_);
+  }
+
+  uint64_t random() {
+    return random_();
+  }
+
+  char random_char(const char* chars, size_t size) {
+    return chars[random() % size];
+  }
+
+  // Filler followed by the index permuted in [0, 94^digits) as base-94 digits
+  void ascii_key(std::string& key, size_t length) {
+    uint64_t id = index_ * step_ + key_mix(seed_ + 1);
+
+    if (range_ != 0) {
+      id = (key_mulmod(index_, step_, range_) + (key_mix(seed_ + 1) % range_)) % range_;
+    }
+
+    key.resize(length);
+
+    for (size_t i = 0; i < length - digits_; i++) {
+      key[i] = static_cast<char>(KEY_ALPHABET_FIRST + (random() % KEY_ALPHABET_SIZE));
+    }
+
+    for (size_t i = length; i > length - digits_; i--) {
+      key[i - 1] = static_cast<char>(KEY_ALPHABET_FIRST + (id % KEY_ALPHABET_SIZE));
+      id /= KEY_ALPHABET_SIZE;
+    }
+  }
+
+  // Half the keys are 4-8 characters, each longer range up to length_ has half as many
+  size_t skewed_length() {
+    size_t length = 4 + (random() % 5);
+
+    while ((length < length_) && ((random() & 1) != 0)) {
+      length = std::min(length_, length * 2);
+    }
+
+    return std::max(length, digits_);
+  }
+
+  void url_key(std::string& key) {
+    static const char* const tlds[] = {"com", "org", "net", "io", "de", "co.uk", "info", "dev"};
+    static const char* const letters = "abcdefghijklmnopqrstuvwxyz";
+    static const char* const base36  = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+    key = (random() % 4 == 0) ? "http://" : "https://www.";
+
+    word(key, letters, 26, 4 + (random() % 9));
+    key += ".";
+    key += tlds[random() % 8];
+
+    size_t segments = 1 + (random() % 4);
+
+    for (size_t i = 0; i < segments; i++) {
+      key += "/";
+      word(key, letters, 26, 3 + (random() % 10));
+    }
+
+    key += "/";
+
+    for (uint64_t id = unique(); id != 0; id /= 36) {
+      key += base36[id % 36];
+    }
+  }
+
+  void word(std::string& key, const char* chars, size_t size, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+      key += random_char(chars, size);
+    }
+  }
+
+  // The 64 bits of unique() and 58 random bits around the version and variant
+  void uuid_key(std::string& key) {
+    uint64_t u  = unique();
+    uint64_t hi = (u & UINT64_C(0xFFFFFFFFFFFF0000)) | UINT64_C(0x4000) | (u & UINT64_C(0x0FFF));
+    uint64_t lo = UINT64_C(0x8000000000000000) | (((u >> 12) & UINT64_C(0xF)) << 58) |
+                  (random() & ((UINT64_C(1) << 58) - 1));
+
+    std::ostringstream stream;
+
+    stream << std::hex << std::setfill('0')
+           << std::setw(8) << (hi >> 32) << "-"
+           << std::setw(4) << ((hi >> 16) & 0xFFFF) << "-"
+           << std::setw(4) << (hi & 0xFFFF) << "-"
+           << std::setw(4) << (lo >> 48) << "-"
+           << std::setw(12) << (lo & UINT64_C(0xFFFFFFFFFFFF));
+
+    key = stream.str();
+  }
+
+  // /srv/data/<one of 4 roots>/<index in base 16, two digits per directory>.dat
+  void path_key(std::string& key) {
+    static const char* const roots[] = {"customers", "orders", "products", "sessions"};
+    static const char* const hex     = "0123456789abcdef";
+
+    std::string digits;
+
+    for (uint64_t id = index_; (id != 0) || digits.empty(); id /= 16) {
+      digits.insert(digits.begin(), hex[id % 16]);
+    }
+
+    if (digits.size() % 2 != 0) {
+      digits.insert(digits.begin(), '0');
+    }
+
+    key  = "/srv/data/";
+    key += roots[index_ % 4];
+
+    for (size_t i = 0; i < digits.size(); i += 2) {
+      key += "/";
+      key += digits.substr(i, 2);
+    }
+
+    key += ".dat";
+  }
+
+  key_shape_t      shape_;
+  uint64_t         count_;
+  uint64_t         seed_;
+  size_t           length_;
+  uint64_t         index_;
+  // base-94 digits, and 94^digits_ (0 if that is 2^64 or more)
+  size_t           digits_;
+  uint64_t         range_;
+  uint64_t         step_;
+  XorShift1024Star random_;
+};
+
+// Writes the keys one per line; returns the number written
+inline uint64_t write_keys(KeyGenerator& generator, std::ostream& ostr) {
+  std::string key;
+  uint64_t    count = 0;
+
+  while (generator.next(key)) {
+    ostr << key << '\n';
+    count++;
+  }
+
+  return count;
+}
+
+inline std::vector<std::string> generate_keys(key_shape_t shape, uint64_t count,
+                                              uint64_t seed = 0, size_t length = 16) {
+  KeyGenerator generator(shape, count, seed, length);
+  std::vector<std::string> keys;
+  std::string key;
+
+  keys.reserve(count);
+
+  while (generator.next(key)) {
+    keys.push_back(key);
+  }
+
+  return keys;
+}
+
+#endif  // _KEYGENERATOR_H
@@ -0,0 +1,286 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	LookupStats.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Lookup counters and latency histograms
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _LOOKUPSTATS_H
+#define _LOOKUPSTATS_H
+
+// Statistics of the lookups in a Table: counts, hits, a latency histogram
+// and the sizes of the groups probed. The first STATS_SHARDS - 1 threads
+// each own a shard and update it with relaxed loads and stores; any other
+// threads share the last shard and use atomic adds. Recording never takes
+// a lock, and snapshot() adds up the shards.
+//
+// Latencies are recorded in nanoseconds in log-linear buckets (as in HDR
+// histograms): values below 16 have a bucket each, larger values share a
+// bucket with the values that have the same 4 leading bits, so a bucket
+// is at most 1/16 of its value wide.
+//
+// Build with -DPPH_STATS=0 to compile out the recording in Table.
+
+static constexpr size_t STATS_SUB_BITS        = 4;
+static constexpr size_t STATS_SUB_BUCKETS     = (1 << STATS_SUB_BITS);
+static constexpr size_t STATS_LATENCY_BUCKETS = (64 - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS;
+// the last group size counts groups of 64 or more keys
+static constexpr size_t STATS_GROUP_SIZES     = 65;
+static constexpr size_t STATS_SHARDS          = 16;
+static constexpr size_t STATS_ALIGNMENT       = 64;
+
+inline uint64_t stats_clock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+inline size_t latency_bucket(uint64_t ns) {
+  if (ns < STATS_SUB_BUCKETS) {
+    return static_cast<size_t>(ns);
+  }
+
+#if defined(__GNUC__) || defined(__clang__)
+  size_t e = 63 - __builtin_clzll(ns);
+#else
+  size_t e = 0;
+
+  for (uint64_t x = ns; x > 1; x >>= 1) {
+    e++;
+  }
+#endif
+
+  return ((e - STATS_SUB_BITS + 1) * STATS_SUB_BUCKETS) +
+         static_cast<size_t>((ns >> (e - STATS_SUB_BITS)) & (STATS_SUB_BUCKETS - 1));
+}
+
+// Smallest latency that falls in bucket b
+inline uint64_t latency_bucket_min(size_t b) {
+  if (b < STATS_SUB_BUCKETS) {
+    return b;
+  }
+
+  size_t e = (b / STATS_SUB_BUCKETS) + STATS_SUB_BITS - 1;
+
+  return (STATS_SUB_BUCKETS + (b % STATS_SUB_BUCKETS)) << (e - STATS_SUB_BITS);
+}
+
+// Sum of all shards
+typedef struct _lookup_stats {
+  _lookup_stats() : lookups_(0), hits_(0), misses_(0), latency_ns_(0),
+                    latency_(STATS_LATENCY_BUCKETS, 0),
+                    group_size_(STATS_GROUP_SIZES, 0) {}
+
+  double hit_ratio() const {
+    return (lookups_ == 0) ? 0.0 : static_cast<double>(hits_) / lookups_;
+  }
+
+  double mean() const {
+    return (lookups_ == 0) ? 0.0 : static_cast<double>(latency_ns_) / lookups_;
+  }
+
+  // Latency (lower bound of its bucket) that q of the lookups did not exceed
+  uint64_t percentile(double q) const {
+    uint64_t rank  = static_cast<uint64_t>(std::ceil(q * lookups_));
+    uint64_t count = 0;
+
+    for (size_t b = 0; b < latency_.size(); b++) {
+      count += latency_[b];
+
+      if ((count > 0) && (count >= rank)) {
+        return latency_bucket_min(b);
+      }
+    }
+
+    return 0;
+  }
+
+  void print(std::ostream& ostr) const {
+    ostr << "lookups " << lookups_ << std::endl;
+    ostr << "hits " << hits_ << std::endl;
+    ostr << "misses " << misses_ << std::endl;
+    ostr << "hit_ratio " << hit_ratio() << std::endl;
+    ostr << "latency_mean_ns " << mean() << std::endl;
+
+    for (double q : {0.5, 0.9, 0.99, 0.999, 1.0}) {
+      ostr << "latency_p" << (q * 100) << "_ns " << percentile(q) << std::endl;
+    }
+
+    for (size_t r = 0; r < group_size_.size(); r++) {
+      if (group_size_[r] != 0) {
+        ostr << "group_size " << r << " " << group_size_[r] << std::endl;
+      }
+    }
+  }
+
+  uint64_t lookups_;
+  uint64_t hits_;
+  uint64_t misses_;
+  // total latency of all lookups
+  uint64_t latency_ns_;
+  // lookups per latency bucket (see latency_bucket_min)
+  std::vector<uint64_t> latency_;
+  // lookups per number of keys in the probed group (0: empty group)
+  std::vector<uint64_t> group_size_;
+} lookup_stats_t;
+
+// Counters of one or more threads, on their own cache lines
+typedef struct alignas(STATS_ALIGNMENT) _stats_shard {
+  std::atomic<uint64_t> lookups_;
+  std::atomic<uint64_t> hits_;
+  std::atomic<uint64_t> latency_ns_;
+  std::atomic<uint64_t> latency_[STATS_LATENCY_BUCKETS];
+  std::atomic<uint64_t> group_size_[STATS_GROUP_SIZES];
+} stats_shard_t;
+
+static constexpr size_t STATS_SHARED_SHARD    = STATS_SHARDS - 1;
+
+// Shard owned by the calling thread until it exits, or STATS_SHARED_SHARD
+class StatsShardOwner {
+public:
+  StatsShardOwner() : shard_(STATS_SHARED_SHARD) {
+    for (size_t i = 0; i < STATS_SHARED_SHARD; i++) {
+      bool expected = false;
+
+      if (owned()[i].compare_exchange_strong(expected, true)) {
+        shard_ = i;
+        break;
+      }
+    }
+  }
+
+  ~StatsShardOwner() {
+    if (shard_ != STATS_SHARED_SHARD) {
+      owned()[shard_].store(false);
+    }
+  }
+
+  size_t shard() const {
+    return shard_;
+  }
+
+private:
+  static std::atomic<bool>* owned() {
+    static std::atomic<bool> owned[STATS_SHARED_SHARD] = {};
+    return owned;
+  }
+
+  size_t shard_;
+};
+
+inline size_t stats_shard() {
+  thread_local StatsShardOwner owner;
+  return owner.shard();
+}
+
+class LookupStats {
+public:
+  LookupStats() {
+    reset();
+  }
+
+  // Aligned so that shards do not share cache lines
+  static std::shared_ptr<LookupStats> create() {
+    void* p = nullptr;
+
+    if (posix_memalign(&p, STATS_ALIGNMENT, sizeof(LookupStats)) != 0) {
+      throw std::bad_alloc();
+    }
+
+    return std::shared_ptr<LookupStats>(new (p) LookupStats(), [](LookupStats* stats) {
+      stats->~LookupStats();
+      std::free(stats);
+    });
+  }
+
+  void record(uint64_t ns, bool hit, uint64_t group_size) {
+    size_t         i     = stats_shard();
+    stats_shard_t& shard = shards_[i];
+
+    if (i == STATS_SHARED_SHARD) {
+      record<true>(shard, ns, hit, group_size);
+    } else {
+      record<false>(shard, ns, hit, group_size);
+    }
+  }
+
+  lookup_stats_t snapshot() const {
+    lookup_stats_t stats;
+
+    for (const stats_shard_t& shard : shards_) {
+      stats.lookups_    += shard.lookups_.load(std::memory_order_relaxed);
+      stats.hits_       += shard.hits_.load(std::memory_order_relaxed);
+      stats.latency_ns_ += shard.latency_ns_.load(std::memory_order_relaxed);
+
+      for (size_t b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+        stats.latency_[b] += shard.latency_[b].load(std::memory_order_relaxed);
+      }
+
+      for (size_t r = 0; r < STATS_GROUP_SIZES; r++) {
+        stats.group_size_[r] += shard.group_size_[r].load(std::memory_order_relaxed);
+      }
+    }
+
+    stats.misses_ = stats.lookups_ - stats.hits_;
+
+    return stats;
+  }
+
+  void reset() {
+    for (stats_shard_t& shard : shards_) {
+      shard.lookups_.store(0, std::memory_order_relaxed);
+      shard.hits_.store(0, std::memory_order_relaxed);
+      shard.latency_ns_.store(0, std::memory_order_relaxed);
+
+      for (auto& count : shard.latency_) {
+        count.store(0, std::memory_order_relaxed);
+      }
+
+      for (auto& count : shard.group_size_) {
+        count.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+private:
+  template<bool SHARED>
+  static void add(std::atomic<uint64_t>& count, uint64_t value) {
+    if (SHARED) {
+      count.fetch_add(value, std::memory_order_relaxed);
+    } else {
+      // only the owner writes, so no read-modify-write is needed
+      count.store(count.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+  }
+
+  template<bool SHARED>
+  static void record(stats_shard_t& shard, uint64_t ns, bool hit, uint64_t group_size) {
+    add<SHARED>(shard.lookups_, 1);
+    add<SHARED>(shard.hits_, hit ? 1 : 0);
+    add<SHARED>(shard.latency_ns_, ns);
+    add<SHARED>(shard.latency_[latency_bucket(ns)], 1);
+    add<SHARED>(shard.group_size_[std::min<uint64_t>(group_size, STATS_GROUP_SIZES - 1)], 1);
+  }
+
+  stats_shard_t shards_[STATS_SHARDS];
+};
+
+#endif  // _LOOKUPSTATS_H
@@ -0,0 +1,169 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	SharedTable.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Tables published in shared memory for other processes
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _SHAREDTABLE_H
+#define _SHAREDTABLE_H
+
+// Table::publish_shared() writes the FrozenTable block of a table to a
+// POSIX shared memory object (shm_open) or, for a name with a directory
+// in it, to a file such as /dev/shm/keywords.pph. attach_shared() maps it
+// read-only: every process looks keys up in the same physical pages, with
+// no parsing and no copying, so memory per host does not grow with the
+// number of workers.
+//
+// The magic number of the block is written last, so attaching during a
+// publish fails instead of seeing part of a table. Publishing again under
+// the same name replaces the object (unlink, then create; rename() for
+// files); processes that already attached keep the old table until they
+// detach.
+
+static constexpr mode_t SHARED_TABLE_MODE = 0644;
+
+// Names with a '/' after the first character are file paths
+inline bool shared_table_is_path(const std::string& name) {
+  return (name.find('/', 1) != std::string::npos);
+}
+
+// POSIX shared memory object names start with a single '/'
+inline std::string shared_table_object(const std::string& name) {
+  return (!name.empty() && (name[0] == '/')) ? name : "/" + name;
+}
+
+inline bool shared_table_write(int fd, const char* data, uint64_t size) {
+  // the magic number last
+  uint64_t offset = sizeof(FROZEN_MAGIC);
+
+  if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+    return false;
+  }
+
+  while (offset < size) {
+    ssize_t written = pwrite(fd, data + offset, size - offset, static_cast<off_t>(offset));
+
+    if (written <= 0) {
+      if ((written < 0) && (errno == EINTR)) {
+        continue;
+      }
+      return false;
+    }
+
+    offset += static_cast<uint64_t>(written);
+  }
+
+  return (pwrite(fd, data, sizeof(FROZEN_MAGIC), 0) == static_cast<ssize_t>(sizeof(FROZEN_MAGIC)));
+}
+
+// Writes the block of frozen under name
+inline bool publish_shared(const FrozenTable& frozen, const std::string& name) {
+  if (shared_table_is_path(name)) {
+    std::string temp = name + ".tmp." + std::to_string(getpid());
+    int fd = open(temp.c_str(), O_CREAT | O_TRUNC | O_WRONLY, SHARED_TABLE_MODE);
+
+    if (fd < 0) {
+      return false;
+    }
+
+    bool ok = shared_table_write(fd, frozen.data(), frozen.bytes());
+
+    ok = (close(fd) == 0) && ok;
+
+    if (!ok || (rename(temp.c_str(), name.c_str()) != 0)) {
+      unlink(temp.c_str());
+      return false;
+    }
+
+    return true;
+  }
+
+  std::string object = shared_table_object(name);
+
+  // never truncate an object that other processes have mapped
+  shm_unlink(object.c_str());
+
+  int fd = shm_open(object.c_str(), O_CREAT | O_EXCL | O_RDWR, SHARED_TABLE_MODE);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  bool ok = shared_table_write(fd, frozen.data(), frozen.bytes());
+
+  close(fd);
+
+  if (!ok) {
+    shm_unlink(object.c_str());
+  }
+
+  return ok;
+}
+
+inline bool Table::publish_shared(const std::string& name) const {
+  return pph::publish_shared(FrozenTable(*this), name);
+}
+
+// Maps the table published under name read-only; key overrides the top
+// level key function as in FrozenTable::attach()
+inline bool attach_shared(const std::string& name, FrozenTable& frozen, keyfunc_t key = nullptr) {
+  int fd = shared_table_is_path(name) ? open(name.c_str(), O_RDONLY)
+                                      : shm_open(shared_table_object(name).c_str(), O_RDONLY, 0);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  struct stat st;
+
+  if ((fstat(fd, &st) != 0) || (static_cast<size_t>(st.st_size) < sizeof(frozen_header_t))) {
+    close(fd);
+    return false;
+  }
+
+  size_t size = static_cast<size_t>(st.st_size);
+  void*  addr = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+
+  close(fd);
+
+  if (addr == MAP_FAILED) {
+    return false;
+  }
+
+  std::shared_ptr<char> block(static_cast<char*>(addr), [size](char* p) {
+    munmap(p, size);
+  });
+
+  return frozen.attach(block, size, key);
+}
+
+// Removes the name; attached processes keep their mapping
+inline bool unlink_shared(const std::string& name) {
+  if (shared_table_is_path(name)) {
+    return (unlink(name.c_str()) == 0);
+  }
+
+  return (shm_unlink(shared_table_object(name).c_str()) == 0);
+}
+
+#endif  // _SHAREDTABLE_H
@@ -0,0 +1,304 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	StaticTable.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Tables of keys written in the source, built by the compiler
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _STATICTABLE_H
+#define _STATICTABLE_H
+
+// StaticTable is a table of keys known at compile time (HTTP header names,
+// the names of an enum, SQL keywords), built by a constexpr constructor:
+//
+//   static constexpr auto methods = pph::make_static_table("GET", "HEAD", "POST", "PUT");
+//
+//   static_assert(methods.find_val("POST") == 2);
+//
+// The value of a key is its position in the list, and key(value) gives it
+// back. It has the layout of Table: a key picks a group of H with the top
+// level hash, and h[i](k,r) = mod(mod(k + adjustment, modulus), r) places
+// it within the r slots of the group in D, k being the key function with
+// the multiplier of h[i]. Groups take the first function of h that has no
+// collisions for them, as find_h() does, or a new one with a random
+// multiplier and modulus. Unlike Table, groups keep their size and are
+// placed one after another, so D has exactly one slot per key. Lookups
+// index three arrays and compare one key; groups of one key skip the
+// second hash.
+//
+// Needs C++17, and none of pph.h, so it can be included from any number of
+// translation units. Compilers limit the work of a constant expression;
+// tables of a few thousand keys may need -fconstexpr-steps (clang) or
+// -fconstexpr-ops-limit (gcc) raised. Duplicate keys, or a set for which no
+// functions are found, fail to compile; another Seed usually finds them.
+
+#if __cplusplus < 201703L
+#error "StaticTable.h needs C++17"
+#endif
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+
+namespace pph {
+
+static constexpr uint64_t STATIC_TABLE_NOT_FOUND = UINT64_MAX;
+
+// New functions tried for a group before giving up
+static constexpr uint64_t STATIC_TABLE_ATTEMPTS  = UINT64_C(1) << 16;
+
+// Same arithmetic as djb_hash_buf and fnv64a_hash_buf in pph.h
+struct static_djb_hash {
+  static constexpr uint64_t hash(std::string_view k, uint64_t multiplier) {
+    uint64_t h = 0;
+
+    for (char c : k) {
+      h = (h * multiplier) ^ static_cast<uint64_t>(c);
+    }
+
+    return h;
+  }
+};
+
+struct static_fnv64a_hash {
+  static constexpr uint64_t hash(std::string_view k, uint64_t multiplier) {
+    uint64_t h = UINT64_C(0xcbf29ce484222325);
+
+    (void)multiplier;
+
+    for (char c : k) {
+      h = (h ^ static_cast<uint64_t>(c)) * UINT64_C(0x100000001b3);
+    }
+
+    return h;
+  }
+};
+
+// Groups for n keys: a power of two above n / DEFAULT_LOADING_FACTOR, as
+// Table::setup() chooses s
+constexpr size_t static_table_groups(size_t n) {
+  size_t s = 1;
+
+  while (s <= (n * 100) / 97) {
+    s <<= 1;
+  }
+
+  return s;
+}
+
+template<size_t N, typename Hash = static_djb_hash, uint64_t Seed = 0>
+class StaticTable {
+public:
+  static constexpr size_t   NUM_GROUPS = static_table_groups(N);
+  // odd, so the top level hash uses all of its bits mod 2^k
+  static constexpr uint64_t MULTIPLIER = UINT64_C(65);
+
+  constexpr explicit StaticTable(const std::array<std::string_view, N>& keys) : keys_(keys) {
+    std::array<uint64_t, N> hashes{};
+    // keys by group, from counts like a counting sort
+    std::array<uint32_t, N> order{};
+    std::array<uint32_t, NUM_GROUPS + 1> start{};
+    uint64_t random = Seed;
+
+    for (size_t j = 0; j < N; j++) {
+      hashes[j] = Hash::hash(keys_[j], MULTIPLIER);
+      start[group(hashes[j]) + 1]++;
+    }
+
+    for (size_t g = 0; g < NUM_GROUPS; g++) {
+      start[g + 1] += start[g];
+    }
+
+    std::array<uint32_t, NUM_GROUPS + 1> fill = start;
+
+    for (size_t j = 0; j < N; j++) {
+      order[fill[group(hashes[j])]++] = static_cast<uint32_t>(j);
+    }
+
+    // h[0] places the key of a group of one
+    funcs_[0]  = func_t{1, MULTIPLIER, 0};
+    num_funcs_ = 1;
+
+    uint64_t p = 0;
+
+    for (size_t g = 0; g < NUM_GROUPS; g++) {
+      const uint32_t r = start[g + 1] - start[g];
+
+      if (r == 0) {
+        // a miss compares with the key in slot 0, which is in another group
+        groups_[g] = hdr_t{0, 0, 1};
+        continue;
+      }
+
+      const uint32_t* members = order.data() + start[g];
+      uint32_t i = (r == 1) ? 0 : find_h(members, r, random);
+
+      groups_[g] = hdr_t{p, i, r};
+
+      for (uint32_t j = 0; j < r; j++) {
+        slots_[p + slot(funcs_[i], keys_[members[j]], r)] = members[j];
+      }
+
+      p += r;
+    }
+  }
+
+  constexpr uint64_t find_val(std::string_view k) const {
+    const hdr_t&   g = groups_[group(Hash::hash(k, MULTIPLIER))];
+    const uint32_t s = slots_[g.p_ + ((g.r_ > 1) ? slot(funcs_[g.i_], k, g.r_) : 0)];
+
+    return ((N > 0) && (keys_[s] == k)) ? s : STATIC_TABLE_NOT_FOUND;
+  }
+
+  constexpr bool contains(std::string_view k) const {
+    return (find_val(k) != STATIC_TABLE_NOT_FOUND);
+  }
+
+  // The key whose value is val
+  constexpr std::string_view key(uint64_t val) const {
+    return keys_[val];
+  }
+
+  constexpr size_t size() const {
+    return N;
+  }
+
+  // Functions of h; fewer is more cache friendly
+  constexpr size_t num_funcs() const {
+    return num_funcs_;
+  }
+
+private:
+  typedef struct _hdr {
+    uint64_t p_;
+    uint32_t i_;
+    uint32_t r_;
+  } hdr_t;
+
+  typedef struct _func {
+    uint64_t modulus_;
+    uint64_t multiplier_;
+    uint64_t adjustment_;
+  } func_t;
+
+  static constexpr size_t group(uint64_t hash) {
+    return static_cast<size_t>(hash & (NUM_GROUPS - 1));
+  }
+
+  // h[i](k,r)
+  static constexpr uint64_t slot(const func_t& f, std::string_view k, uint32_t r) {
+    return ((Hash::hash(k, f.multiplier_) + f.adjustment_) % f.modulus_) % r;
+  }
+
+  // SplitMix64
+  static constexpr uint64_t next_random(uint64_t& state) {
+    uint64_t x = (state += UINT64_C(0x9e3779b97f4a7c15));
+
+    x = (x ^ (x >> 30)) * UINT64_C(0xbf58476d1ce4e5b9);
+    x = (x ^ (x >> 27)) * UINT64_C(0x94d049bb133111eb);
+
+    return x ^ (x >> 31);
+  }
+
+  constexpr bool no_collisions(const func_t& f, const uint32_t* members, uint32_t r) const {
+    uint64_t used = 0;
+
+    for (uint32_t j = 0; j < r; j++) {
+      uint64_t bit = UINT64_C(1) << slot(f, keys_[members[j]], r);
+
+      if ((used & bit) != 0) {
+        return false;
+      }
+
+      used |= bit;
+    }
+
+    return true;
+  }
+
+  // An existing function with no collisions for the group, or a new one
+  constexpr uint32_t find_h(const uint32_t* members, uint32_t r, uint64_t& random) {
+    if (r > 64) {
+      throw std::logic_error("pph::StaticTable: a group has more than 64 keys; try another Seed");
+    }
+
+    for (uint32_t j = 0; j < r; j++) {
+      for (uint32_t l = j + 1; l < r; l++) {
+        if (keys_[members[j]] == keys_[members[l]]) {
+          throw std::logic_error("pph::StaticTable: duplicate key");
+        }
+      }
+    }
+
+    for (uint32_t i = 1; i < num_funcs_; i++) {
+      if (no_collisions(funcs_[i], members, r)) {
+        return i;
+      }
+    }
+
+    for (uint64_t attempt = 0; attempt < STATIC_TABLE_ATTEMPTS; attempt++) {
+      // an odd modulus from 100r + 1 to 2^32, like find_h(), and an odd multiplier
+      uint64_t low        = 100 * static_cast<uint64_t>(r) + 1;
+      uint64_t modulus    = (low + next_random(random) % (UINT32_MAX - low)) | 1;
+      uint64_t multiplier = next_random(random) | 1;
+      uint64_t adjustment = 0;
+
+      // keys should be much greater than the modulus (suggest_adjustment_hash)
+      for (uint32_t j = 0; j < r; j++) {
+        uint64_t floor = modulus * UINT64_C(10000000);
+        uint64_t hash  = Hash::hash(keys_[members[j]], multiplier);
+
+        if ((hash < floor) && (floor - hash > adjustment)) {
+          adjustment = floor - hash;
+        }
+      }
+
+      func_t f{modulus, multiplier, adjustment};
+
+      if (no_collisions(f, members, r)) {
+        funcs_[num_funcs_] = f;
+        return num_funcs_++;
+      }
+    }
+
+    throw std::logic_error("pph::StaticTable: no hash function found for a group; try another Seed");
+  }
+
+  std::array<std::string_view, N> keys_{};
+  std::array<hdr_t, NUM_GROUPS>   groups_{};
+  // at most one function per group, and h[0]
+  std::array<func_t, NUM_GROUPS + 1> funcs_{};
+  uint32_t                        num_funcs_ = 0;
+  // values (positions of keys) in slot order
+  std::array<uint32_t, (N > 0) ? N : 1> slots_{};
+};
+
+template<typename Hash = static_djb_hash, uint64_t Seed = 0, typename... Keys>
+constexpr StaticTable<sizeof...(Keys), Hash, Seed> make_static_table(const Keys&... keys) {
+  return StaticTable<sizeof...(Keys), Hash, Seed>(std::array<std::string_view, sizeof...(Keys)>{keys...});
+}
+
+}  // namespace pph
+
+#endif  // _STATICTABLE_H
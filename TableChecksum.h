@@ -0,0 +1,355 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	TableChecksum.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Checksums of the sections of a table file
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _TABLECHECKSUM_H
+#define _TABLECHECKSUM_H
+
+// Table::serialize ends the file with a CRC-64 of each section (the same
+// CRC as crc_64_type, computed with crc64_update) and a digest of the
+// build parameters:
+//
+//   checksums
+//   header 0123456789abcdef
+//   functions ...
+//   parameters ...
+//   buckets ...
+//   data ...
+//   digest ...
+//
+// Sections are delimited the same way Table::unserialize reads them, so
+// TableChecksum can follow a file in one pass without parsing it. Only
+// files of TABLE_VERSION_LEGACY, written before the checksums were added,
+// load without a trailer.
+
+typedef enum _table_section {
+  // version, UUID, seed and number of functions
+  SECTION_HEADER,
+  // h_ array
+  SECTION_FUNCTIONS,
+  // H_ size, n, p, s, multiplier, adjustment, timeout
+  SECTION_PARAMETERS,
+  // H_ array
+  SECTION_BUCKETS,
+  // D_ size and array
+  SECTION_DATA,
+  TABLE_SECTIONS
+} table_section_t;
+
+static const char* const TABLE_SECTION_NAMES[] = {
+  "header", "functions", "parameters", "buckets", "data"
+};
+
+typedef struct _table_section_shape {
+  // lines the section always has
+  uint64_t lines_;
+  // the section goes on until a blank line after them
+  bool     until_blank_;
+} table_section_shape_t;
+
+static const table_section_shape_t TABLE_SECTION_SHAPES[] = {
+  {8, false}, {0, true}, {2, false}, {0, true}, {2, true}
+};
+
+static constexpr char TABLE_CHECKSUMS_TAG[] = "checksums";
+static constexpr char TABLE_DIGEST_TAG[]    = "digest";
+
+// CRC-64 of the build parameters in the form they are serialized
+inline uint64_t build_digest(const std::string& uuid, uint64_t seed, uint64_t n, double p,
+                             uint64_t s, uint64_t multiplier, uint64_t adjustment, uint64_t timeout) {
+  std::ostringstream stream;
+
+  stream << uuid << " " << seed << " " << n << " " << p << " " << s << " "
+         << multiplier << " " << adjustment << " " << timeout;
+
+  const std::string text = stream.str();
+  crc_64_type crc;
+
+  crc.process_bytes(text.data(), text.size());
+
+  return crc.checksum();
+}
+
+// Checksums stored in (or computed from) a table file
+typedef struct _table_checksums {
+  _table_checksums() : present_(false), digest_(0) {
+    std::fill(section_, section_ + TABLE_SECTIONS, 0);
+  }
+
+  // a trailer with every section and the digest was read
+  bool     present_;
+  uint64_t section_[TABLE_SECTIONS];
+  uint64_t digest_;
+} table_checksums_t;
+
+class TableChecksum {
+public:
+  TableChecksum() : section_(SECTION_HEADER), lines_(0), blank_(true) {
+    std::fill(crc_, crc_ + TABLE_SECTIONS, ~UINT64_C(0));
+  }
+
+  // Adds bytes of the file, in order; bytes after the last section are
+  // kept as the trailer
+  void update(const char* data, size_t len) {
+    const char* end   = data + len;
+    // first byte not yet added to crc_[section_]
+    const char* start = data;
+
+    while (data < end) {
+      if (section_ == TABLE_SECTIONS) {
+        trailer_.append(data, end - data);
+        return;
+      }
+
+      const char* nl = static_cast<const char*>(std::memchr(data, '\n', end - data));
+
+      for (const char* c = data; blank_ && (c < ((nl != nullptr) ? nl : end)); c++) {
+        blank_ = std::isspace(static_cast<unsigned char>(*c)) != 0;
+      }
+
+      if (nl == nullptr) {
+        data = end;
+        break;
+      }
+
+      data = nl + 1;
+
+      if (end_line()) {
+        crc_[section_] = crc64_update(crc_[section_], start, data - start);
+        section_ = static_cast<table_section_t>(section_ + 1);
+        start    = data;
+      }
+    }
+
+    if (section_ < TABLE_SECTIONS) {
+      crc_[section_] = crc64_update(crc_[section_], start, data - start);
+    }
+  }
+
+  // Adds a line read with std::getline
+  void update_line(const std::string& line) {
+    update(line.data(), line.size());
+    update("\n", 1);
+  }
+
+  // All sections have been read
+  bool complete() const {
+    return (section_ == TABLE_SECTIONS);
+  }
+
+  table_checksums_t checksums() const {
+    table_checksums_t sums;
+
+    for (size_t i = 0; i < TABLE_SECTIONS; i++) {
+      sums.section_[i] = ~crc_[i];
+    }
+
+    return sums;
+  }
+
+  // Checksums in the trailer added so far
+  table_checksums_t stored() const {
+    return read_trailer(trailer_);
+  }
+
+  static void write_trailer(std::ostream& ostr, const table_checksums_t& sums) {
+    ostr << TABLE_CHECKSUMS_TAG << std::endl;
+
+    for (size_t i = 0; i < TABLE_SECTIONS; i++) {
+      ostr << TABLE_SECTION_NAMES[i] << " " << hex(sums.section_[i]) << std::endl;
+    }
+
+    ostr << TABLE_DIGEST_TAG << " " << hex(sums.digest_) << std::endl;
+
+    ostr << std::endl;
+  }
+
+  static table_checksums_t read_trailer(const std::string& trailer) {
+    std::istringstream       istr(trailer);
+    std::string              line;
+    std::vector<std::string> fields;
+    table_checksums_t        sums;
+    size_t                   found = 0;
+
+    std::getline(istr, line);
+
+    if (trim(line) != TABLE_CHECKSUMS_TAG) {
+      return sums;
+    }
+
+    while (std::getline(istr, line)) {
+      line = trim(line);
+
+      if (line.empty())
+        break;
+
+      split(fields, line, " ");
+
+      if (fields.size() != 2) {
+        return table_checksums_t();
+      }
+
+      uint64_t value = std::strtoull(fields[1].c_str(), nullptr, 16);
+
+      if (fields[0] == TABLE_DIGEST_TAG) {
+        sums.digest_ = value;
+        found++;
+        continue;
+      }
+
+      for (size_t i = 0; i < TABLE_SECTIONS; i++) {
+        if (fields[0] == TABLE_SECTION_NAMES[i]) {
+          sums.section_[i] = value;
+          found++;
+        }
+      }
+    }
+
+    sums.present_ = (found == TABLE_SECTIONS + 1);
+
+    return sums;
+  }
+
+private:
+  static std::string hex(uint64_t value) {
+    std::ostringstream stream;
+    stream << std::hex << std::setw(16) << std::setfill('0') << value;
+    return stream.str();
+  }
+
+  // Counts a line; true if it ends the current section
+  bool end_line() {
+    const table_section_shape_t& shape = TABLE_SECTION_SHAPES[section_];
+    bool blank = blank_;
+
+    lines_++;
+    blank_ = true;
+
+    if ((lines_ >= shape.lines_) && (!shape.until_blank_ || ((lines_ > shape.lines_) && blank))) {
+      lines_ = 0;
+      return true;
+    }
+
+    return false;
+  }
+
+  table_section_t section_;
+  uint64_t        lines_;
+  // the current line has only whitespace so far
+  bool            blank_;
+  // CRC-64 registers (crc64_update), complemented when done
+  uint64_t        crc_[TABLE_SECTIONS];
+  std::string     trailer_;
+};
+
+// Passes everything written through to another stream buffer and adds it to a TableChecksum
+class ChecksumStreambuf : public std::streambuf {
+public:
+  ChecksumStreambuf(std::streambuf* target, TableChecksum& checksum) :
+    target_(target), checksum_(checksum) {}
+
+protected:
+  int_type overflow(int_type c) override {
+    if (traits_type::eq_int_type(c, traits_type::eof())) {
+      return traits_type::not_eof(c);
+    }
+
+    char ch = traits_type::to_char_type(c);
+
+    checksum_.update(&ch, 1);
+
+    return target_->sputc(ch);
+  }
+
+  std::streamsize xsputn(const char* s, std::streamsize count) override {
+    checksum_.update(s, static_cast<size_t>(count));
+    return target_->sputn(s, count);
+  }
+
+  int sync() override {
+    return target_->pubsync();
+  }
+
+private:
+  std::streambuf* target_;
+  TableChecksum&  checksum_;
+};
+
+// Result of check_table()
+typedef struct _table_check {
+  _table_check() : complete_(false), bytes_(0) {}
+
+  // every section was found
+  bool              complete_;
+  uint64_t          bytes_;
+  table_checksums_t computed_;
+  table_checksums_t stored_;
+
+  bool section_ok(size_t i) const {
+    return stored_.present_ && (computed_.section_[i] == stored_.section_[i]);
+  }
+
+  bool ok() const {
+    for (size_t i = 0; i < TABLE_SECTIONS; i++) {
+      if (!section_ok(i)) {
+        return false;
+      }
+    }
+
+    return complete_;
+  }
+} table_check_t;
+
+// Checksums a table file in one pass without unserializing it. The digest
+// of the build parameters is only compared by Table::unserialize, which
+// parses them; stored_.digest_ identifies the build.
+inline table_check_t check_table(std::istream& istr) {
+  static constexpr size_t CHECK_BUFFER_SIZE = 1 << 20;
+
+  std::vector<char> buffer(CHECK_BUFFER_SIZE);
+  TableChecksum     checksum;
+  table_check_t     result;
+
+  while (istr) {
+    istr.read(buffer.data(), buffer.size());
+
+    std::streamsize count = istr.gcount();
+
+    if (count <= 0) {
+      break;
+    }
+
+    checksum.update(buffer.data(), static_cast<size_t>(count));
+    result.bytes_ += static_cast<uint64_t>(count);
+  }
+
+  result.complete_ = checksum.complete();
+  result.computed_ = checksum.checksums();
+  result.stored_   = checksum.stored();
+
+  return result;
+}
+
+#endif  // _TABLECHECKSUM_H
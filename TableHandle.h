@@ -0,0 +1,375 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	TableHandle.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Hot swapping of tables in long-running processes
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _TABLEHANDLE_H
+#define _TABLEHANDLE_H
+
+// A TableHandle holds the current FrozenTable of a service. Readers take
+// a ReadGuard, which is wait-free: it records the global epoch in the
+// thread's reader slot and loads the current table. publish() swaps in
+// a new table atomically and retires the old one, which is deleted once
+// every reader that could have seen it has released its guard
+// (epoch-based reclamation).
+//
+// Tables can be loaded in the background (load_async) or reloaded when
+// the file changes (watch). Replace the file with rename() so a reload
+// never sees a partly written table.
+//
+// Practical lock-free buffer reclamation (epochs)
+// K Fraser - University of Cambridge, 2004
+//
+// https://lwn.net/Articles/262464/
+
+static constexpr size_t EPOCH_MAX_READERS = 1024;
+
+// Reader slot of one thread, on its own cache line
+typedef struct alignas(FROZEN_ALIGNMENT) _epoch_slot {
+  _epoch_slot() : in_use_(false), epoch_(0) {}
+  std::atomic<bool>     in_use_;
+  // epoch the thread entered in, 0 while it is not reading
+  std::atomic<uint64_t> epoch_;
+} epoch_slot_t;
+
+class EpochDomain {
+public:
+  EpochDomain() : epoch_(1) {}
+
+  uint64_t advance() {
+    return epoch_.fetch_add(1) + 1;
+  }
+
+  size_t acquire_slot() {
+    for (size_t i = 0; i < EPOCH_MAX_READERS; i++) {
+      bool expected = false;
+
+      if (!slots_[i].in_use_.load(std::memory_order_relaxed) &&
+          slots_[i].in_use_.compare_exchange_strong(expected, true)) {
+        return i;
+      }
+    }
+
+    throw std::runtime_error("EpochDomain: too many reader threads");
+  }
+
+  void release_slot(size_t i) {
+    slots_[i].epoch_.store(0);
+    slots_[i].in_use_.store(false);
+  }
+
+  void enter(size_t i) {
+    slots_[i].epoch_.store(epoch_.load());
+  }
+
+  void exit(size_t i) {
+    slots_[i].epoch_.store(0, std::memory_order_release);
+  }
+
+  // Oldest epoch a reader is in, or UINT64_MAX if nobody is reading
+  uint64_t min_active() const {
+    uint64_t oldest = UINT64_MAX;
+
+    for (size_t i = 0; i < EPOCH_MAX_READERS; i++) {
+      uint64_t e = slots_[i].epoch_.load();
+
+      if (e != 0) {
+        oldest = std::min(oldest, e);
+      }
+    }
+
+    return oldest;
+  }
+
+private:
+  std::atomic<uint64_t> epoch_;
+  epoch_slot_t          slots_[EPOCH_MAX_READERS];
+};
+
+inline EpochDomain& epoch_domain() {
+  static EpochDomain domain;
+  return domain;
+}
+
+// Slot of the calling thread, released when the thread exits.
+// Nested guards keep the epoch of the outermost one.
+class EpochReader {
+public:
+  EpochReader() : slot_(epoch_domain().acquire_slot()), depth_(0) {}
+
+  ~EpochReader() {
+    epoch_domain().release_slot(slot_);
+  }
+
+  void enter() {
+    if (depth_++ == 0) {
+      epoch_domain().enter(slot_);
+    }
+  }
+
+  void exit() {
+    if (--depth_ == 0) {
+      epoch_domain().exit(slot_);
+    }
+  }
+
+private:
+  size_t slot_;
+  size_t depth_;
+};
+
+inline EpochReader& epoch_reader() {
+  thread_local EpochReader reader;
+  return reader;
+}
+
+// Identifies a version of a file (reloaded when any field changes)
+typedef struct _file_stamp {
+  _file_stamp() : valid_(false), ino_(0), size_(0), mtime_(0) {}
+
+  bool operator==(const _file_stamp& other) const {
+    return (valid_ == other.valid_) && (ino_ == other.ino_) &&
+           (size_ == other.size_) && (mtime_ == other.mtime_);
+  }
+
+  bool operator!=(const _file_stamp& other) const {
+    return !(*this == other);
+  }
+
+  bool     valid_;
+  uint64_t ino_;
+  uint64_t size_;
+  int64_t  mtime_;
+} file_stamp_t;
+
+inline file_stamp_t file_stamp(const std::string& path) {
+  file_stamp_t stamp;
+  struct stat  st;
+
+  if (stat(path.c_str(), &st) == 0) {
+    stamp.valid_ = true;
+    stamp.ino_   = static_cast<uint64_t>(st.st_ino);
+    stamp.size_  = static_cast<uint64_t>(st.st_size);
+    stamp.mtime_ = static_cast<int64_t>(st.st_mtime);
+  }
+
+  return stamp;
+}
+
+// Loads a table file written by Table::serialize
+inline bool load_frozen_table(const std::string& path, FrozenTable& frozen) {
+  std::ifstream file(path, std::ifstream::in);
+
+  if (!file) {
+    return false;
+  }
+
+  Table table;
+
+  if (!table.unserialize(file)) {
+    return false;
+  }
+
+  frozen = FrozenTable(table);
+
+  return true;
+}
+
+class TableHandle {
+public:
+  // Keeps the current table alive while it is in scope
+  class ReadGuard {
+  public:
+    explicit ReadGuard(const TableHandle& handle) : reader_(&epoch_reader()) {
+      reader_->enter();
+      table_ = handle.current_.load();
+    }
+
+    ReadGuard(ReadGuard&& other) : reader_(other.reader_), table_(other.table_) {
+      other.reader_ = nullptr;
+    }
+
+    ReadGuard(const ReadGuard&) = delete;
+    ReadGuard& operator=(const ReadGuard&) = delete;
+
+    ~ReadGuard() {
+      if (reader_ != nullptr) {
+        reader_->exit();
+      }
+    }
+
+    const FrozenTable& operator*() const {
+      return *table_;
+    }
+
+    const FrozenTable* operator->() const {
+      return table_;
+    }
+
+  private:
+    EpochReader*       reader_;
+    const FrozenTable* table_;
+  };
+
+  TableHandle() : current_(new FrozenTable()), generation_(0), watching_(false) {}
+
+  explicit TableHandle(const FrozenTable& table) :
+    current_(new FrozenTable(table)), generation_(0), watching_(false) {}
+
+  // No reader may hold a guard when the handle is destroyed
+  ~TableHandle() {
+    unwatch();
+
+    delete current_.load();
+
+    for (auto& r : retired_) {
+      delete r.first;
+    }
+  }
+
+  TableHandle(const TableHandle&) = delete;
+  TableHandle& operator=(const TableHandle&) = delete;
+
+  ReadGuard read() const {
+    return ReadGuard(*this);
+  }
+
+  // Readers that hold the previous table keep using it until their guards end
+  void publish(const FrozenTable& table) {
+    FrozenTable* next = new FrozenTable(table);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    const FrozenTable* prev = current_.exchange(next);
+
+    retired_.push_back(std::make_pair(prev, epoch_domain().advance()));
+    generation_++;
+
+    reclaim_locked();
+  }
+
+  // Unserializes and publishes a table file; false if it cannot be loaded
+  bool load(const std::string& path) {
+    FrozenTable frozen;
+
+    if (!load_frozen_table(path, frozen)) {
+      return false;
+    }
+
+    publish(frozen);
+
+    return true;
+  }
+
+  std::future<bool> load_async(const std::string& path) {
+    return std::async(std::launch::async, [this, path]() {
+      return load(path);
+    });
+  }
+
+  // Reloads path whenever it changes, checking every interval milliseconds
+  void watch(const std::string& path, uint64_t interval = 1000) {
+    unwatch();
+
+    watching_ = true;
+
+    watcher_ = std::thread([this, path, interval]() {
+      file_stamp_t last = file_stamp(path);
+      std::unique_lock<std::mutex> lock(watch_mutex_);
+
+      while (!watch_cv_.wait_for(lock, std::chrono::milliseconds(interval),
+                                 [this]() { return !watching_; })) {
+        file_stamp_t now = file_stamp(path);
+
+        if (!now.valid_ || (now == last)) {
+          continue;
+        }
+
+        lock.unlock();
+
+        // a table that fails to load is tried again on the next check
+        if (load(path)) {
+          last = now;
+        }
+
+        lock.lock();
+      }
+    });
+  }
+
+  void unwatch() {
+    {
+      std::lock_guard<std::mutex> lock(watch_mutex_);
+      watching_ = false;
+    }
+
+    watch_cv_.notify_all();
+
+    if (watcher_.joinable()) {
+      watcher_.join();
+    }
+  }
+
+  // Deletes retired tables no reader can see; returns how many remain
+  size_t reclaim() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return reclaim_locked();
+  }
+
+  // Number of tables published
+  uint64_t generation() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+  }
+
+private:
+  size_t reclaim_locked() {
+    uint64_t oldest = epoch_domain().min_active();
+    auto     last   = retired_.begin();
+
+    // a table retired at epoch e may still be read by readers that entered before e
+    for (auto it = retired_.begin(); it != retired_.end(); ++it) {
+      if (it->second <= oldest) {
+        delete it->first;
+      } else {
+        *last++ = *it;
+      }
+    }
+
+    retired_.erase(last, retired_.end());
+
+    return retired_.size();
+  }
+
+  std::atomic<const FrozenTable*> current_;
+  mutable std::mutex              mutex_;
+  std::vector<std::pair<const FrozenTable*, uint64_t> > retired_;
+  uint64_t                        generation_;
+  std::thread                     watcher_;
+  std::mutex                      watch_mutex_;
+  std::condition_variable         watch_cv_;
+  bool                            watching_;
+};
+
+#endif  // _TABLEHANDLE_H
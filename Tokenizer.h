@@ -0,0 +1,339 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	Tokenizer.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Splits text into tokens and looks them up in a table
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _TOKENIZER_H
+#define _TOKENIZER_H
+
+// A Tokenizer splits text into tokens, the longest runs of bytes in a
+// CharClass (by default letters, digits and '_', as in SQL identifiers),
+// and looks them up in a Table or FrozenTable with find_vals(), a block of
+// tokens at a time. Each token is reported as its offset and length in
+// the text and its value, or EMPTY_VAL if it is not a key:
+//
+//   pph::Tokenizer tokenizer;
+//
+//   tokenizer.scan(keywords, sql.data(), sql.size(), [](const pph::token_t* tokens, size_t count) {
+//     ...
+//   });
+//
+// Tokens point into the text; nothing is copied or allocated per token.
+// The text is classified 64 bytes at a time into a bit mask (with two
+// table lookups per 32 bytes on AVX2), and the starts and ends of tokens
+// are found from the bits that change.
+
+static constexpr size_t TOKENIZER_BLOCK = 64;
+
+// Tokens looked up at once
+static constexpr size_t TOKENIZER_BATCH = 4 * SIMD_GROUP_SIZE;
+
+typedef struct _token {
+  // bytes from the start of the text
+  uint64_t offset_;
+  uint64_t length_;
+  // EMPTY_VAL if the token is not a key
+  uint64_t val_;
+} token_t;
+
+// A set of bytes
+class CharClass {
+public:
+  CharClass() {
+    std::fill(bits_, bits_ + 4, 0);
+  }
+
+  // Letters, digits and '_'
+  static CharClass identifier() {
+    return parse("A-Za-z0-9_");
+  }
+
+  // Bytes and ranges of bytes ("A-Za-z0-9_"). '\' escapes the next byte,
+  // and \t, \n, \r and \xHH are the usual bytes; a leading '^' takes every
+  // byte not listed.
+  static CharClass parse(const std::string& spec) {
+    CharClass result;
+    size_t    pos    = 0;
+    bool      negate = (!spec.empty() && (spec[0] == '^'));
+
+    if (negate) {
+      pos++;
+    }
+
+    while (pos < spec.size()) {
+      unsigned char first = next_char(spec, pos);
+      unsigned char last  = first;
+
+      if ((pos + 1 < spec.size()) && (spec[pos] == '-')) {
+        pos++;
+        last = next_char(spec, pos);
+
+        if (last < first) {
+          throw std::invalid_argument("character class '" + spec + "': range out of order");
+        }
+      }
+
+      result.add_range(first, last);
+    }
+
+    return negate ? result.complement() : result;
+  }
+
+  void add(unsigned char c) {
+    bits_[c >> 6] |= UINT64_C(1) << (c & 63);
+  }
+
+  void add_range(unsigned char first, unsigned char last) {
+    for (unsigned c = first; c <= last; c++) {
+      add(static_cast<unsigned char>(c));
+    }
+  }
+
+  void remove(unsigned char c) {
+    bits_[c >> 6] &= ~(UINT64_C(1) << (c & 63));
+  }
+
+  bool contains(unsigned char c) const {
+    return ((bits_[c >> 6] >> (c & 63)) & 1) != 0;
+  }
+
+  CharClass complement() const {
+    CharClass result;
+
+    for (size_t i = 0; i < 4; i++) {
+      result.bits_[i] = ~bits_[i];
+    }
+
+    return result;
+  }
+
+private:
+  static unsigned char next_char(const std::string& spec, size_t& pos) {
+    char c = spec[pos++];
+
+    if ((c != '\\') || (pos == spec.size())) {
+      return static_cast<unsigned char>(c);
+    }
+
+    c = spec[pos++];
+
+    switch (c) {
+      case 't':
+        return '\t';
+      case 'n':
+        return '\n';
+      case 'r':
+        return '\r';
+      case 'x':
+        if ((pos + 2 <= spec.size()) && std::isxdigit(static_cast<unsigned char>(spec[pos])) &&
+            std::isxdigit(static_cast<unsigned char>(spec[pos + 1]))) {
+          pos += 2;
+          return static_cast<unsigned char>(std::stoul(spec.substr(pos - 2, 2), nullptr, 16));
+        }
+        throw std::invalid_argument("character class '" + spec + "': \\x needs two hex digits");
+      default:
+        return static_cast<unsigned char>(c);
+    }
+  }
+
+  uint64_t bits_[4];
+};
+
+#if defined(PPH_X86)
+
+// Bit i of the result is set if byte i of the block is in the class. Byte
+// b is looked up by its low nibble in low (rows for high nibbles 0-7) or
+// high (8-15), and the bit of its high nibble is tested.
+PPH_TARGET(PPH_AVX2)
+inline uint64_t token_mask_avx2(const char* block, const uint8_t* low, const uint8_t* high) {
+  const __m256i low_rows  = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(low)));
+  const __m256i high_rows = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(high)));
+  const __m256i columns   = _mm256_setr_epi8(1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128,
+                                             1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128);
+  const __m256i nibble    = _mm256_set1_epi8(0x0f);
+  uint64_t      mask      = 0;
+
+  for (size_t half = 0; half < 2; half++) {
+    __m256i b   = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block + 32 * half));
+    __m256i lo  = _mm256_and_si256(b, nibble);
+    __m256i hi  = _mm256_and_si256(_mm256_srli_epi16(b, 4), nibble);
+    // bytes >= 0x80 take their row from high
+    __m256i row = _mm256_blendv_epi8(_mm256_shuffle_epi8(low_rows, lo), _mm256_shuffle_epi8(high_rows, lo), b);
+    __m256i out = _mm256_cmpeq_epi8(_mm256_and_si256(row, _mm256_shuffle_epi8(columns, hi)), _mm256_setzero_si256());
+
+    mask |= static_cast<uint64_t>(~static_cast<uint32_t>(_mm256_movemask_epi8(out))) << (32 * half);
+  }
+
+  return mask;
+}
+
+#endif  // PPH_X86
+
+class Tokenizer {
+public:
+  explicit Tokenizer(const CharClass& token_chars = CharClass::identifier()) :
+    chars_(token_chars), avx2_(cpu_has_avx2()) {
+    std::fill(low_, low_ + 16, 0);
+    std::fill(high_, high_ + 16, 0);
+
+    for (unsigned c = 0; c < 256; c++) {
+      if (chars_.contains(static_cast<unsigned char>(c))) {
+        uint8_t* rows = (c < 0x80) ? low_ : high_;
+
+        rows[c & 0x0f] |= static_cast<uint8_t>(1 << ((c >> 4) & 7));
+      }
+    }
+  }
+
+  const CharClass& token_chars() const {
+    return chars_;
+  }
+
+  // Calls f(offset, length) for each token of text, in order
+  template<typename F>
+  void split(const char* text, size_t size, F f) const {
+    char     tail[TOKENIZER_BLOCK];
+    // the byte before the block is in a token
+    uint64_t carry = 0;
+    uint64_t start = 0;
+
+    for (size_t base = 0; base < size; base += TOKENIZER_BLOCK) {
+      uint64_t mask;
+
+      if (size - base >= TOKENIZER_BLOCK) {
+        mask = token_mask(text + base);
+      } else {
+        size_t n = size - base;
+
+        std::memcpy(tail, text + base, n);
+        std::memset(tail + n, 0, TOKENIZER_BLOCK - n);
+
+        mask = token_mask(tail) & ((UINT64_C(1) << n) - 1);
+      }
+
+      uint64_t shifted = (mask << 1) | carry;
+      uint64_t starts  = mask & ~shifted;
+      uint64_t ends    = ~mask & shifted;
+      uint64_t events  = starts | ends;
+
+      // starts and ends alternate
+      while (events != 0) {
+        uint64_t bit = events & (~events + 1);
+        uint64_t pos = base + static_cast<uint64_t>(__builtin_ctzll(events));
+
+        if ((starts & bit) != 0) {
+          start = pos;
+        } else {
+          f(start, pos - start);
+        }
+
+        events ^= bit;
+      }
+
+      carry = mask >> 63;
+    }
+
+    // a token at the end of the text
+    if (carry != 0) {
+      f(start, size - start);
+    }
+  }
+
+  // Splits text and looks the tokens up in table (a Table or a FrozenTable),
+  // then calls emit(tokens, count) for blocks of at most TOKENIZER_BATCH
+  // tokens, in order
+  template<typename T, typename Emit>
+  void scan(T& table, const char* text, size_t size, Emit emit) const {
+    const char* keys[TOKENIZER_BATCH];
+    size_t      lengths[TOKENIZER_BATCH];
+    uint64_t    vals[TOKENIZER_BATCH];
+    token_t     tokens[TOKENIZER_BATCH];
+    size_t      count = 0;
+
+    auto flush = [&]() {
+      table.find_vals(keys, lengths, count, vals);
+
+      for (size_t i = 0; i < count; i++) {
+        tokens[i].val_ = vals[i];
+      }
+
+      emit(static_cast<const token_t*>(tokens), count);
+
+      count = 0;
+    };
+
+    split(text, size, [&](uint64_t offset, uint64_t length) {
+      keys[count]    = text + offset;
+      lengths[count] = static_cast<size_t>(length);
+
+      tokens[count].offset_ = offset;
+      tokens[count].length_ = length;
+
+      if (++count == TOKENIZER_BATCH) {
+        flush();
+      }
+    });
+
+    if (count > 0) {
+      flush();
+    }
+  }
+
+  template<typename T>
+  std::vector<token_t> scan(T& table, const char* text, size_t size) const {
+    std::vector<token_t> result;
+
+    scan(table, text, size, [&result](const token_t* tokens, size_t count) {
+      result.insert(result.end(), tokens, tokens + count);
+    });
+
+    return result;
+  }
+
+private:
+  uint64_t token_mask(const char* block) const {
+#if defined(PPH_X86)
+    if (avx2_) {
+      return token_mask_avx2(block, low_, high_);
+    }
+#endif
+
+    uint64_t mask = 0;
+
+    for (size_t i = 0; i < TOKENIZER_BLOCK; i++) {
+      mask |= static_cast<uint64_t>(chars_.contains(static_cast<unsigned char>(block[i]))) << i;
+    }
+
+    return mask;
+  }
+
+  CharClass chars_;
+  bool      avx2_;
+  // rows of the AVX2 lookup: bit h of low_[l] is set if byte (h << 4) | l
+  // is in the class, and of high_[l] if byte ((h + 8) << 4) | l is
+  uint8_t   low_[16];
+  uint8_t   high_[16];
+};
+
+#endif  // _TOKENIZER_H
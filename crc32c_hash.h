@@ -0,0 +1,125 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	crc32c_hash.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	CRC-32C key function using the SSE4.2 CRC32 instruction
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _CRC32C_HASH_H
+#define _CRC32C_HASH_H
+
+// CRC-32C (Castagnoli) is the polynomial implemented by the SSE4.2 CRC32
+// instruction. The table driven version gives identical results on
+// processors without SSE4.2.
+//
+// https://tools.ietf.org/html/rfc3720#appendix-B.4
+// http://reveng.sourceforge.net/crc-catalogue/17plus.htm#crc.cat.crc-32c
+
+static constexpr uint32_t CRC32C_POLY_REFLECTED = UINT32_C(0x82f63b78);
+
+class Crc32cTable {
+public:
+  Crc32cTable() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t c = i;
+
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? ((c >> 1) ^ CRC32C_POLY_REFLECTED) : (c >> 1);
+      }
+
+      table_[i] = c;
+    }
+  }
+
+  uint32_t operator[](uint32_t i) const {
+    return table_[i];
+  }
+
+private:
+  uint32_t table_[256];
+};
+
+inline uint32_t crc32c_scalar(const char* data, size_t len, uint32_t crc) {
+  static const Crc32cTable table;
+
+  for (size_t i = 0; i < len; i++) {
+    crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+  }
+
+  return crc;
+}
+
+#if defined(PPH_X86)
+PPH_TARGET("sse4.2")
+inline uint32_t crc32c_sse42(const char* data, size_t len, uint32_t crc) {
+  uint64_t crc64 = crc;
+
+  while (len >= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc64 = _mm_crc32_u64(crc64, word);
+    data += 8;
+    len  -= 8;
+  }
+
+  crc = static_cast<uint32_t>(crc64);
+
+  if (len >= 4) {
+    uint32_t word;
+    std::memcpy(&word, data, sizeof(word));
+    crc = _mm_crc32_u32(crc, word);
+    data += 4;
+    len  -= 4;
+  }
+
+  while (len > 0) {
+    crc = _mm_crc32_u8(crc, static_cast<uint8_t>(*data));
+    data++;
+    len--;
+  }
+
+  return crc;
+}
+#endif
+
+inline uint32_t crc32c(const char* data, size_t len) {
+  uint32_t crc = ~UINT32_C(0);
+
+#if defined(PPH_X86)
+  if (cpu_has_sse42()) {
+    return ~crc32c_sse42(data, len, crc);
+  }
+#endif
+
+  return ~crc32c_scalar(data, len, crc);
+}
+
+inline uint64_t crc32c_hash_buf(const char* data, size_t len, uint64_t /*multiplier*/, uint64_t adjustment) {
+  return static_cast<uint64_t>(crc32c(data, len)) + adjustment;
+}
+
+// UUID: B14FD9E5-C32E-4DAE-99B6-16F896FDD34E
+uint64_t crc32c_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return crc32c_hash_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
+#endif  // _CRC32C_HASH_H
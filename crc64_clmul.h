@@ -0,0 +1,207 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	crc64_clmul.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	CRC-64 key function using carry-less multiplication (PCLMULQDQ)
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _CRC64_CLMUL_H
+#define _CRC64_CLMUL_H
+
+// Computes the same CRC-64 as crc_64_type (CRC-64/XZ: polynomial
+// 0x42f0e1eba9ea3693, reflected, init and xorout 0xffffffffffffffff), so
+// crc64_clmul() and crc64() return identical values for every key.
+//
+// Keys of 32 bytes or more are folded 16 bytes at a time with PCLMULQDQ;
+// shorter keys and the remaining bytes use a slicing-by-8 table.
+//
+// Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction
+// V Gopal, E Ozturk, J Guilford, G Wolrich, W Feghali, M Dixon, D Karakoyunlu - Intel, 2009
+//
+// http://reveng.sourceforge.net/crc-catalogue/17plus.htm#crc.cat.crc-64-xz
+
+static constexpr uint64_t CRC64_POLY           = UINT64_C(0x42f0e1eba9ea3693);
+static constexpr uint64_t CRC64_POLY_REFLECTED = UINT64_C(0xc96c5795d7870f42);
+
+// Minimum key length for the PCLMULQDQ path
+static constexpr size_t   CRC64_CLMUL_MIN_LEN  = 32;
+
+inline uint64_t reflect64(uint64_t v) {
+  uint64_t r = 0;
+
+  for (int i = 0; i < 64; i++) {
+    r = (r << 1) | (v & 1);
+    v >>= 1;
+  }
+
+  return r;
+}
+
+// x^n mod P(x) in normal (non-reflected) bit order
+inline uint64_t crc64_xpow_mod(uint64_t n) {
+  uint64_t r = 1;
+
+  for (uint64_t i = 0; i < n; i++) {
+    uint64_t carry = r >> 63;
+    r <<= 1;
+    if (carry) {
+      r ^= CRC64_POLY;
+    }
+  }
+
+  return r;
+}
+
+class Crc64Tables {
+public:
+  Crc64Tables() {
+    for (uint64_t i = 0; i < 256; i++) {
+      uint64_t c = i;
+
+      for (int k = 0; k < 8; k++) {
+        c = (c & 1) ? ((c >> 1) ^ CRC64_POLY_REFLECTED) : (c >> 1);
+      }
+
+      table_[0][i] = c;
+    }
+
+    for (int t = 1; t < 8; t++) {
+      for (int i = 0; i < 256; i++) {
+        uint64_t c = table_[t-1][i];
+        table_[t][i] = (c >> 8) ^ table_[0][c & 0xff];
+      }
+    }
+
+    // Folding 128 bits of reflected data forward by 128 bits multiplies the
+    // upper half (first 8 bytes) by x^192 and the lower half by x^128. The
+    // product of two reflected 64-bit values is one bit short of a
+    // reflected 128-bit value, which is absorbed by using x^(n-1).
+
+    fold_hi_ = reflect64(crc64_xpow_mod(191));
+    fold_lo_ = reflect64(crc64_xpow_mod(127));
+  }
+
+  // slicing-by-8
+  // https://create.stephan-brumme.com/crc32/#slicing-by-8-overview
+  uint64_t update(uint64_t crc, const char* data, size_t len) const {
+    while (len >= 8) {
+      uint64_t word;
+      std::memcpy(&word, data, sizeof(word));
+      crc ^= word;
+      crc = table_[7][crc & 0xff] ^
+            table_[6][(crc >> 8) & 0xff] ^
+            table_[5][(crc >> 16) & 0xff] ^
+            table_[4][(crc >> 24) & 0xff] ^
+            table_[3][(crc >> 32) & 0xff] ^
+            table_[2][(crc >> 40) & 0xff] ^
+            table_[1][(crc >> 48) & 0xff] ^
+            table_[0][crc >> 56];
+      data += 8;
+      len  -= 8;
+    }
+
+    while (len > 0) {
+      crc = table_[0][(crc ^ static_cast<uint8_t>(*data)) & 0xff] ^ (crc >> 8);
+      data++;
+      len--;
+    }
+
+    return crc;
+  }
+
+  uint64_t fold_hi() const {
+    return fold_hi_;
+  }
+
+  uint64_t fold_lo() const {
+    return fold_lo_;
+  }
+
+private:
+  uint64_t table_[8][256];
+  uint64_t fold_hi_;
+  uint64_t fold_lo_;
+};
+
+inline const Crc64Tables& crc64_tables() {
+  static const Crc64Tables tables;
+  return tables;
+}
+
+#if defined(PPH_X86)
+PPH_TARGET("pclmul,sse4.1")
+inline uint64_t crc64_pclmul(const char* data, size_t len, uint64_t crc) {
+  const Crc64Tables& tables = crc64_tables();
+  const __m128i fold = _mm_set_epi64x(static_cast<int64_t>(tables.fold_lo()),
+                                      static_cast<int64_t>(tables.fold_hi()));
+
+  // The CRC register is the first 8 bytes of the message in the reflected domain
+  __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+  x = _mm_xor_si128(x, _mm_set_epi64x(0, static_cast<int64_t>(crc)));
+  data += 16;
+  len  -= 16;
+
+  while (len >= 16) {
+    __m128i next = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data));
+    __m128i hi   = _mm_clmulepi64_si128(x, fold, 0x00);
+    __m128i lo   = _mm_clmulepi64_si128(x, fold, 0x11);
+    x = _mm_xor_si128(_mm_xor_si128(hi, lo), next);
+    data += 16;
+    len  -= 16;
+  }
+
+  // Reduce the remaining 128 bits (and the tail) with the tables
+  char folded[16];
+  _mm_storeu_si128(reinterpret_cast<__m128i*>(folded), x);
+
+  crc = tables.update(0, folded, sizeof(folded));
+
+  return tables.update(crc, data, len);
+}
+#endif
+
+// Continues a CRC-64 over more data: start from ~0 and complement the
+// final value to get the same result as crc64_fast() over all the data
+inline uint64_t crc64_update(uint64_t crc, const char* data, size_t len) {
+#if defined(PPH_X86)
+  if ((len >= CRC64_CLMUL_MIN_LEN) && cpu_has_pclmul()) {
+    return crc64_pclmul(data, len, crc);
+  }
+#endif
+
+  return crc64_tables().update(crc, data, len);
+}
+
+inline uint64_t crc64_fast(const char* data, size_t len) {
+  return ~crc64_update(~UINT64_C(0), data, len);
+}
+
+inline uint64_t crc64_clmul_buf(const char* data, size_t len, uint64_t /*multiplier*/, uint64_t adjustment) {
+  return crc64_fast(data, len) + adjustment;
+}
+
+// UUID: FB2B126B-ABFD-488B-AA5B-103C32D34341
+uint64_t crc64_clmul(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return crc64_clmul_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
+#endif  // _CRC64_CLMUL_H
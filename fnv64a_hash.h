@@ -79,16 +79,16 @@
 static constexpr uint64_t FNV1A_64_INIT = UINT64_C(0xcbf29ce484222325);
 static constexpr uint64_t FNV_64_PRIME  = UINT64_C(0x100000001b3);
 
-uint64_t fnv64a_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+inline uint64_t fnv64a_hash_buf(const char* data, size_t len, uint64_t /*multiplier*/, uint64_t adjustment) {
   uint64_t hval = FNV1A_64_INIT;
 
   //
   // FNV-1a hash each octet of the buffer
   //
-  for (int i = 0; i < str.size(); i++) {
+  for (size_t i = 0; i < len; i++) {
 
     // xor the bottom with the current octet
-    hval ^= static_cast<uint64_t>(str[i]);
+    hval ^= static_cast<uint64_t>(data[i]);
 
     // multiply by the 64 bit FNV magic prime mod 2^64
     hval *= FNV_64_PRIME;
@@ -98,4 +98,8 @@ uint64_t fnv64a_hash(const std::string& str, uint64_t multiplier, uint64_t adjus
   return hval + adjustment;
 }
 
+uint64_t fnv64a_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return fnv64a_hash_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
 #endif  // _FNV64A_HASH_H
@@ -22,39 +22,1571 @@
 
 #include "pph.h"
 
+#if PPH_ARROW
+#include "ArrowTable.h"
+#endif
+
 #include <boost/filesystem.hpp>
 #include <boost/make_shared.hpp>
 #include <boost/program_options.hpp>
 
-#include <cstdint>
-#include <cfloat>
-#include <random>
-#include <ctime>
-#include <limits>
-#include <vector>
-#include <cassert>
-#include <cstdio>
-#include <fstream>
-#include <iostream>
-#include <list>
-#include <memory>
-#include <string>
+#include <cerrno>
+#include <cstdint>
+#include <cfloat>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <ctime>
+#include <limits>
+#include <vector>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define STR(x) #x
+#define STR_(x) STR(x)
+#define STR__LINE__ STR_(__LINE__)
+
+#include "pphrelease.h"
+//#define PPH_RELEASE "1.0.0"
+
+// Keys looked up per find_vals() call during verification
+static constexpr size_t VERIFY_BATCH = 4096;
+
+typedef enum _verify_error {
+  VERIFY_NOT_FOUND,
+  // value is not in 0..n-1
+  VERIFY_OUT_OF_RANGE,
+  // value was already returned for another key
+  VERIFY_DUPLICATE
+} verify_error_t;
+
+static const char* const VERIFY_ERROR_NAMES[] = {
+  "not found", "value out of range", "duplicate value"
+};
+
+typedef struct _verify_failure {
+  uint64_t       index_;
+  uint64_t       val_;
+  verify_error_t error_;
+} verify_failure_t;
+
+// Looks up every key and checks that the values are a permutation of
+// 0..n-1, marking each value in a bitmap shared by the threads. Each
+// thread verifies a contiguous range of keys with batched lookups.
+// Returns every failure in key order; all keys that share a value are
+// reported as duplicates.
+static std::vector<verify_failure_t> verify_table(pph::Table& table,
+                                                  const std::vector<std::string>& keys,
+                                                  size_t threads) {
+  const uint64_t n = keys.size();
+
+  std::vector<uint64_t> vals(n);
+  std::vector<std::atomic<uint64_t> > bitmap((n + 63) / 64);
+  std::vector<std::vector<verify_failure_t> > failures(std::max<size_t>(1, threads));
+  std::vector<std::thread> workers;
+
+  for (auto& word : bitmap) {
+    word.store(0, std::memory_order_relaxed);
+  }
+
+  size_t range = (n + failures.size() - 1) / failures.size();
+
+  auto verify_range = [&](size_t t) {
+    uint64_t begin = std::min<uint64_t>(n, t * range);
+    uint64_t end   = std::min<uint64_t>(n, begin + range);
+
+    std::vector<const char*> ptrs(VERIFY_BATCH);
+    std::vector<size_t>      lengths(VERIFY_BATCH);
+
+    for (uint64_t base = begin; base < end; base += VERIFY_BATCH) {
+      size_t count = static_cast<size_t>(std::min<uint64_t>(VERIFY_BATCH, end - base));
+
+      for (size_t i = 0; i < count; i++) {
+        ptrs[i]    = keys[base + i].data();
+        lengths[i] = keys[base + i].size();
+      }
+
+      table.find_vals(ptrs.data(), lengths.data(), count, &vals[base]);
+
+      for (uint64_t i = base; i < base + count; i++) {
+        uint64_t val = vals[i];
+        uint64_t bit = UINT64_C(1) << (val & 63);
+
+        if (table.notfound_val(val)) {
+          failures[t].push_back({i, val, VERIFY_NOT_FOUND});
+        } else if (val >= n) {
+          failures[t].push_back({i, val, VERIFY_OUT_OF_RANGE});
+        } else if ((bitmap[val / 64].fetch_or(bit, std::memory_order_relaxed) & bit) != 0) {
+          failures[t].push_back({i, val, VERIFY_DUPLICATE});
+        }
+      }
+    }
+  };
+
+  for (size_t t = 1; t < failures.size(); t++) {
+    workers.push_back(std::thread(verify_range, t));
+  }
+
+  verify_range(0);
+
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  // ranges are in key order, so concatenating keeps failures sorted
+  std::vector<verify_failure_t> all;
+  std::vector<uint64_t>         duplicates;
+
+  for (auto& range_failures : failures) {
+    for (const verify_failure_t& failure : range_failures) {
+      if (failure.error_ == VERIFY_DUPLICATE) {
+        duplicates.push_back(failure.val_);
+      } else {
+        all.push_back(failure);
+      }
+    }
+  }
+
+  if (!duplicates.empty()) {
+    // which key saw a value first depends on the threads; report them all
+    std::sort(duplicates.begin(), duplicates.end());
+
+    for (uint64_t i = 0; i < n; i++) {
+      if ((vals[i] < n) && std::binary_search(duplicates.begin(), duplicates.end(), vals[i])) {
+        all.push_back({i, vals[i], VERIFY_DUPLICATE});
+      }
+    }
+
+    std::stable_sort(all.begin(), all.end(), [](const verify_failure_t& a, const verify_failure_t& b) {
+      return a.index_ < b.index_;
+    });
+  }
+
+  return all;
+}
+
+// Prints each failure; true if there were none
+static bool report_verify(const std::vector<verify_failure_t>& failures,
+                          const std::vector<std::string>& keys) {
+  for (const verify_failure_t& failure : failures) {
+    std::cerr << "Error verifying key '" << keys[failure.index_] << "' at index " << failure.index_
+              << ": " << VERIFY_ERROR_NAMES[failure.error_];
+
+    if (failure.error_ != VERIFY_NOT_FOUND) {
+      std::cerr << " " << failure.val_;
+    }
+
+    std::cerr << std::endl;
+  }
+
+  if (!failures.empty()) {
+    std::cerr << failures.size() << " of " << keys.size() << " keys failed verification" << std::endl;
+  }
+
+  return failures.empty();
+}
+
+// pph --check: compares the checksums stored in a table file with its contents
+static int check_main(const std::string& filename) {
+  std::ifstream table_file(filename, std::ifstream::in | std::ifstream::binary);
+
+  if (!table_file) {
+    std::cerr << "Cannot open table file '" << filename << "'" << std::endl;
+    return 1;
+  }
+
+  uint64_t t_start = pph::stats_clock();
+
+  const pph::table_check_t check = pph::check_table(table_file);
+
+  uint64_t t_check = pph::stats_clock() - t_start;
+
+  if (!check.complete_) {
+    std::cerr << "Table file '" << filename << "' is truncated" << std::endl;
+    return 1;
+  }
+
+  if (!check.stored_.present_) {
+    std::cerr << "Table file '" << filename << "' has no checksums" << std::endl;
+    return 1;
+  }
+
+  for (size_t i = 0; i < pph::TABLE_SECTIONS; i++) {
+    std::cout << pph::TABLE_SECTION_NAMES[i] << " " << std::hex << std::setw(16) << std::setfill('0')
+              << check.computed_.section_[i] << std::dec << std::setfill(' ')
+              << (check.section_ok(i) ? " ok" : " MISMATCH") << std::endl;
+  }
+
+  std::cout << "digest " << std::hex << std::setw(16) << std::setfill('0') << check.stored_.digest_
+            << std::dec << std::setfill(' ') << std::endl;
+  std::cout << "bytes " << check.bytes_ << std::endl;
+  std::cout << "check_ms " << (t_check / 1000000.0) << std::endl;
+
+  if (!check.ok()) {
+    std::cerr << "Checksums of '" << filename << "' do not match" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Checksums verified; " << filename << std::endl;
+
+  return 0;
+}
+
+// pph --lookup, --tokenize and pph encode: input is processed in chunks of whole lines of about this size
+static constexpr size_t LOOKUP_CHUNK_SIZE = 16 << 20;
+
+// Lines of each thread are looked up this many at a time
+static constexpr size_t LOOKUP_BATCH = 1024;
+
+static inline bool lookup_space(char c) {
+  return (c == ' ') || (c == '\t') || (c == '\r') || (c == '\f') || (c == '\v');
+}
+
+// Writes the decimal digits of val at out; returns the end
+static inline char* format_uint64(char* out, uint64_t val) {
+  char   digits[20];
+  size_t count = 0;
+
+  do {
+    digits[count++] = static_cast<char>('0' + (val % 10));
+    val /= 10;
+  } while (val != 0);
+
+  while (count > 0) {
+    *out++ = digits[--count];
+  }
+
+  return out;
+}
+
+// Passes the input of fd to process(begin, end) in chunks of whole lines
+// of about LOOKUP_CHUNK_SIZE bytes (the last line may lack its newline).
+// Regular files are mapped; other input is read with a buffer that grows
+// for lines longer than a chunk. False if reading or process() fails.
+template<typename Process>
+static bool read_line_chunks(int fd, Process process) {
+  struct stat st;
+
+  if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+    size_t size = static_cast<size_t>(st.st_size);
+    void*  map  = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (map != MAP_FAILED) {
+      madvise(map, size, MADV_SEQUENTIAL);
+
+      const char* data   = static_cast<const char*>(map);
+      const char* end    = data + size;
+      bool        status = true;
+
+      while (status && (data < end)) {
+        const char* stop = data + std::min(LOOKUP_CHUNK_SIZE, static_cast<size_t>(end - data));
+
+        // end the chunk after the last complete line in it
+        if (stop < end) {
+          const char* nl = static_cast<const char*>(memrchr(data, '\n', stop - data));
+
+          if (nl != nullptr) {
+            stop = nl + 1;
+          } else {
+            nl   = static_cast<const char*>(std::memchr(stop, '\n', end - stop));
+            stop = (nl != nullptr) ? nl + 1 : end;
+          }
+        }
+
+        status = process(data, stop);
+        data   = stop;
+      }
+
+      munmap(map, size);
+
+      return status;
+    }
+  }
+
+  std::vector<char> buffer(LOOKUP_CHUNK_SIZE);
+  // bytes of an incomplete line at the start of buffer
+  size_t carry = 0;
+
+  for (;;) {
+    if (carry == buffer.size()) {
+      // a line longer than the buffer
+      buffer.resize(buffer.size() * 2);
+    }
+
+    ssize_t count = read(fd, buffer.data() + carry, buffer.size() - carry);
+
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      return false;
+    }
+
+    if (count == 0) {
+      return (carry == 0) || process(buffer.data(), buffer.data() + carry);
+    }
+
+    const char* data = buffer.data();
+    const char* end  = data + carry + count;
+    const char* nl   = static_cast<const char*>(memrchr(data, '\n', end - data));
+
+    if (nl == nullptr) {
+      carry = static_cast<size_t>(end - data);
+      continue;
+    }
+
+    if (!process(data, nl + 1)) {
+      return false;
+    }
+
+    carry = static_cast<size_t>(end - (nl + 1));
+    std::memmove(buffer.data(), nl + 1, carry);
+  }
+}
+
+// Maps lines of keys to their values with a FrozenTable. Lines are split
+// in place (keys point into the input), trimmed like the keys of pph -i,
+// and looked up in parallel by contiguous ranges; each thread formats its
+// results into its own buffer, and the buffers are written in input order.
+class LineLookup {
+public:
+  LineLookup(const pph::FrozenTable& table, size_t threads, const std::string& miss, std::FILE* out) :
+    table_(table), threads_(std::max<size_t>(1, threads)), miss_(miss), out_(out),
+    lines_(0), misses_(0), bytes_(0), output_(threads_) {}
+
+  // Looks up every line of [begin, end); the last line may lack its newline
+  bool lookup(const char* begin, const char* end) {
+    keys_.clear();
+    lengths_.clear();
+
+    bytes_ += static_cast<uint64_t>(end - begin);
+
+    for (const char* line = begin; line < end; ) {
+      const char* nl   = static_cast<const char*>(std::memchr(line, '\n', end - line));
+      const char* stop = (nl != nullptr) ? nl : end;
+      const char* key  = line;
+
+      while ((key < stop) && lookup_space(*key)) {
+        key++;
+      }
+
+      while ((stop > key) && lookup_space(stop[-1])) {
+        stop--;
+      }
+
+      keys_.push_back(key);
+      lengths_.push_back(static_cast<size_t>(stop - key));
+
+      line = (nl != nullptr) ? nl + 1 : end;
+    }
+
+    size_t count = keys_.size();
+    size_t range = (count + threads_ - 1) / threads_;
+    std::vector<std::thread> workers;
+    std::vector<uint64_t>    misses(threads_, 0);
+
+    vals_.resize(count);
+
+    auto lookup_range = [&](size_t t) {
+      size_t first = std::min(count, t * range);
+      size_t last  = std::min(count, first + range);
+      std::string& out = output_[t];
+
+      // room for the longest result on every line
+      out.resize((last - first) * (std::max<size_t>(20, miss_.size()) + 1));
+
+      char* pos = &out[0];
+
+      for (size_t base = first; base < last; base += LOOKUP_BATCH) {
+        size_t n = std::min(LOOKUP_BATCH, last - base);
+
+        table_.find_vals(&keys_[base], &lengths_[base], n, &vals_[base]);
+
+        for (size_t i = base; i < base + n; i++) {
+          if (table_.notfound_val(vals_[i])) {
+            pos = std::copy(miss_.begin(), miss_.end(), pos);
+            misses[t]++;
+          } else {
+            pos = format_uint64(pos, vals_[i]);
+          }
+
+          *pos++ = '\n';
+        }
+      }
+
+      out.resize(static_cast<size_t>(pos - out.data()));
+    };
+
+    for (size_t t = 1; t < threads_; t++) {
+      workers.push_back(std::thread(lookup_range, t));
+    }
+
+    lookup_range(0);
+
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    for (size_t t = 0; t < threads_; t++) {
+      misses_ += misses[t];
+
+      if (std::fwrite(output_[t].data(), 1, output_[t].size(), out_) != output_[t].size()) {
+        return false;
+      }
+    }
+
+    lines_ += count;
+
+    return true;
+  }
+
+  // Looks up every line read from fd
+  bool lookup_fd(int fd) {
+    return read_line_chunks(fd, [this](const char* begin, const char* end) {
+      return lookup(begin, end);
+    });
+  }
+
+  uint64_t lines() const {
+    return lines_;
+  }
+
+  uint64_t misses() const {
+    return misses_;
+  }
+
+  uint64_t bytes() const {
+    return bytes_;
+  }
+
+private:
+  const pph::FrozenTable&  table_;
+  size_t                   threads_;
+  std::string              miss_;
+  std::FILE*               out_;
+  uint64_t                 lines_;
+  uint64_t                 misses_;
+  uint64_t                 bytes_;
+  std::vector<const char*> keys_;
+  std::vector<size_t>      lengths_;
+  std::vector<uint64_t>    vals_;
+  // results of each thread
+  std::vector<std::string> output_;
+};
+
+// Standard output, or the file output_filename, with a 1 MiB buffer;
+// nullptr if the file cannot be opened. The buffer is static because
+// stdout is flushed by exit(), after the caller has returned.
+static std::FILE* open_output(const std::string& output_filename) {
+  static char out_buffer[1 << 20];
+  std::FILE*  out = stdout;
+
+  if (!output_filename.empty()) {
+    out = std::fopen(output_filename.c_str(), "wb");
+
+    if (out == nullptr) {
+      std::cerr << "Cannot open output file '" << output_filename << "'" << std::endl;
+      return nullptr;
+    }
+  }
+
+  std::setvbuf(out, out_buffer, _IOFBF, sizeof(out_buffer));
+
+  return out;
+}
+
+static int lookup_main(const std::string& table_filename, const std::vector<std::string>& input_files,
+                       const std::string& output_filename, const std::string& miss, size_t threads,
+                       bool print_stats) {
+  pph::FrozenTable table;
+
+  if (!pph::load_frozen_table(table_filename, table)) {
+    std::cerr << "Cannot load table from " << table_filename << std::endl;
+    return 1;
+  }
+
+  std::FILE* out = open_output(output_filename);
+
+  if (out == nullptr) {
+    return 1;
+  }
+
+  LineLookup lookup(table, threads, miss, out);
+  uint64_t   t_start = pph::stats_clock();
+  bool       status  = true;
+
+  if (input_files.empty()) {
+    status = lookup.lookup_fd(STDIN_FILENO);
+  }
+
+  for (size_t i = 0; status && (i < input_files.size()); i++) {
+    int fd = open(input_files[i].c_str(), O_RDONLY);
+
+    if (fd < 0) {
+      std::cerr << "Cannot open input file '" << input_files[i] << "'" << std::endl;
+      status = false;
+      break;
+    }
+
+    status = lookup.lookup_fd(fd);
+    close(fd);
+  }
+
+  status = (std::fflush(out) == 0) && status;
+
+  if (out != stdout) {
+    status = (std::fclose(out) == 0) && status;
+  }
+
+  if (!status) {
+    std::cerr << "Lookup failed: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
+  if (print_stats) {
+    double seconds = (pph::stats_clock() - t_start) / 1e9;
+
+    std::cerr << "lines " << lookup.lines() << std::endl;
+    std::cerr << "misses " << lookup.misses() << std::endl;
+    std::cerr << "bytes " << lookup.bytes() << std::endl;
+    std::cerr << "mb_per_second " << ((seconds > 0) ? lookup.bytes() / seconds / 1e6 : 0.0) << std::endl;
+  }
+
+  return 0;
+}
+
+// Splits text into tokens with a Tokenizer and prints one line per token:
+// its byte offset in the input, its length and its value (or the miss
+// text). Lines end tokens, so input can be read a chunk of lines at a time.
+class TokenLookup {
+public:
+  TokenLookup(const pph::FrozenTable& table, const pph::CharClass& token_chars, const std::string& miss,
+              bool hits_only, std::FILE* out) :
+    table_(table), tokenizer_(without_newline(token_chars)), miss_(miss), hits_only_(hits_only), out_(out),
+    offset_(0), tokens_(0), misses_(0), bytes_(0) {}
+
+  bool scan(const char* begin, const char* end) {
+    bool status = true;
+
+    tokenizer_.scan(table_, begin, static_cast<size_t>(end - begin), [&](const pph::token_t* tokens, size_t count) {
+      // room for the longest line of every token
+      output_.resize(count * (42 + std::max<size_t>(20, miss_.size()) + 1));
+
+      char* pos = &output_[0];
+
+      for (size_t i = 0; i < count; i++) {
+        bool miss = table_.notfound_val(tokens[i].val_);
+
+        if (miss) {
+          misses_++;
+
+          if (hits_only_) {
+            continue;
+          }
+        }
+
+        pos = format_uint64(pos, offset_ + tokens[i].offset_);
+        *pos++ = ' ';
+        pos = format_uint64(pos, tokens[i].length_);
+        *pos++ = ' ';
+        pos = miss ? std::copy(miss_.begin(), miss_.end(), pos) : format_uint64(pos, tokens[i].val_);
+        *pos++ = '\n';
+      }
+
+      size_t size = static_cast<size_t>(pos - output_.data());
+
+      status = status && (std::fwrite(output_.data(), 1, size, out_) == size);
+      tokens_ += count;
+    });
+
+    offset_ += static_cast<uint64_t>(end - begin);
+    bytes_  += static_cast<uint64_t>(end - begin);
+
+    return status;
+  }
+
+  // Scans the input of fd; offsets start again at 0
+  bool scan_fd(int fd) {
+    offset_ = 0;
+
+    return read_line_chunks(fd, [this](const char* begin, const char* end) {
+      return scan(begin, end);
+    });
+  }
+
+  uint64_t tokens() const {
+    return tokens_;
+  }
+
+  uint64_t misses() const {
+    return misses_;
+  }
+
+  uint64_t bytes() const {
+    return bytes_;
+  }
+
+private:
+  static pph::CharClass without_newline(pph::CharClass token_chars) {
+    token_chars.remove('\n');
+    return token_chars;
+  }
+
+  const pph::FrozenTable& table_;
+  pph::Tokenizer          tokenizer_;
+  std::string             miss_;
+  bool                    hits_only_;
+  std::FILE*              out_;
+  // offset of the chunk in the input
+  uint64_t                offset_;
+  uint64_t                tokens_;
+  uint64_t                misses_;
+  uint64_t                bytes_;
+  std::string             output_;
+};
+
+static int tokenize_main(const std::string& table_filename, const std::vector<std::string>& input_files,
+                         const std::string& output_filename, const std::string& token_chars,
+                         const std::string& miss, bool hits_only, bool print_stats) {
+  pph::FrozenTable table;
+  pph::CharClass   chars;
+
+  try {
+    chars = token_chars.empty() ? pph::CharClass::identifier() : pph::CharClass::parse(token_chars);
+  } catch (const std::exception& e) {
+    std::cerr << "Usage Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  if (!pph::load_frozen_table(table_filename, table)) {
+    std::cerr << "Cannot load table from " << table_filename << std::endl;
+    return 1;
+  }
+
+  std::FILE* out = open_output(output_filename);
+
+  if (out == nullptr) {
+    return 1;
+  }
+
+  TokenLookup scanner(table, chars, miss, hits_only, out);
+  uint64_t    t_start = pph::stats_clock();
+  bool        status  = true;
+
+  if (input_files.empty()) {
+    status = scanner.scan_fd(STDIN_FILENO);
+  }
+
+  for (size_t i = 0; status && (i < input_files.size()); i++) {
+    int fd = open(input_files[i].c_str(), O_RDONLY);
+
+    if (fd < 0) {
+      std::cerr << "Cannot open input file '" << input_files[i] << "'" << std::endl;
+      status = false;
+      break;
+    }
+
+    status = scanner.scan_fd(fd);
+    close(fd);
+  }
+
+  status = (std::fflush(out) == 0) && status;
+
+  if (out != stdout) {
+    status = (std::fclose(out) == 0) && status;
+  }
+
+  if (!status) {
+    std::cerr << "Tokenize failed: " << std::strerror(errno) << std::endl;
+    return 1;
+  }
+
+  if (print_stats) {
+    double seconds = (pph::stats_clock() - t_start) / 1e9;
+
+    std::cerr << "tokens " << scanner.tokens() << std::endl;
+    std::cerr << "misses " << scanner.misses() << std::endl;
+    std::cerr << "bytes " << scanner.bytes() << std::endl;
+    std::cerr << "mb_per_second " << ((seconds > 0) ? scanner.bytes() / seconds / 1e6 : 0.0) << std::endl;
+  }
+
+  return 0;
+}
+
+// pph encode: what to do with a value that is not a key of the table
+typedef enum _unseen_policy {
+  // stop with an error
+  UNSEEN_ERROR,
+  // write the sentinel instead
+  UNSEEN_SENTINEL,
+  // give it the next id after the table's, in order of first appearance
+  UNSEEN_APPEND
+} unseen_policy_t;
+
+static const char* const UNSEEN_POLICY_NAMES[] = {"error", "sentinel", "append"};
+
+// A value of an encoded column that is not a key of the table
+typedef struct _unseen_value {
+  // where its id goes in the output of the thread
+  size_t      offset_;
+  // line in the chunk
+  uint64_t    line_;
+  // 1-based
+  size_t      column_;
+  std::string value_;
+} unseen_value_t;
+
+// Finds the field that starts at p on a line that ends at end, and sets
+// value and length to its contents. A field that starts with a quote ends
+// at the next quote that is not doubled ("" is a quote in the value);
+// quoted fields cannot span lines. Returns the delimiter after the field,
+// or end.
+static const char* delimited_field(const char* p, const char* end, char delimiter,
+                                   std::deque<std::string>& unescaped,
+                                   const char*& value, size_t& length) {
+  if ((p < end) && (*p == '"')) {
+    const char* start   = ++p;
+    bool        doubled = false;
+
+    while (p < end) {
+      if (*p == '"') {
+        if ((p + 1 < end) && (p[1] == '"')) {
+          doubled = true;
+          p += 2;
+          continue;
+        }
+        break;
+      }
+      p++;
+    }
+
+    if (doubled) {
+      unescaped.emplace_back();
+      std::string& text = unescaped.back();
+
+      for (const char* c = start; c < p; c++) {
+        text += *c;
+        if (*c == '"') {
+          c++;
+        }
+      }
+
+      value  = text.data();
+      length = text.size();
+    } else {
+      value  = start;
+      length = static_cast<size_t>(p - start);
+    }
+
+    // skip the closing quote and anything up to the delimiter
+    const char* next = static_cast<const char*>(std::memchr(p, delimiter, end - p));
+    return (next != nullptr) ? next : end;
+  }
+
+  const char* next = static_cast<const char*>(std::memchr(p, delimiter, end - p));
+
+  value  = p;
+  length = static_cast<size_t>(((next != nullptr) ? next : end) - p);
+
+  return (next != nullptr) ? next : end;
+}
+
+// Replaces the values of some columns of delimited text (CSV, TSV) with
+// their ids in a FrozenTable. Chunks of whole lines are split at line
+// boundaries into one range per thread; each thread collects the values
+// of the selected columns, looks them up in batches and writes its lines
+// into its own buffer, copying everything else through unchanged. The
+// buffers are written in input order, and unseen values are resolved
+// then, so ids appended to the overflow dictionary do not depend on the
+// number of threads.
+class ColumnEncoder {
+public:
+  ColumnEncoder(const pph::FrozenTable& table, const std::vector<std::string>& columns, char delimiter,
+                bool header, unseen_policy_t unseen, const std::string& sentinel, size_t threads,
+                std::FILE* out) :
+    table_(table), specs_(columns), delimiter_(delimiter), header_(header), unseen_(unseen),
+    sentinel_(sentinel), threads_(std::max<size_t>(1, threads)), out_(out), header_pending_(false),
+    header_written_(false), max_column_(0), lines_(0), values_(0), unseen_count_(0),
+    short_lines_(0), bytes_(0), output_(threads_), unseen_values_(threads_),
+    thread_lines_(threads_, 0), thread_short_(threads_, 0), thread_values_(threads_, 0),
+    thread_unseen_(threads_, 0) {
+    bool named = false;
+
+    for (const std::string& spec : specs_) {
+      named = named || (spec.find_first_not_of("0123456789") != std::string::npos) || spec.empty();
+    }
+
+    if (named && !header_) {
+      throw std::invalid_argument("column names need --header");
+    }
+
+    if (!named) {
+      select(std::vector<std::string>());
+    }
+  }
+
+  // Call before the first chunk of each input; only the first header is written
+  void begin_input() {
+    header_pending_ = header_;
+  }
+
+  // Encodes the lines of [begin, end); the last line may lack its newline
+  bool encode(const char* begin, const char* end) {
+    bytes_ += static_cast<uint64_t>(end - begin);
+
+    if (header_pending_ && (begin < end)) {
+      const char* nl   = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+      const char* stop = (nl != nullptr) ? nl + 1 : end;
+
+      if (!header_written_) {
+        if (!resolve_header(begin, stop)) {
+          return false;
+        }
+
+        if (std::fwrite(begin, 1, stop - begin, out_) != static_cast<size_t>(stop - begin)) {
+          return false;
+        }
+
+        header_written_ = true;
+      }
+
+      header_pending_ = false;
+      begin           = stop;
+    }
+
+    // one range of whole lines per thread
+    std::vector<const char*> bounds(threads_ + 1, end);
+    size_t range = (static_cast<size_t>(end - begin) + threads_ - 1) / threads_;
+
+    bounds[0] = begin;
+
+    for (size_t t = 1; t < threads_; t++) {
+      const char* start = std::max(bounds[t - 1], std::min(end, begin + t * range));
+      const char* nl    = (start < end) ? static_cast<const char*>(std::memchr(start, '\n', end - start)) : nullptr;
+
+      bounds[t] = (nl != nullptr) ? nl + 1 : end;
+    }
+
+    std::vector<std::thread> workers;
+
+    for (size_t t = 1; t < threads_; t++) {
+      workers.push_back(std::thread(&ColumnEncoder::encode_range, this, t, bounds[t], bounds[t + 1]));
+    }
+
+    encode_range(0, bounds[0], bounds[1]);
+
+    for (auto& worker : workers) {
+      worker.join();
+    }
+
+    return write_output();
+  }
+
+  // Writes the values appended to the overflow dictionary, in id order
+  bool write_overflow(std::ostream& ostr) const {
+    for (const std::string& value : overflow_keys_) {
+      ostr << value << '\n';
+    }
+
+    return ostr.good();
+  }
+
+  uint64_t lines() const {
+    return lines_;
+  }
+
+  uint64_t values() const {
+    return values_;
+  }
+
+  uint64_t unseen() const {
+    return unseen_count_;
+  }
+
+  uint64_t appended() const {
+    return overflow_keys_.size();
+  }
+
+  uint64_t short_lines() const {
+    return short_lines_;
+  }
+
+  uint64_t bytes() const {
+    return bytes_;
+  }
+
+private:
+  // Sets the selected columns from their numbers or header names
+  void select(const std::vector<std::string>& names) {
+    selected_.clear();
+    max_column_ = 0;
+
+    for (const std::string& spec : specs_) {
+      size_t column = 0;
+
+      if (!spec.empty() && (spec.find_first_not_of("0123456789") == std::string::npos)) {
+        column = std::stoul(spec);
+      } else {
+        auto it = std::find(names.begin(), names.end(), spec);
+        column  = (it != names.end()) ? static_cast<size_t>(it - names.begin()) + 1 : 0;
+      }
+
+      if (column == 0) {
+        throw std::invalid_argument("unknown column '" + spec + "'");
+      }
+
+      max_column_ = std::max(max_column_, column);
+      selected_.resize(max_column_ + 1, false);
+      selected_[column] = true;
+    }
+  }
+
+  bool resolve_header(const char* begin, const char* end) {
+    std::vector<std::string> names;
+    std::deque<std::string>  unescaped;
+
+    while ((end > begin) && ((end[-1] == '\n') || (end[-1] == '\r'))) {
+      end--;
+    }
+
+    for (const char* p = begin; ; p++) {
+      const char* value  = nullptr;
+      size_t      length = 0;
+
+      p = delimited_field(p, end, delimiter_, unescaped, value, length);
+      names.push_back(std::string(value, length));
+
+      if (p >= end) {
+        break;
+      }
+    }
+
+    try {
+      select(names);
+    } catch (const std::invalid_argument& e) {
+      std::cerr << "pph encode: " << e.what() << std::endl;
+      return false;
+    }
+
+    return true;
+  }
+
+  void encode_range(size_t t, const char* begin, const char* end) {
+    std::string&                 out    = output_[t];
+    std::vector<unseen_value_t>& unseen = unseen_values_[t];
+
+    std::vector<const char*> keys;
+    std::vector<size_t>      lengths;
+    std::vector<uint64_t>    vals;
+    // where the field of each key starts and ends in the input
+    std::vector<const char*> starts;
+    std::vector<const char*> stops;
+    std::vector<uint64_t>    key_lines;
+    std::vector<size_t>      key_columns;
+    std::deque<std::string>  unescaped;
+
+    const char* cursor = begin;
+    uint64_t    line   = 0;
+    uint64_t    shorts = 0;
+    uint64_t    count  = 0;
+    uint64_t    misses = 0;
+
+    out.clear();
+    out.reserve(static_cast<size_t>(end - begin) + (end - begin) / 4);
+    unseen.clear();
+
+    auto flush = [&]() {
+      vals.resize(keys.size());
+      table_.find_vals(keys.data(), lengths.data(), keys.size(), vals.data());
+
+      for (size_t i = 0; i < keys.size(); i++) {
+        out.append(cursor, starts[i] - cursor);
+
+        if (!table_.notfound_val(vals[i])) {
+          char digits[20];
+          out.append(digits, format_uint64(digits, vals[i]) - digits);
+        } else if (unseen_ == UNSEEN_SENTINEL) {
+          out.append(sentinel_);
+          misses++;
+        } else {
+          unseen_value_t value;
+          value.offset_ = out.size();
+          value.line_   = key_lines[i];
+          value.column_ = key_columns[i];
+          value.value_.assign(keys[i], lengths[i]);
+          unseen.push_back(value);
+          misses++;
+        }
+
+        cursor = stops[i];
+      }
+
+      count += keys.size();
+
+      keys.clear();
+      lengths.clear();
+      starts.clear();
+      stops.clear();
+      key_lines.clear();
+      key_columns.clear();
+      unescaped.clear();
+    };
+
+    for (const char* p = begin; p < end; line++) {
+      const char* nl        = static_cast<const char*>(std::memchr(p, '\n', end - p));
+      const char* line_end  = (nl != nullptr) ? nl : end;
+      const char* next_line = (nl != nullptr) ? nl + 1 : end;
+
+      if ((line_end > p) && (line_end[-1] == '\r')) {
+        line_end--;
+      }
+
+      if (line_end == p) {
+        // empty lines are copied through
+        p = next_line;
+        continue;
+      }
+
+      size_t first  = keys.size();
+      size_t column = 1;
+
+      for (;;) {
+        const char* value  = nullptr;
+        size_t      length = 0;
+        const char* stop   = delimited_field(p, line_end, delimiter_, unescaped, value, length);
+
+        if (selected_[column]) {
+          keys.push_back(value);
+          lengths.push_back(length);
+          starts.push_back(p);
+          stops.push_back(stop);
+          key_lines.push_back(line);
+          key_columns.push_back(column);
+        }
+
+        if ((stop >= line_end) || (column == max_column_)) {
+          break;
+        }
+
+        p = stop + 1;
+        column++;
+      }
 
-#define STR(x) #x
-#define STR_(x) STR(x)
-#define STR__LINE__ STR_(__LINE__)
+      if (column < max_column_) {
+        // lines without all the columns are copied through
+        keys.resize(first);
+        lengths.resize(first);
+        starts.resize(first);
+        stops.resize(first);
+        key_lines.resize(first);
+        key_columns.resize(first);
+        shorts++;
+      }
 
-#include "pphrelease.h"
-//#define PPH_RELEASE "1.0.0"
+      if (keys.size() >= LOOKUP_BATCH) {
+        flush();
+      }
+
+      p = next_line;
+    }
+
+    flush();
+
+    out.append(cursor, end - cursor);
+
+    thread_lines_[t]  = line;
+    thread_short_[t]  = shorts;
+    thread_values_[t] = count;
+    thread_unseen_[t] = misses;
+  }
+
+  // Writes the buffers in order, giving ids to unseen values
+  bool write_output() {
+    for (size_t t = 0; t < threads_; t++) {
+      const std::string& out    = output_[t];
+      size_t             offset = 0;
+
+      for (const unseen_value_t& value : unseen_values_[t]) {
+        if (unseen_ == UNSEEN_ERROR) {
+          std::cerr << "pph encode: line " << (lines_ + value.line_ + (header_ ? 2 : 1))
+                    << ", column " << value.column_ << ": '" << value.value_
+                    << "' is not in the table" << std::endl;
+          return false;
+        }
+
+        auto it = overflow_.find(value.value_);
+
+        if (it == overflow_.end()) {
+          it = overflow_.emplace(value.value_, table_.size() + overflow_keys_.size()).first;
+          overflow_keys_.push_back(value.value_);
+        }
+
+        char digits[20];
+        char* stop = format_uint64(digits, it->second);
+
+        if ((std::fwrite(out.data() + offset, 1, value.offset_ - offset, out_) != value.offset_ - offset) ||
+            (std::fwrite(digits, 1, stop - digits, out_) != static_cast<size_t>(stop - digits))) {
+          return false;
+        }
+
+        offset = value.offset_;
+      }
+
+      if (std::fwrite(out.data() + offset, 1, out.size() - offset, out_) != out.size() - offset) {
+        return false;
+      }
+
+      lines_        += thread_lines_[t];
+      short_lines_  += thread_short_[t];
+      values_       += thread_values_[t];
+      unseen_count_ += thread_unseen_[t];
+    }
+
+    return true;
+  }
+
+  const pph::FrozenTable&  table_;
+  std::vector<std::string> specs_;
+  char                     delimiter_;
+  bool                     header_;
+  unseen_policy_t          unseen_;
+  std::string              sentinel_;
+  size_t                   threads_;
+  std::FILE*               out_;
+  bool                     header_pending_;
+  bool                     header_written_;
+  // selected_[c] is true if column c (1-based) is encoded
+  std::vector<bool>        selected_;
+  size_t                   max_column_;
+  uint64_t                 lines_;
+  uint64_t                 values_;
+  uint64_t                 unseen_count_;
+  uint64_t                 short_lines_;
+  uint64_t                 bytes_;
+  // results of each thread
+  std::vector<std::string> output_;
+  std::vector<std::vector<unseen_value_t> > unseen_values_;
+  std::vector<uint64_t>    thread_lines_;
+  std::vector<uint64_t>    thread_short_;
+  std::vector<uint64_t>    thread_values_;
+  std::vector<uint64_t>    thread_unseen_;
+  // overflow dictionary: unseen values and their ids
+  std::unordered_map<std::string, uint64_t> overflow_;
+  std::vector<std::string> overflow_keys_;
+};
+
+// pph encode: replaces the values of columns of delimited files with their ids
+static bool is_parquet_file(const std::string& filename) {
+  static const std::string extension(".parquet");
+
+  return (filename.size() > extension.size()) &&
+         (filename.compare(filename.size() - extension.size(), extension.size(), extension) == 0);
+}
+
+// pph encode of a Parquet file: the named columns become UInt32, UInt64 or
+// dictionary columns; unseen values are an error or become nulls
+static int encode_parquet_main(const pph::FrozenTable& table, const std::string& input_filename,
+                               const std::string& output_filename,
+                               const std::vector<std::string>& columns,
+                               const std::string& arrow_type, unseen_policy_t unseen, bool stats) {
+#if PPH_ARROW
+  auto encoding = std::find(std::begin(pph::ARROW_ENCODING_NAMES), std::end(pph::ARROW_ENCODING_NAMES), arrow_type);
+
+  if (encoding == std::end(pph::ARROW_ENCODING_NAMES)) {
+    std::cerr << "Usage Error: --arrow-type must be uint32, uint64 or dictionary" << std::endl;
+    return 1;
+  }
+
+  if (output_filename.empty() || (unseen == UNSEEN_APPEND)) {
+    std::cerr << "Usage Error: Parquet input needs --output and --unseen error or sentinel (nulls)" << std::endl;
+    return 1;
+  }
+
+  uint64_t t_start = pph::stats_clock();
+  auto     result  = pph::encode_parquet(table, input_filename, output_filename, columns,
+                                         static_cast<pph::arrow_encoding_t>(encoding - std::begin(pph::ARROW_ENCODING_NAMES)));
+
+  if (!result.ok()) {
+    std::cerr << "Encoding failed: " << result.status().ToString() << std::endl;
+    return 1;
+  }
+
+  if ((unseen == UNSEEN_ERROR) && (*result != 0)) {
+    std::cerr << "pph encode: " << *result << " values are not in the table" << std::endl;
+    std::remove(output_filename.c_str());
+    return 1;
+  }
+
+  if (stats) {
+    std::cerr << "unseen " << *result << std::endl;
+    std::cerr << "seconds " << ((pph::stats_clock() - t_start) / 1e9) << std::endl;
+  }
+
+  return 0;
+#else
+  (void)table;
+  (void)input_filename;
+  (void)output_filename;
+  (void)columns;
+  (void)arrow_type;
+  (void)unseen;
+  (void)stats;
+
+  std::cerr << "pph encode: cannot read Parquet files; pph was built without PPH_ARROW" << std::endl;
+  return 1;
+#endif
+}
+
+static int encode_main(int argc, const char** argv) {
+  namespace po = boost::program_options;
+
+  std::vector<std::string> input_files;
+  std::string table_filename("");
+  std::string output_filename("");
+  std::string overflow_filename("");
+  std::string columns_list("");
+  std::string delimiter(",");
+  std::string unseen_name("error");
+  std::string sentinel("-1");
+  std::string arrow_type("uint64");
+  size_t      threads = std::max(1u, std::thread::hardware_concurrency());
+
+  po::options_description desc("Options");
+  desc.add_options()("help,h", "Print help messages");
+  desc.add_options()("table,t", po::value<std::string>(&table_filename)->required(), "Path to table file");
+  desc.add_options()("input,i", po::value<std::vector<std::string>>(&input_files), "Path to delimited file(s) (default: standard input)");
+  desc.add_options()("columns,c", po::value<std::string>(&columns_list)->required(), "Columns to encode: 1-based numbers or header names, separated by commas");
+  desc.add_options()("delimiter,d", po::value<std::string>(&delimiter), "Field delimiter: one character, or tab (default: ,)");
+  desc.add_options()("header", "The first line of each input names the columns; it is written once, unchanged");
+  desc.add_options()("unseen", po::value<std::string>(&unseen_name), "Values not in the table: error, sentinel or append (default: error)");
+  desc.add_options()("sentinel", po::value<std::string>(&sentinel), "Written for unseen values with --unseen sentinel (default: -1)");
+  desc.add_options()("overflow", po::value<std::string>(&overflow_filename), "With --unseen append, path to write the appended values to, one per line in id order");
+  desc.add_options()("output,o", po::value<std::string>(&output_filename), "Path to output file (default: standard output)");
+  desc.add_options()("arrow-type", po::value<std::string>(&arrow_type), "For a .parquet input, the type of encoded columns: uint32, uint64 or dictionary (default: uint64)");
+  desc.add_options()("threads,j", po::value<size_t>(&threads), "Threads (default: one per core)");
+  desc.add_options()("stats", "Print counts and throughput to standard error");
+
+  po::positional_options_description positional;
+  positional.add("input", -1);
+
+  po::variables_map vm;
+
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positional).run(), vm);
+
+    if (vm.count("help")) {
+      std::cout << "Usage: pph encode --table <table file> --columns <columns> [<input file(s)>] [--header]" << std::endl;
+      std::cout << "                  [--delimiter <c>|tab] [--unseen error|sentinel|append] [--sentinel <text>]" << std::endl;
+      std::cout << "                  [--overflow <file>] [--output <output file>] [--threads <n>] [--stats]" << std::endl;
+      std::cout << "       pph encode --table <table file> --columns <names> <input>.parquet --output <output>.parquet" << std::endl;
+      std::cout << "                  [--arrow-type uint32|uint64|dictionary] [--unseen error|sentinel] [--stats]" << std::endl;
+      std::cout << std::endl;
+      std::cout << desc << std::endl;
+      return 0;
+    }
+
+    po::notify(vm);
+  } catch (boost::program_options::error& e) {
+    std::cerr << "Usage Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  if ((delimiter == "tab") || (delimiter == "\\t")) {
+    delimiter = "\t";
+  }
+
+  if ((delimiter.size() != 1) || (delimiter[0] == '\n') || (delimiter[0] == '"')) {
+    std::cerr << "Usage Error: the delimiter must be one character other than a newline or quote" << std::endl;
+    return 1;
+  }
+
+  unseen_policy_t unseen = UNSEEN_ERROR;
+  auto policy = std::find(std::begin(UNSEEN_POLICY_NAMES), std::end(UNSEEN_POLICY_NAMES), unseen_name);
+
+  if (policy == std::end(UNSEEN_POLICY_NAMES)) {
+    std::cerr << "Usage Error: --unseen must be error, sentinel or append" << std::endl;
+    return 1;
+  }
+
+  unseen = static_cast<unseen_policy_t>(policy - std::begin(UNSEEN_POLICY_NAMES));
+
+  if ((unseen == UNSEEN_APPEND) && overflow_filename.empty()) {
+    std::cerr << "Usage Error: --unseen append needs --overflow" << std::endl;
+    return 1;
+  }
+
+  std::vector<std::string> columns;
+
+  pph::split(columns, columns_list, ",");
+
+  pph::FrozenTable table;
+
+  if (!pph::load_frozen_table(table_filename, table)) {
+    std::cerr << "Cannot load table from " << table_filename << std::endl;
+    return 1;
+  }
+
+  if ((input_files.size() == 1) && is_parquet_file(input_files[0])) {
+    return encode_parquet_main(table, input_files[0], output_filename, columns, arrow_type,
+                               unseen, (vm.count("stats") != 0));
+  }
+
+  std::FILE* out = open_output(output_filename);
+
+  if (out == nullptr) {
+    return 1;
+  }
+
+  std::unique_ptr<ColumnEncoder> encoder;
+
+  try {
+    encoder.reset(new ColumnEncoder(table, columns, delimiter[0], (vm.count("header") != 0),
+                                    unseen, sentinel, threads, out));
+  } catch (const std::invalid_argument& e) {
+    std::cerr << "Usage Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  auto     encode  = [&encoder](const char* begin, const char* end) {
+    return encoder->encode(begin, end);
+  };
+  uint64_t t_start = pph::stats_clock();
+  bool     status  = true;
+
+  if (input_files.empty()) {
+    encoder->begin_input();
+    status = read_line_chunks(STDIN_FILENO, encode);
+  }
+
+  for (size_t i = 0; status && (i < input_files.size()); i++) {
+    int fd = open(input_files[i].c_str(), O_RDONLY);
+
+    if (fd < 0) {
+      std::cerr << "Cannot open input file '" << input_files[i] << "'" << std::endl;
+      status = false;
+      break;
+    }
+
+    encoder->begin_input();
+    status = read_line_chunks(fd, encode);
+    close(fd);
+  }
+
+  status = (std::fflush(out) == 0) && status;
+
+  if (out != stdout) {
+    status = (std::fclose(out) == 0) && status;
+  }
+
+  if (!status) {
+    if (errno != 0) {
+      std::cerr << "Encoding failed: " << std::strerror(errno) << std::endl;
+    }
+    return 1;
+  }
+
+  if (unseen == UNSEEN_APPEND) {
+    std::ofstream overflow_file(overflow_filename, std::ofstream::out);
+
+    if (!overflow_file || !encoder->write_overflow(overflow_file)) {
+      std::cerr << "Cannot write overflow file '" << overflow_filename << "'" << std::endl;
+      return 1;
+    }
+  }
+
+  if (encoder->short_lines() != 0) {
+    std::cerr << "pph encode: " << encoder->short_lines() << " lines without all the columns were copied unchanged" << std::endl;
+  }
+
+  if (vm.count("stats")) {
+    double seconds = (pph::stats_clock() - t_start) / 1e9;
+
+    std::cerr << "lines " << encoder->lines() << std::endl;
+    std::cerr << "values " << encoder->values() << std::endl;
+    std::cerr << "unseen " << encoder->unseen() << std::endl;
+    std::cerr << "appended " << encoder->appended() << std::endl;
+    std::cerr << "bytes " << encoder->bytes() << std::endl;
+    std::cerr << "mb_per_second " << ((seconds > 0) ? encoder->bytes() / seconds / 1e6 : 0.0) << std::endl;
+  }
+
+  return 0;
+}
+
+// pph gen: writes a synthetic key set, or builds a table from it
+static int gen_main(int argc, const char** argv) {
+  namespace po = boost::program_options;
+
+  std::string shape("ascii");
+  std::string output_filename("");
+  std::string table_filename("");
+  uint64_t    count  = 0;
+  uint64_t    seed   = 0;
+  size_t      length = 16;
+
+  po::options_description desc("Options");
+  desc.add_options()("help,h", "Print help messages");
+  desc.add_options()("shape", po::value<std::string>(&shape), "Key shape: ascii, url, uuid, numeric, path or skewed");
+  desc.add_options()("count,n", po::value<uint64_t>(&count)->required(), "Number of keys");
+  desc.add_options()("seed,S", po::value<uint64_t>(&seed), "Seed of the key set");
+  desc.add_options()("length,L", po::value<size_t>(&length), "Length of ascii keys; longest skewed key");
+  desc.add_options()("output,o", po::value<std::string>(&output_filename), "Path to key output file (default: standard output)");
+  desc.add_options()("build", po::value<std::string>(&table_filename), "Build a table from the keys and write it to this file");
+
+  po::variables_map vm;
+
+  try {
+    po::store(po::parse_command_line(argc, argv, desc), vm);
+
+    if (vm.count("help")) {
+      std::cout << "Usage: pph gen --count <count> [--shape <shape>] [--seed <seed>] [--length <length>]" << std::endl;
+      std::cout << "               [--output <key file>] [--build <table file>]" << std::endl;
+      std::cout << std::endl;
+      std::cout << desc << std::endl;
+      return 0;
+    }
+
+    po::notify(vm);
+  } catch (boost::program_options::error& e) {
+    std::cerr << "Usage Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  try {
+    pph::KeyGenerator generator(pph::key_shape(shape), count, seed, length);
+
+    if (vm.count("build")) {
+      // the keys are collected in memory and loaded without a key file;
+      // Table::load() needs all of them at once
+      std::vector<std::string> keys;
+      std::vector<uint64_t>    values(count);
+      std::string              key;
+
+      keys.reserve(count);
+
+      while (generator.next(key)) {
+        keys.push_back(key);
+      }
+
+      std::iota(values.begin(), values.end(), 0);
+
+      pph::Table table;
+
+      table.setup(count, false, pph::DEFAULT_LOADING_FACTOR, UINT64_C(3600000), seed);
+
+      uint64_t t_start = pph::stats_clock();
+
+      if (!table.load(keys, values)) {
+        std::cerr << "Loading table failed." << std::endl;
+        return -1;
+      }
+
+      uint64_t t_build = pph::stats_clock() - t_start;
+
+      std::ofstream table_file(table_filename, std::ofstream::out);
+      table.serialize(table_file);
+      table_file.close();
+
+      const pph::FrozenTable frozen(table);
+
+      std::cout << "keys " << count << std::endl;
+      std::cout << "build_ms " << (t_build / 1000000.0) << std::endl;
+      std::cout << "bits_per_key " << ((count == 0) ? 0.0 : (frozen.bytes() * 8.0) / count) << std::endl;
+    }
+
+    if (vm.count("output") || !vm.count("build")) {
+      std::ofstream output_file;
+      std::ostream  output_stream(std::cout.rdbuf());
+
+      if (!output_filename.empty()) {
+        output_file.open(output_filename, std::ofstream::out);
+
+        if (!output_file) {
+          std::cerr << "Cannot open output file '" << output_filename << "'" << std::endl;
+          return 1;
+        }
+
+        output_stream.rdbuf(output_file.rdbuf());
+      }
+
+      generator.reset();
+      pph::write_keys(generator, output_stream);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Generating keys error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
+
+// --emit-cpp: writes table as a self-contained header
+static bool emit_cpp_header(const pph::Table& table, const std::string& header_filename,
+                            const std::string& name) {
+  std::ofstream header_file(header_filename, std::ofstream::out);
+
+  if (!header_file) {
+    std::cerr << "Cannot open header file '" << header_filename << "'" << std::endl;
+    return false;
+  }
+
+  try {
+    pph::emit_cpp(pph::FrozenTable(table), header_file,
+                  name.empty() ? pph::CppEmitter::identifier(header_filename, false) : name,
+                  "_" + pph::CppEmitter::identifier(header_filename, true));
+  } catch (const std::invalid_argument& e) {
+    std::cerr << "Cannot emit C++: " << e.what() << std::endl;
+    return false;
+  }
+
+  header_file.close();
+
+  if (!header_file) {
+    std::cerr << "Cannot write header file '" << header_filename << "'" << std::endl;
+    return false;
+  }
+
+  return true;
+}
 
 int main(int argc, const char** argv) {
   int retval = 0;
 
+  if ((argc > 1) && (std::string(argv[1]) == "gen")) {
+    return gen_main(argc - 1, argv + 1);
+  }
+
+  if ((argc > 1) && (std::string(argv[1]) == "encode")) {
+    return encode_main(argc - 1, argv + 1);
+  }
+
   // File options
   std::vector<std::string> input_files;
   std::string              config_file("hash.conf");
   std::string              table_filename("table.hash");
   std::string              output_filename("output.hash");
+  std::string              trace_filename("");
+  std::string              trace_format("json");
+  std::string              check_filename("");
+  std::string              lookup_filename("");
+  std::string              tokenize_filename("");
+  std::string              token_chars("");
+  std::string              miss("-1");
+  std::string              emit_filename("");
+  std::string              emit_namespace("");
+  size_t                   threads    = std::max(1u, std::thread::hardware_concurrency());
 
   std::ifstream            table_file;
   std::ifstream            input_file;
@@ -72,8 +1604,10 @@ int main(int argc, const char** argv) {
   std::string              uuid       = "BCC54D42-34F0-43FF-88EB-59C7B47EE210";
   double                   p          = 0.97;
   bool                     use_p      = false;
+  bool                     fold_case  = false;
 
   pph::Table               table;
+  pph::BuildTrace          trace;
 
   std::vector<std::string> keys;
   std::vector<uint64_t>    values;
@@ -93,6 +1627,18 @@ int main(int argc, const char** argv) {
   desc.add_options()("input,i", po::value<std::vector<std::string>>(), "Path to data file(s)");
   desc.add_options()("output,o", po::value<std::string>(&output_filename)->required()->default_value("output"), "Path to table output file");
   desc.add_options()("verify", po::value<std::string>(&table_filename), "Path to table file to verify");
+  desc.add_options()("check", po::value<std::string>(&check_filename), "Path to table file whose checksums to check");
+  desc.add_options()("lookup", po::value<std::string>(&lookup_filename), "Path to table file; prints the value of each line of the input files (or standard input)");
+  desc.add_options()("miss", po::value<std::string>(&miss), "Printed by --lookup for lines (--tokenize for tokens) that are not keys (default: -1)");
+  desc.add_options()("tokenize", po::value<std::string>(&tokenize_filename), "Path to table file; prints the offset, length and value of each token of the input files (or standard input)");
+  desc.add_options()("token-chars", po::value<std::string>(&token_chars), "Bytes of --tokenize tokens, e.g. '^ \\t,;' (default: A-Za-z0-9_)");
+  desc.add_options()("hits-only", "--tokenize prints only the tokens that are keys");
+  desc.add_options()("stats", "Print lookup statistics of the verification");
+  desc.add_options()("threads,j", po::value<size_t>(&threads), "Threads used to verify the table (default: one per core)");
+  desc.add_options()("emit-cpp", po::value<std::string>(&emit_filename), "Also write the built (or --verify) table as a self-contained C++ header to this file");
+  desc.add_options()("emit-namespace", po::value<std::string>(&emit_namespace), "Namespace of the --emit-cpp header (default: the header file name)");
+  desc.add_options()("trace", po::value<std::string>(&trace_filename), "Path to construction trace output file");
+  desc.add_options()("trace-format", po::value<std::string>(&trace_format), "Construction trace format: json or chrome");
 
   // Declare a group of options that will be allowed both on command line and in the config file
   po::options_description config("Configuration");
@@ -110,6 +1656,9 @@ int main(int argc, const char** argv) {
   config.add_options()("adjustment,A",
                        po::value<uint64_t>(&adjustment)->default_value(adjustment)->implicit_value(0),
                        "Adjustment for key hash functions");
+  config.add_options()("fold-case",
+                       po::bool_switch(&fold_case),
+                       "Keys are case-insensitive for ASCII letters");
   config.add_options()("skip,S",
                        po::value<uint64_t>(&skip)->default_value(skip)->implicit_value(0),
                        "Number of rows to skip in input file");
@@ -137,9 +1686,16 @@ int main(int argc, const char** argv) {
     }
 
     if (vm.count("help")) {
-      std::cout << "Usage: pph <input file(s)> [--config <config file>] [--verify <table file>] " << std::endl;
+      std::cout << "Usage: pph <input file(s)> [--config <config file>] [--verify <table file>] [--stats] [--threads <n>]" << std::endl;
       std::cout << "           [--output <output file>] [--version|-v] [--timeout <timeout>]" << std::endl;
-      std::cout << "           [--uuid <uuid>] [--multiplier <multiplier>] [--adjustment <adjustment>]" << std::endl;
+      std::cout << "           [--uuid <uuid>] [--multiplier <multiplier>] [--adjustment <adjustment>] [--fold-case]" << std::endl;
+      std::cout << "           [--trace <trace file>] [--trace-format json|chrome]" << std::endl;
+      std::cout << "           [--emit-cpp <header file>] [--emit-namespace <namespace>]" << std::endl;
+      std::cout << "       pph --check <table file>" << std::endl;
+      std::cout << "       pph --lookup <table file> [<input file(s)>] [--output <output file>] [--miss <text>] [--threads <n>]" << std::endl;
+      std::cout << "       pph --tokenize <table file> [<input file(s)>] [--token-chars <class>] [--hits-only] [--output <output file>]" << std::endl;
+      std::cout << "       pph gen --count <count> [--shape <shape>] [--output <key file>]" << std::endl;
+      std::cout << "       pph encode --table <table file> --columns <columns> [<input file(s)>] [--unseen error|sentinel|append]" << std::endl;
       std::cout << std::endl
       << std::endl;
       std::cout << desc
@@ -154,6 +1710,33 @@ int main(int argc, const char** argv) {
       return 0;
     }
 
+    if (vm.count("check")) {
+      return check_main(check_filename);
+    }
+
+    if (vm.count("lookup")) {
+      std::vector<std::string> lookup_files;
+
+      if (vm.count("input")) {
+        lookup_files = vm["input"].as<std::vector<std::string>>();
+      }
+
+      // results go to standard output unless --output is given
+      return lookup_main(lookup_filename, lookup_files, vm["output"].defaulted() ? "" : output_filename,
+                         miss, threads, (vm.count("stats") != 0));
+    }
+
+    if (vm.count("tokenize")) {
+      std::vector<std::string> tokenize_files;
+
+      if (vm.count("input")) {
+        tokenize_files = vm["input"].as<std::vector<std::string>>();
+      }
+
+      return tokenize_main(tokenize_filename, tokenize_files, vm["output"].defaulted() ? "" : output_filename,
+                           token_chars, miss, (vm.count("hits-only") != 0), (vm.count("stats") != 0));
+    }
+
     if (vm.count("verify")) {
       // open the hash table file
       table_file.open(table_filename, std::ifstream::in);
@@ -168,20 +1751,20 @@ int main(int argc, const char** argv) {
 
       // unserialize the hash function
 
-      table.unserialize(table_stream);
+      if (!table.unserialize(table_stream)) {
+        std::cerr << "Cannot load table from " << table_filename << " (bad format or checksums)" << std::endl;
+        return -1;
+      }
+
+      if (vm.count("stats")) {
+        table.enable_stats();
+      }
 
       // Test generated table
 
       try {
-        uint64_t val = 0;
-
-        for (int i = 0; i < table.keys().size(); i++) {
-          val = table.find_val(table.keys()[i]);
-
-          if (table.notfound_val(val)) {
-            std::cerr << "Error verifying key '" << table.keys()[i] << "' at index " << i << std::endl;
-            return -1;
-          }
+        if (!report_verify(verify_table(table, table.keys(), threads), table.keys())) {
+          return -1;
         }
       } catch (const std::exception& e) {
         std::cerr << "Testing hash function error: " << e.what() << std::endl;
@@ -190,6 +1773,14 @@ int main(int argc, const char** argv) {
 
       std::cout << "Hash function verified; loaded from " << table_filename << std::endl;
 
+      if (vm.count("stats")) {
+        table.stats().print(std::cout);
+      }
+
+      if (vm.count("emit-cpp") && !emit_cpp_header(table, emit_filename, emit_namespace)) {
+        return -1;
+      }
+
       // close the table file
 
       table_file.close();
@@ -201,6 +1792,11 @@ int main(int argc, const char** argv) {
       use_p = true;
     }
 
+    if ((trace_format != "json") && (trace_format != "chrome")) {
+      std::cerr << "Usage Error: unknown trace format '" << trace_format << "'" << std::endl;
+      return 1;
+    }
+
     if (vm.count("input")) {
       std::cerr << "Input files are: " << std::endl;
 
@@ -280,10 +1876,12 @@ int main(int argc, const char** argv) {
 
   // setup the table for hash function generation
 
-  table.setup(count, use_p, p, timeout, seed, multiplier, adjustment);
+  table.setup(count, use_p, p, timeout, seed, multiplier, adjustment, pph::uuid_to_keyfunc(uuid));
 
   table.set_uuid(uuid);
 
+  table.set_fold_case(fold_case);
+
   // print index
 
   if (vm.count("index")) {
@@ -296,6 +1894,10 @@ int main(int argc, const char** argv) {
     }
   }
 
+  if (vm.count("trace")) {
+    table.set_trace(&trace);
+  }
+
   // load the table and generate the hash function
 
   try {
@@ -311,17 +1913,14 @@ int main(int argc, const char** argv) {
   }
   // Test generated table
 
-  try {
-    uint64_t val = 0;
-
-    for (int i = 0; i < keys.size(); i++) {
-      val = table.find_val(keys[i]);
+  if (vm.count("stats")) {
+    table.enable_stats();
+  }
 
-      if (table.notfound_val(val)) {
-        std::cerr << "Error verifying key '" << keys[i] << "' at index " << i << std::endl;
-        retval = -1;
-        goto finish;
-      }
+  try {
+    if (!report_verify(verify_table(table, keys, threads), keys)) {
+      retval = -1;
+      goto finish;
     }
   } catch (const std::exception& e) {
     std::cerr << "Testing hash function error: " << e.what() << std::endl;
@@ -331,8 +1930,30 @@ int main(int argc, const char** argv) {
 
   std::cout << "Hash function generated and verified; written to " << output_filename << std::endl;
 
+  if (vm.count("stats")) {
+    table.stats().print(std::cout);
+  }
+
+  if (vm.count("emit-cpp") && !emit_cpp_header(table, emit_filename, emit_namespace)) {
+    retval = -1;
+  }
+
 finish:
 
+  // write the construction trace
+
+  if (vm.count("trace")) {
+    std::ofstream trace_file(trace_filename, std::ofstream::out);
+
+    if (trace_format == "chrome") {
+      trace.write_chrome(trace_file);
+    } else {
+      trace.write_json(trace_file);
+    }
+
+    trace_file.close();
+  }
+
   // serialize the hash function
 
   table.serialize(output_stream);
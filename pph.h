@@ -49,6 +49,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 #include <cassert>
 #include <climits>
 #include <limits>
@@ -57,6 +58,32 @@
 #include <algorithm>
 #include <numeric>
 #include <random>       // for random_device
+#include <stdexcept>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <future>
+#include <chrono>
+#include <condition_variable>
+#include <cctype>
+#include <cerrno>
+#include <streambuf>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Lookup statistics are compiled in unless PPH_STATS is 0
+#ifndef PPH_STATS
+#define PPH_STATS 1
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define PPH_X86 1
+#include <immintrin.h>
+#endif
 
 #include "SpookyV2.h"
 
@@ -83,6 +110,15 @@ static constexpr uint64_t DEFAULT_TIMEOUT        = UINT64_C(60000);
 // Number of multipliers to try before increasing r
 static constexpr uint64_t DEFAULT_ATTEMPTS       = UINT64_C(100);
 
+// First line of serialized tables. Tables are written with checksums
+// (TableChecksum.h) since 1.1.0; files of 1.0.0 may have none.
+static constexpr char     TABLE_VERSION[]        = "pph version 1.1.0";
+static constexpr char     TABLE_VERSION_LEGACY[] = "pph version 1.0.0";
+
+// Flags of serialized tables (the 8th field of the parameters line)
+static constexpr uint64_t TABLE_FLAG_FOLD_CASE   = UINT64_C(1);
+static constexpr uint64_t TABLE_FLAGS_KNOWN      = TABLE_FLAG_FOLD_CASE;
+
 inline uint64_t modulo(uint64_t x, uint64_t y) {
   if ((y & (y-1)) == 0) {
     // y is a power of 2
@@ -119,6 +155,8 @@ inline uint64_t modulo(uint64_t x, uint64_t y) {
 
 #include "StringUtil.h"
 
+#include "CpuFeatures.h"
+
 typedef struct _hdr {
   _hdr() : p_(0), r_(0), i_(0) {}
   // starting index for the group (p)
@@ -177,38 +215,55 @@ typedef struct _data {
 
 typedef uint64_t (*keyfunc_t)(const std::string&, uint64_t, uint64_t);
 
-// UUID: F80F007A-26C3-4BD0-A481-24EE9AE94D01
-uint64_t crc64(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+// Same key function over a buffer, for callers that do not hold std::string keys
+//
+// Key functions are additive in the adjustment:
+// key(k, multiplier, adjustment) == key(k, multiplier, 0) + adjustment
+typedef uint64_t (*bufkeyfunc_t)(const char*, size_t, uint64_t, uint64_t);
+
+inline uint64_t crc64_buf(const char* data, size_t len, uint64_t /*multiplier*/, uint64_t adjustment) {
   crc_64_type crc;
-  crc.process_bytes(str.data(), str.size());
+  crc.process_bytes(data, len);
   return crc.checksum() + adjustment;
 }
 
-// UUID: BCC54D42-34F0-43FF-88EB-59C7B47EE210
-uint64_t djb_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+// UUID: F80F007A-26C3-4BD0-A481-24EE9AE94D01
+uint64_t crc64(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return crc64_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
+inline uint64_t djb_hash_buf(const char* data, size_t len, uint64_t multiplier, uint64_t adjustment) {
   uint64_t keyval = 0;
 
-  for (int i = 0; i < str.size(); i++) {
-    keyval = keyval * multiplier ^ static_cast<uint64_t>(str[i]);
+  for (size_t i = 0; i < len; i++) {
+    keyval = keyval * multiplier ^ static_cast<uint64_t>(data[i]);
   }
 
   return keyval + adjustment;
 }
 
+// UUID: BCC54D42-34F0-43FF-88EB-59C7B47EE210
+uint64_t djb_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return djb_hash_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
 // UUID: 87333E59-7C1A-4613-9C6F-81F1BB1F6AED
 #include "fnv64a_hash.h"
 
+inline uint64_t spookyV2_hash_buf(const char* data, size_t len, uint64_t multiplier, uint64_t adjustment) {
+  return SpookyHash::Hash64(data, len, multiplier) + adjustment;
+}
+
 // UUID: A647F03D-A02E-477F-9635-420F3BCEB394
 uint64_t spookyV2_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
-  return SpookyHash::Hash64(str.c_str(), str.length(), multiplier) + adjustment;
+  return spookyV2_hash_buf(str.data(), str.size(), multiplier, adjustment);
 }
 
-// UUID: 3AC2A805-6771-4189-8C62-5F41297126FE
-uint64_t oat_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+inline uint64_t oat_hash_buf(const char* data, size_t len, uint64_t /*multiplier*/, uint64_t adjustment) {
   uint64_t h = 0;
 
-  for (int i = 0; i < str.size(); i++) {
-    h += static_cast<uint64_t>(str[i]);
+  for (size_t i = 0; i < len; i++) {
+    h += static_cast<uint64_t>(data[i]);
     h += (h << 10);
     h ^= (h >> 6);
   }
@@ -220,6 +275,26 @@ uint64_t oat_hash(const std::string& str, uint64_t multiplier, uint64_t adjustme
   return h + adjustment;
 }
 
+// UUID: 3AC2A805-6771-4189-8C62-5F41297126FE
+uint64_t oat_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return oat_hash_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
+// UUID: B14FD9E5-C32E-4DAE-99B6-16F896FDD34E
+#include "crc32c_hash.h"
+
+// UUID: FB2B126B-ABFD-488B-AA5B-103C32D34341
+#include "crc64_clmul.h"
+
+// UUID: AFC54786-F95B-4560-834E-F75B07ED715B
+#include "wyhash.h"
+
+// UUID: B7F3DDEA-D10C-467E-A429-7933CE00119B
+#include "simd_hash.h"
+
+// ASCII case folding for case-insensitive tables
+#include "CaseFold.h"
+
 keyfunc_t uuid_to_keyfunc(const std::string& uuid) {
   if (uuid == "F80F007A-26C3-4BD0-A481-24EE9AE94D01") {
     return crc64;
@@ -231,14 +306,71 @@ keyfunc_t uuid_to_keyfunc(const std::string& uuid) {
     return oat_hash;
   } else if (uuid == "A647F03D-A02E-477F-9635-420F3BCEB394") {
     return spookyV2_hash;
+  } else if (uuid == "B14FD9E5-C32E-4DAE-99B6-16F896FDD34E") {
+    return crc32c_hash;
+  } else if (uuid == "FB2B126B-ABFD-488B-AA5B-103C32D34341") {
+    return crc64_clmul;
+  } else if (uuid == "AFC54786-F95B-4560-834E-F75B07ED715B") {
+    return wy_hash;
+  } else if (uuid == "B7F3DDEA-D10C-467E-A429-7933CE00119B") {
+    return wordmix_hash;
   }
 
   // return djb_hash for unknown UUIDs
   return djb_hash;
 }
 
+// Buffer form of a key function
+bufkeyfunc_t keyfunc_to_bufkeyfunc(keyfunc_t key) {
+  if (key == djb_hash) {
+    return djb_hash_buf;
+  } else if (key == fnv64a_hash) {
+    return fnv64a_hash_buf;
+  } else if (key == wordmix_hash) {
+    return wordmix_hash_buf;
+  } else if ((key == crc64) || (key == crc64_clmul)) {
+    return crc64_clmul_buf;
+  } else if (key == oat_hash) {
+    return oat_hash_buf;
+  } else if (key == spookyV2_hash) {
+    return spookyV2_hash_buf;
+  } else if (key == crc32c_hash) {
+    return crc32c_hash_buf;
+  } else if (key == wy_hash) {
+    return wy_hash_buf;
+  }
+
+  // user supplied key function
+  return nullptr;
+}
+
+// Batch form of a key function; SIMD kernels where available
+batchkeyfunc_t keyfunc_to_batchkeyfunc(keyfunc_t key) {
+  if (key == djb_hash) {
+    return djb_hash_batch;
+  } else if (key == fnv64a_hash) {
+    return fnv64a_hash_batch;
+  } else if (key == wordmix_hash) {
+    return wordmix_hash_batch;
+  } else if ((key == crc64) || (key == crc64_clmul)) {
+    // crc64_clmul computes the same CRC-64
+    return bufkeyfunc_batch<crc64_clmul_buf>;
+  } else if (key == oat_hash) {
+    return bufkeyfunc_batch<oat_hash_buf>;
+  } else if (key == spookyV2_hash) {
+    return bufkeyfunc_batch<spookyV2_hash_buf>;
+  } else if (key == crc32c_hash) {
+    return bufkeyfunc_batch<crc32c_hash_buf>;
+  } else if (key == wy_hash) {
+    return bufkeyfunc_batch<wy_hash_buf>;
+  }
+
+  // user supplied key function
+  return nullptr;
+}
+
 typedef struct _func {
-  _func() : key_(djb_hash), suggestion_(0) {
+  _func() : key_(djb_hash), batch_(djb_hash_batch), suggestion_(0) {
     add(0, 0, 0);
   }
 
@@ -247,6 +379,11 @@ typedef struct _func {
     return modulo(modulo(key_(k, multiplier, adjustment), modulus), r);
   }
 
+  // h_internal() given the key function value for an adjustment of 0
+  uint64_t h_internal_hash(int64_t modulus, uint64_t adjustment, uint64_t hash, int64_t r) {
+    return modulo(modulo(hash + adjustment, modulus), r);
+  }
+
   void reset_suggest_adjustment() {
     suggestion_ = 0;
   }
@@ -259,7 +396,11 @@ typedef struct _func {
       return 0;
     }
 
-    uint64_t key        = key_(k, multiplier, 0);
+    return suggest_adjustment_hash(modulus, key_(k, multiplier, 0));
+  }
+
+  // suggest_adjustment() given the key function value for an adjustment of 0
+  uint64_t suggest_adjustment_hash(int64_t modulus, uint64_t key) {
     uint64_t suggestion = 0;
 
     if (key < (modulus*pph::KEY_ADJUSTMENT_FACTOR)) {
@@ -274,7 +415,22 @@ typedef struct _func {
   }
 
   void setup(keyfunc_t key) {
-    key_ = key;
+    key_   = key;
+    batch_ = keyfunc_to_batchkeyfunc(key);
+  }
+
+  // Hashes count keys with the key function; batch_ is null for key
+  // functions without a batch form
+  void hash_keys(const char* const* keys, const size_t* lengths,
+                 const uint64_t* multipliers, size_t count, uint64_t* hashes) {
+    if (batch_ != nullptr) {
+      batch_(keys, lengths, multipliers, count, hashes);
+      return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+      hashes[i] = key_(std::string(keys[i], lengths[i]), multipliers[i], 0);
+    }
   }
 
   bool is_candidate(uint64_t i, uint64_t r) {
@@ -292,6 +448,13 @@ typedef struct _func {
     return h_internal(h_[i], multiplier_[i], adjustment_[i], k, r);
   }
 
+  uint64_t h_hash(uint64_t i, uint64_t hash, uint64_t r) {
+    if (i >= h_.size())
+      return 0;
+
+    return h_internal_hash(h_[i], adjustment_[i], hash, r);
+  }
+
   uint64_t add(uint64_t p, uint64_t m, uint64_t a) {
     h_.push_back(p);
     multiplier_.push_back(m);
@@ -328,17 +491,39 @@ typedef struct _func {
   std::vector<uint64_t> adjustment_;
   uint64_t suggestion_;
   keyfunc_t key_;
+  batchkeyfunc_t batch_;
 } func_t;
 
+// Lookup counters and latency histograms
+#include "LookupStats.h"
+
+// Trace of the construction of a table
+#include "BuildTrace.h"
+
+// Checksums of the sections of a table file
+#include "TableChecksum.h"
+
+// Reads a block of memory as a stream without copying it
+class MemoryStreambuf : public std::streambuf {
+public:
+  MemoryStreambuf(const char* data, size_t size) {
+    char* begin = const_cast<char*>(data);
+    setg(begin, begin, begin + size);
+  }
+};
+
 class Table {
+  friend class FrozenTable;
+
 public:
   Table(): n_(0), p_(pph::DEFAULT_LOADING_FACTOR), multiplier_(pph::HASH_MULTIPLIER), adjustment_(0),
   uuid_("BCC54D42-34F0-43FF-88EB-59C7B47EE210"),
-  timeout_(pph::DEFAULT_TIMEOUT) {
+  timeout_(pph::DEFAULT_TIMEOUT), trace_(nullptr), checksums_verified_(false), fold_case_(false) {
     empty_.key_ = EMPTY_STR;
     empty_.val_ = EMPTY_VAL;
-    func_.key_  = djb_hash;
-    key_ = djb_hash;
+    func_.setup(djb_hash);
+    key_   = djb_hash;
+    batch_ = djb_hash_batch;
   }
 
   uint64_t s() {
@@ -361,6 +546,7 @@ public:
   uint64_t find_r(uint64_t src, uint64_t size, uint64_t newsize) {
     uint64_t num_slots = D_.size();
     uint64_t count;
+    uint64_t scan      = 0;
 
     // find non-overlapping free space
 
@@ -371,6 +557,7 @@ public:
           uint64_t upper = std::min(i+newsize, src);
 
           count = 0;
+          scan += upper - i;
 
           for (int j = i; j < upper; j++) {
             if (D_[j].key_[0] == 0) {
@@ -379,6 +566,7 @@ public:
           }
 
           if (count == newsize) {
+            trace_find_r(scan, 0);
             return i;
           }
         }
@@ -397,6 +585,7 @@ public:
         uint64_t upper = std::min(i+newsize, num_slots);
 
         count = 0;
+        scan += upper - i;
 
         for (int j = i; j < upper; j++) {
           if (D_[j].key_[0] == 0) {
@@ -405,6 +594,7 @@ public:
         }
 
         if (count == newsize) {
+          trace_find_r(scan, newsize);
           return i;
         }
       }
@@ -412,9 +602,18 @@ public:
 
     // should never reach here
 
+    trace_find_r(scan, newsize);
+
     return UINT64_MAX;
   }
 
+  void trace_find_r(uint64_t scan, uint64_t grown) {
+    if (trace_ != nullptr) {
+      event_.scan_  += scan;
+      event_.grown_ += grown;
+    }
+  }
+
   // NOTE: The number of items to be hashed (n) needs to be known
   //       when the table is created.
   void setup(uint64_t n, bool use_p, double p, uint64_t timeout = pph::DEFAULT_TIMEOUT,
@@ -476,6 +675,47 @@ public:
     random_.seed(seed_);
   }
 
+  // Keys tried by find_h(): entry 0 is the key being inserted and entry
+  // 1+j is slot p+j. Candidate functions mostly share a few multipliers,
+  // so the keys are hashed once per multiplier (in batches) and each
+  // attempt only applies its modulus and adjustment.
+  typedef struct _group {
+    explicit _group(const data_t& D) {
+      keys_.push_back(D.key_);
+      lengths_.push_back(std::strlen(D.key_));
+    }
+
+    std::vector<const char*> keys_;
+    std::vector<size_t>      lengths_;
+    std::map<uint64_t, std::vector<uint64_t> > hashes_;
+  } group_t;
+
+  // Key function values (adjustment 0) of the first count slots from p
+  const std::vector<uint64_t>& hash_group(group_t& group, uint64_t multiplier, uint64_t p, uint64_t count) {
+    uint64_t avail = (p < D_.size()) ? std::min(count, static_cast<uint64_t>(D_.size() - p)) : 0;
+
+    while (group.keys_.size() < avail + 1) {
+      const char* k = D_[p + group.keys_.size() - 1].key_;
+
+      group.keys_.push_back(k);
+      group.lengths_.push_back(std::strlen(k));
+    }
+
+    std::vector<uint64_t>& hashes = group.hashes_[multiplier];
+    size_t start = hashes.size();
+
+    if (start < group.keys_.size()) {
+      size_t num = group.keys_.size() - start;
+      std::vector<uint64_t> multipliers(num, multiplier);
+
+      hashes.resize(group.keys_.size());
+      func_.hash_keys(group.keys_.data() + start, group.lengths_.data() + start,
+                      multipliers.data(), num, hashes.data() + start);
+    }
+
+    return hashes;
+  }
+
   hdr_t find_h(uint64_t p, uint64_t r, data_t& D, double timeout) {
     auto t_start        = std::chrono::high_resolution_clock::now();
     uint64_t idx        = 0;
@@ -483,6 +723,9 @@ public:
     uint64_t multiplier = pph::HASH_MULTIPLIER;
     uint64_t adjustment = 0;
     uint64_t attempts   = 0;
+    // for the trace: existing and new functions tried
+    uint64_t candidates = 0;
+    uint64_t tries      = 0;
     hdr_t  hdr;
 
     uint64_t next_r     = r+1;
@@ -491,6 +734,9 @@ public:
     hdr.i_ = 0;
     hdr.r_ = r;
 
+    // Key function values of the group, computed once per multiplier
+    group_t group(D);
+
     // The size of r may have to be increased to find a hash function.
     //
     // Example: r = 2
@@ -514,12 +760,16 @@ public:
       if (!func_.is_candidate(i, next_r))
         continue;
 
+      candidates++;
+
+      const std::vector<uint64_t>& hashes = hash_group(group, func_.multiplier(i), p, r);
+
       std::vector<bool> collisions(next_r);
       std::fill(collisions.begin(), collisions.end(), false);
       bool found = true;
 
       // add r+1 data
-      idx = func_.h(i, D.key_, next_r);
+      idx = func_.h_hash(i, hashes[0], next_r);
       collisions[idx] = true;
 
       // check r data
@@ -527,7 +777,7 @@ public:
         if (D_[p + j].key_[0] == 0)
           continue;
 
-        idx = func_.h(i, D_[p + j].key_, next_r);
+        idx = func_.h_hash(i, hashes[1 + j], next_r);
 
         if (collisions[idx] == true) {
           found = false;
@@ -544,6 +794,8 @@ public:
         hdr.i_ = i;
         hdr.r_ = next_r;
 
+        trace_find_h(candidates, tries, true);
+
         return hdr;
       }
     }
@@ -555,6 +807,7 @@ public:
     attempts = 0;
 
     for (uint64_t i = 0;; i++) {
+      tries++;
 
       collisions.clear();
       collisions.resize(next_r, false);
@@ -603,18 +856,21 @@ public:
         modulus++;
       }
 
+      const std::vector<uint64_t>& hashes = hash_group(group, multiplier, p, next_r);
+
       // check if a key adjustment is necessary
 
       func_.reset_suggest_adjustment();
 
-      adjustment = func_.suggest_adjustment(modulus, multiplier, 0, D.key_);
+      adjustment = func_.suggest_adjustment_hash(modulus, hashes[0]);
 
       for (uint64_t j = 0; j < next_r; j++) {
-        adjustment = func_.suggest_adjustment(modulus, multiplier, 0, D_[p + j].key_);
+        // slots past the end of D_ have no key
+        adjustment = (1 + j < hashes.size()) ? func_.suggest_adjustment_hash(modulus, hashes[1 + j]) : 0;
       }
 
       // add r+1 data
-      idx = func_.h_internal(modulus, multiplier, adjustment, D.key_, next_r);
+      idx = func_.h_internal_hash(modulus, adjustment, hashes[0], next_r);
       collisions[idx] = true;
 
       // check r data
@@ -622,7 +878,7 @@ public:
         if (D_[p + j].key_[0] == 0)
           continue;
 
-        idx = func_.h_internal(modulus, multiplier, adjustment, D_[p + j].key_, next_r);
+        idx = func_.h_internal_hash(modulus, adjustment, hashes[1 + j], next_r);
 
         if (collisions[idx] == true) {
           found = false;
@@ -641,6 +897,8 @@ public:
         hdr.i_ = idx;
         hdr.r_ = next_r;
 
+        trace_find_h(candidates, tries, false);
+
         return hdr;
       }
 
@@ -669,10 +927,20 @@ public:
     hdr.i_ = 0;
     hdr.r_ = 0;
 
+    trace_find_h(candidates, tries, false);
+
     // not found
     return hdr;
   }
 
+  void trace_find_h(uint64_t candidates, uint64_t tries, bool reused) {
+    if (trace_ != nullptr) {
+      event_.candidates_ = candidates;
+      event_.attempts_   = tries;
+      event_.reused_     = reused;
+    }
+  }
+
   void move_nonoverlap(uint64_t hidx, uint64_t src, uint64_t dst, uint64_t size,
                        uint64_t m, uint64_t r) {
     uint64_t num_slots = D_.size();
@@ -740,12 +1008,18 @@ public:
   }
 
   bool insert(const char* k, uint64_t v) {
-    auto t_start = std::chrono::high_resolution_clock::now();
-
     uint64_t hidx = h(k);
     hdr_t  hdr = H_[hidx];
     data_t dat;
 
+    if (trace_ != nullptr) {
+      event_ = trace_event_t();
+      event_.key_      = k;
+      event_.val_      = v;
+      event_.bucket_   = hidx;
+      event_.start_ns_ = trace_->now();
+    }
+
     if (hdr.r_ == 0) {
       uint64_t y = find_r(0, 1, 1);
 
@@ -775,6 +1049,7 @@ public:
 
       if (hdr.r_ == 0) {
         // hash function for r values was not found before timeout
+        trace_insert(hidx, false);
         return false;
       }
 
@@ -782,6 +1057,7 @@ public:
       uint64_t y = find_r(p, r, hdr.r_);
 
       if (y == UINT64_MAX) {
+        trace_insert(hidx, false);
         return false;
       }
 
@@ -799,18 +1075,89 @@ public:
       H_[h(k)] = hdr;
     }
 
-    auto t_end = std::chrono::high_resolution_clock::now();
-    double t_duration = std::chrono::duration<double, std::milli>(t_end-t_start).count();
+    trace_insert(hidx, true);
 
     return true;
   }
 
+  void trace_insert(uint64_t hidx, bool ok) {
+    if (trace_ == nullptr) {
+      return;
+    }
+
+    const hdr_t& hdr = H_[hidx];
+
+    event_.r_    = hdr.r_;
+    event_.keys_ = 0;
+
+    for (uint64_t j = 0; j < hdr.r_; j++) {
+      if (D_[hdr.p_ + j].key_[0] != 0) {
+        event_.keys_++;
+      }
+    }
+
+    if (!ok) {
+      // the key was not added
+      event_.keys_++;
+    }
+
+    event_.ok_          = ok;
+    event_.duration_ns_ = trace_->now() - event_.start_ns_;
+
+    trace_->add(event_);
+  }
+
   uint64_t find_val(const std::string& k) {
+    if (fold_case_) {
+      // folded on the stack by find_vals()
+      const char* key = k.data();
+      size_t      len = k.size();
+      uint64_t    val;
+
+      find_vals(&key, &len, 1, &val);
+
+      return val;
+    }
+
     const data_t& dat = find_key(k);
 
     return dat.val_;
   }
 
+  // Looks up count keys at once: vals[i] is the value of keys[i], or
+  // EMPTY_VAL if it is not in the table. Both levels are hashed with the
+  // batch key functions, SIMD_GROUP_SIZE keys at a time.
+  void find_vals(const char* const* keys, const size_t* lengths, size_t count, uint64_t* vals) {
+    FoldedKeys folded;
+
+    for (size_t base = 0; base < count; base += SIMD_GROUP_SIZE) {
+      size_t n = std::min(SIMD_GROUP_SIZE, count - base);
+
+      if (fold_case_) {
+        // each block is folded into a buffer on the stack, then hashed
+        folded.fold(keys + base, lengths + base, n);
+        find_block(folded.keys(), lengths + base, n, vals + base);
+      } else {
+        find_block(keys + base, lengths + base, n, vals + base);
+      }
+    }
+  }
+
+  std::vector<uint64_t> find_vals(const std::vector<std::string>& keys) {
+    std::vector<const char*> ptrs(keys.size());
+    std::vector<size_t>      lengths(keys.size());
+    std::vector<uint64_t>    vals(keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      ptrs[i]    = keys[i].data();
+      lengths[i] = keys[i].size();
+    }
+
+    find_vals(ptrs.data(), lengths.data(), keys.size(), vals.data());
+
+    return vals;
+  }
+
   bool notfound_val(uint64_t v) {
     return (v == EMPTY_VAL);
   }
@@ -826,28 +1173,86 @@ public:
   }
 
   bool load(std::vector<std::string> keys, std::vector<uint64_t> values) {
+    std::vector<const char*> ptrs(keys.size());
+    std::vector<size_t>      lengths(keys.size());
+
+    for (uint64_t i = 0; i < keys.size(); i++) {
+      ptrs[i]    = keys[i].data();
+      lengths[i] = keys[i].size();
+    }
+
+    return load(ptrs.data(), lengths.data(), values.data(), keys.size());
+  }
+
+  // Loads count keys given as pointers and lengths (e.g. into the data
+  // buffer of an Arrow string array). The table keeps its own copy of
+  // each key, NUL terminated; keys must not contain NUL. With fold_case(),
+  // the copies are folded, and keys that differ only in case are duplicates.
+  bool load(const char* const* keys, const size_t* lengths, const uint64_t* values, uint64_t count) {
     bool status = true;
 
-    keys_.reserve(keys.size());
-    keys_.resize(keys.size());
+    keys_.reserve(count);
+    keys_.resize(count);
 
-    for (uint64_t i = 0; i < keys.size(); i++) {
-      keys_[i] = keys[i];
+    for (uint64_t i = 0; i < count; i++) {
+      keys_[i].assign(keys[i], lengths[i]);
+
+      if (fold_case_) {
+        fold_ascii(keys_[i]);
+      }
     }
 
-    for (uint64_t i = 0; i < keys.size(); i++) {
+    if (trace_ != nullptr) {
+      trace_build_t build;
+
+      build.n_          = n_;
+      build.s_          = s_;
+      build.p_          = p_;
+      build.seed_       = seed_;
+      build.multiplier_ = multiplier_;
+      build.adjustment_ = adjustment_;
+      build.uuid_       = uuid_;
+
+      trace_->begin(build);
+    }
+
+    for (uint64_t i = 0; i < count; i++) {
       status = insert(keys_[i].c_str(), values[i]);
 
       if (status == false) {
-        return false;
+        break;
       }
     }
 
-    return true;
+    if (trace_ != nullptr) {
+      trace_->end(status, D_.size(), func_.size());
+    }
+
+    return status;
+  }
+
+  // Makes keys case-insensitive for ASCII letters (CaseFold.h); set before load()
+  void set_fold_case(bool fold_case) {
+    fold_case_ = fold_case;
+  }
+
+  bool fold_case() const {
+    return fold_case_;
+  }
+
+  // Records the construction in trace (null to stop tracing); the trace
+  // must outlive the calls to load() and insert()
+  void set_trace(BuildTrace* trace) {
+    trace_ = trace;
   }
 
-  bool serialize(std::ostream& ostr) {
-    ostr << "pph version 1.0.0" << std::endl;
+  // Writes the table followed by the checksums of its sections (TableChecksum.h)
+  bool serialize(std::ostream& file) {
+    TableChecksum     checksum;
+    ChecksumStreambuf checksum_buf(file.rdbuf(), checksum);
+    std::ostream      ostr(&checksum_buf);
+
+    ostr << TABLE_VERSION << std::endl;
 
     ostr << std::endl;
 
@@ -877,9 +1282,16 @@ public:
 
     ostr << std::endl;
 
-    // Write H_ array size, n, p, s, multiplier, adjustment, timeout
+    // Write H_ array size, n, p, s, multiplier, adjustment, timeout, and
+    // the flags of tables that have any (older readers expect 7 fields)
 
-    ostr << H_.size() << " " << n_ << " " << p_  << " " << s_ << " " << multiplier_  << " " << adjustment_  << " " << timeout_ << std::endl;
+    ostr << H_.size() << " " << n_ << " " << p_  << " " << s_ << " " << multiplier_  << " " << adjustment_  << " " << timeout_;
+
+    if (flags() != 0) {
+      ostr << " " << flags();
+    }
+
+    ostr << std::endl;
 
     ostr << std::endl;
 
@@ -911,7 +1323,25 @@ public:
 
     ostr << std::endl;
 
-    return true;
+    ostr.flush();
+
+    // Write checksums and the digest of the build parameters
+
+    table_checksums_t sums = checksum.checksums();
+
+    sums.digest_ = digest();
+
+    TableChecksum::write_trailer(file, sums);
+
+    return file.good();
+  }
+
+  // Reads a serialized table from memory (a mapped file, a buffer)
+  bool unserialize(const char* data, size_t size) {
+    MemoryStreambuf buf(data, size);
+    std::istream    istr(&buf);
+
+    return unserialize(istr);
   }
 
   bool unserialize(std::istream& istr) {
@@ -934,59 +1364,66 @@ public:
     uint64_t     count   = 0;
     uint64_t     size    = 0;
     uint64_t     hidx    = 0;
+    uint64_t     flags   = 0;
     std::string::size_type sz;
+    TableChecksum checksum;
+
+    checksums_verified_ = false;
 
     // get header line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     line = trim(line);
 
-    if (line != "pph version 1.0.0") {
+    // only files older than the checksums may go without them
+    bool legacy = (line == TABLE_VERSION_LEGACY);
+
+    if (!legacy && (line != TABLE_VERSION)) {
       return false;
     }
 
     // empty line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     // Read UUID to identify the key function used
 
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     uuid_ = unescape_string(trim(line));
 
     // Known UUID converted to key function pointer
 
-    func_.key_ = uuid_to_keyfunc(uuid_);
+    func_.setup(uuid_to_keyfunc(uuid_));
 
     // Otherwise: custom key functions should be set by caller using
     //            the UUID read from the table file
 
     // empty line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     // get seed line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
-    seed_ = std::atoll(trim(line).c_str());
+    seed_ = std::strtoull(trim(line).c_str(), nullptr, 10);
 
     // empty line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     // get h_ array size line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
-    size = std::atoll(trim(line).c_str());
+    size = std::strtoull(trim(line).c_str(), nullptr, 10);
 
     func_.h_.resize(size, 0);
     func_.multiplier_.resize(size, 0);
     func_.adjustment_.resize(size, 0);
 
     // empty line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     // read h_ array
 
-    while ( std::getline(istr, line) ) {
+    while ( read_line(istr, line, checksum) ) {
       line = trim(line);
 
       if (line.empty())
@@ -998,10 +1435,10 @@ public:
         return false;
       }
 
-      idx = std::atoll(fields[0].c_str());
-      h   = std::atoll(fields[1].c_str());
-      m   = std::atoll(fields[2].c_str());
-      a   = std::atoll(fields[3].c_str());
+      idx = std::strtoull(fields[0].c_str(), nullptr, 10);
+      h   = std::strtoull(fields[1].c_str(), nullptr, 10);
+      m   = std::strtoull(fields[2].c_str(), nullptr, 10);
+      a   = std::strtoull(fields[3].c_str(), nullptr, 10);
 
       if (idx >= func_.h_.size()) {
         // size in hash function file is wrong
@@ -1014,37 +1451,45 @@ public:
     }
 
     // read H_ array size, n, p, s, multiplier, adjustment, timeout
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     line = trim(line);
 
     split(fields, line, " ");
 
-    // H_.size(), n, p, s, multiplier, adjustment, timeout
-    if (fields.size() != 7) {
+    // H_.size(), n, p, s, multiplier, adjustment, timeout[, flags]
+    if ((fields.size() != 7) && (fields.size() != 8)) {
       return false;
     }
 
-    size        = std::atoll(fields[0].c_str());
-    n_          = std::atoll(fields[1].c_str());
+    size        = std::strtoull(fields[0].c_str(), nullptr, 10);
+    n_          = std::strtoull(fields[1].c_str(), nullptr, 10);
     p_          = std::stod(fields[2], &sz);
-    s_          = std::atoll(fields[3].c_str());
-    multiplier_ = std::atoll(fields[4].c_str());
-    adjustment_ = std::atoll(fields[5].c_str());
-    timeout_    = std::atoll(fields[6].c_str());
+    s_          = std::strtoull(fields[3].c_str(), nullptr, 10);
+    multiplier_ = std::strtoull(fields[4].c_str(), nullptr, 10);
+    adjustment_ = std::strtoull(fields[5].c_str(), nullptr, 10);
+    timeout_    = std::strtoull(fields[6].c_str(), nullptr, 10);
+    flags       = (fields.size() > 7) ? std::strtoull(fields[7].c_str(), nullptr, 10) : 0;
+
+    if ((flags & ~TABLE_FLAGS_KNOWN) != 0) {
+      // written by a newer version
+      return false;
+    }
+
+    fold_case_  = ((flags & TABLE_FLAG_FOLD_CASE) != 0);
 
     H_.resize(size);
 
     keys_.resize(n_);
 
     // empty line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     // read H_ array
 
     count   = 0;
 
-    while ( std::getline(istr, line) ) {
+    while ( read_line(istr, line, checksum) ) {
       line = trim(line);
 
       if (line.empty())
@@ -1057,10 +1502,10 @@ public:
         return false;
       }
 
-      idx = std::atoll(fields[0].c_str());
-      p   = std::atoll(fields[1].c_str());
-      i   = std::atoll(fields[2].c_str());
-      r   = std::atoll(fields[3].c_str());
+      idx = std::strtoull(fields[0].c_str(), nullptr, 10);
+      p   = std::strtoull(fields[1].c_str(), nullptr, 10);
+      i   = std::strtoull(fields[2].c_str(), nullptr, 10);
+      r   = std::strtoull(fields[3].c_str(), nullptr, 10);
 
       if (idx >= H_.size()) {
         // size in hash function file is wrong
@@ -1077,18 +1522,18 @@ public:
     }
 
     // get D_ array size line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
-    size = std::atoll(trim(line).c_str());
+    size = std::strtoull(trim(line).c_str(), nullptr, 10);
 
     D_.resize(size);
 
     // empty line
-    std::getline(istr, line);
+    read_line(istr, line, checksum);
 
     // read D_ array
 
-    while ( std::getline(istr, line) ) {
+    while ( read_line(istr, line, checksum) ) {
       line = trim(line);
 
       if (line.empty())
@@ -1101,10 +1546,10 @@ public:
         return false;
       }
 
-      idx  = std::atoll(fields[0].c_str());
+      idx  = std::strtoull(fields[0].c_str(), nullptr, 10);
       key  = unescape_string(fields[1].c_str());
-      val  = std::atoll(fields[2].c_str());
-      hidx = std::atoll(fields[3].c_str());
+      val  = std::strtoull(fields[2].c_str(), nullptr, 10);
+      hidx = std::strtoull(fields[3].c_str(), nullptr, 10);
 
       if (idx >= D_.size()) {
         // size in hash function file is wrong
@@ -1121,6 +1566,11 @@ public:
       D_[idx] = dat;
     }
 
+    // a data section cut short
+    if (indices.size() < n_) {
+      return false;
+    }
+
     // Set D_ key values after memory allocations in keys_ are done
 
     for(uint64_t i = 0; i < indices.size(); i++) {
@@ -1129,9 +1579,59 @@ public:
       D_[indices[i]].key_ = keys_[i].c_str();
     }
 
+    // Checksums, which only files written before they were added may lack
+
+    if (!checksum.complete() || (istr.peek() != TABLE_CHECKSUMS_TAG[0])) {
+      return legacy;
+    }
+
+    table_checksums_t stored;
+
+    while (!stored.present_ && read_line(istr, line, checksum) && !trim(line).empty()) {
+      stored = checksum.stored();
+    }
+
+    if (!stored.present_) {
+      // a trailer cut short
+      return false;
+    }
+
+    table_checksums_t computed = checksum.checksums();
+
+    for (size_t i = 0; i < TABLE_SECTIONS; i++) {
+      if (computed.section_[i] != stored.section_[i]) {
+        return false;
+      }
+    }
+
+    if (stored.digest_ != digest()) {
+      return false;
+    }
+
+    checksums_verified_ = true;
+
+    // blank line after the trailer
+    read_line(istr, line, checksum);
+
     return true;
   }
 
+  // True if the last unserialize() read checksums and they matched; such
+  // a table need not be verified by looking up its keys again
+  bool checksums_verified() const {
+    return checksums_verified_;
+  }
+
+  // Flags of the parameters line of a serialized table
+  uint64_t flags() const {
+    return fold_case_ ? TABLE_FLAG_FOLD_CASE : 0;
+  }
+
+  // Digest of the build parameters (see build_digest)
+  uint64_t digest() const {
+    return build_digest(uuid_, seed_, n_, p_, s_, multiplier_, adjustment_, timeout_);
+  }
+
   std::string uuid() {
     return uuid_;
   }
@@ -1140,17 +1640,71 @@ public:
     uuid_ = uuid;
   }
 
+  // Freezes the table into shared memory under name (SharedTable.h);
+  // other processes use it with attach_shared()
+  bool publish_shared(const std::string& name) const;
+
   void set_keyfunc(keyfunc_t key) {
-    func_.key_ = key;
-    key_ = key;
+    func_.setup(key);
+    key_   = key;
+    batch_ = keyfunc_to_batchkeyfunc(key);
+  }
+
+  // Starts recording lookup statistics (a no-op when PPH_STATS is 0)
+  void enable_stats(bool enable = true) {
+#if PPH_STATS
+    if (!enable) {
+      stats_.reset();
+    } else if (!stats_) {
+      stats_ = LookupStats::create();
+    }
+#endif
+  }
+
+  bool stats_enabled() const {
+    return (stats_ != nullptr);
+  }
+
+  lookup_stats_t stats() const {
+    return stats_ ? stats_->snapshot() : lookup_stats_t();
+  }
+
+  void reset_stats() {
+    if (stats_) {
+      stats_->reset();
+    }
   }
 
 protected:
+  // std::getline that also adds the line to checksum
+  static bool read_line(std::istream& istr, std::string& line, TableChecksum& checksum) {
+    if (!std::getline(istr, line)) {
+      return false;
+    }
+
+    checksum.update_line(line);
+
+    return true;
+  }
+
   const data_t& find_key(const std::string& k) {
-    auto t_start = std::chrono::high_resolution_clock::now();
+#if PPH_STATS
+    if (stats_) {
+      uint64_t t_start = stats_clock();
+      hdr_t    hdr     = H_[h(k)];
+
+      const data_t& dat = find_key(k, hdr);
+
+      stats_->record(stats_clock() - t_start, (&dat != &empty_), hdr.r_);
+
+      return dat;
+    }
+#endif
 
-    hdr_t  hdr = H_[h(k)];
+    return find_key(k, H_[h(k)]);
+  }
 
+  const data_t& find_key(const std::string& k, const hdr_t& hdr) {
     if (hdr.r_ == 0) {
       // not found
       return empty_;
@@ -1162,14 +1716,71 @@ protected:
       return dat;
     }
 
-    auto t_end = std::chrono::high_resolution_clock::now();
-    double t_duration = std::chrono::duration<double, std::milli>(t_end-t_start).count();
-
     // not found
     return empty_;
   }
 
 private:
+  // find_vals() for a block of n <= SIMD_GROUP_SIZE keys
+  void find_block(const char* const* keys, const size_t* lengths, size_t n, uint64_t* vals) {
+    uint64_t multipliers[SIMD_GROUP_SIZE];
+    uint64_t hashes[SIMD_GROUP_SIZE];
+    hdr_t    hdrs[SIMD_GROUP_SIZE];
+
+#if PPH_STATS
+    uint64_t t_start = stats_ ? stats_clock() : 0;
+#endif
+
+    // first level: h(k)
+
+    std::fill(multipliers, multipliers + n, multiplier_);
+
+    if (batch_ != nullptr) {
+      batch_(keys, lengths, multipliers, n, hashes);
+    } else {
+      for (size_t i = 0; i < n; i++) {
+        hashes[i] = key_(std::string(keys[i], lengths[i]), multiplier_, 0);
+      }
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      hdrs[i] = H_[modulo(hashes[i] + adjustment_, s_)];
+      multipliers[i] = (hdrs[i].i_ < func_.size()) ? func_.multiplier(hdrs[i].i_) : 0;
+    }
+
+    // second level: h[i](k,r)
+
+    func_.hash_keys(keys, lengths, multipliers, n, hashes);
+
+    for (size_t i = 0; i < n; i++) {
+      const char* k   = keys[i];
+      size_t      len = lengths[i];
+
+      vals[i] = EMPTY_VAL;
+
+      if (hdrs[i].r_ == 0) {
+        continue;
+      }
+
+      const data_t& dat = D_[hdrs[i].p_ + func_.h_hash(hdrs[i].i_, hashes[i], hdrs[i].r_)];
+
+      if ((std::strlen(dat.key_) == len) && (std::memcmp(dat.key_, k, len) == 0)) {
+        vals[i] = dat.val_;
+      }
+    }
+
+#if PPH_STATS
+    // each key of the block is charged an equal share of its time
+    if (stats_) {
+      uint64_t t_key = (stats_clock() - t_start) / n;
+
+      for (size_t i = 0; i < n; i++) {
+        stats_->record(t_key, (vals[i] != EMPTY_VAL), hdrs[i].r_);
+      }
+    }
+#endif
+  }
+
   uint64_t n_;
   double   p_;
   uint64_t s_;
@@ -1181,6 +1792,9 @@ private:
   data_t      empty_;
   func_t      func_;
   keyfunc_t   key_;
+  batchkeyfunc_t batch_;
+  // null unless enable_stats() was called
+  std::shared_ptr<LookupStats> stats_;
   uint64_t    multiplier_;
   uint64_t    adjustment_;
   PrimeNumber prime_;
@@ -1188,8 +1802,37 @@ private:
   uint64_t    timeout_;
   XorShift1024Star random_;
   uint64_t    seed_;
+  // null unless set_trace() was called
+  BuildTrace* trace_;
+  // insert() being traced
+  trace_event_t event_;
+  // the last unserialize() read a file with checksums, and they matched
+  bool        checksums_verified_;
+  // keys are folded to lower case (set_fold_case())
+  bool        fold_case_;
 };
 
+// Read-only copy of a Table for concurrent lookups
+#include "FrozenTable.h"
+
+// Atomic hot swap of tables in long-running processes
+#include "TableHandle.h"
+
+// Synthetic key sets for testing and benchmarks
+#include "KeyGenerator.h"
+
+// Tables published in shared memory for other processes
+#include "SharedTable.h"
+
+// Self-contained C++ headers generated from tables
+#include "CppEmitter.h"
+
+// Splits text into tokens and looks them up in a table
+#include "Tokenizer.h"
+
+// Tables with 64-bit integer keys
+#include "IntTable.h"
+
 }  // namespace pph
 
 #endif  // _PPH_H
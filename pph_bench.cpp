@@ -0,0 +1,889 @@
+/*
+ * Copyright 2017 Rene Sugar. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file pph_bench.cpp
+ * @author Rene Sugar <rene.sugar@gmail.com>
+ * @brief Benchmarks for the key functions and hash tables
+ */
+
+#include <chrono>
+
+#include "pph.h"
+
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#endif
+
+// Directory of the example key files; PPH_BENCH_EXAMPLES overrides it
+#ifndef PPH_EXAMPLES_DIR
+#define PPH_EXAMPLES_DIR "examples"
+#endif
+
+// Hardware performance counters (Linux perf_event_open), read around the
+// timed loop of a benchmark when PPH_BENCH_PERF is set. Each counter is
+// opened on its own for the calling thread only (user space, so that the
+// default perf_event_paranoid of 2 allows it). Counters the CPU, the kernel
+// or a virtual machine does not provide are left out of the results; if
+// none can be opened, a warning is printed once and the benchmarks run
+// without them. Counts are scaled when the kernel multiplexes counters.
+
+typedef struct _perf_counter_info {
+  const char* name_;
+  uint32_t    type_;
+  uint64_t    config_;
+} perf_counter_info_t;
+
+#ifdef __linux__
+static constexpr uint64_t perf_cache_miss(uint64_t cache) {
+  return cache | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+}
+
+static const perf_counter_info_t PERF_COUNTERS[] = {
+  {"cycles",        PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {"instructions",  PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {"l1d_misses",    PERF_TYPE_HW_CACHE, perf_cache_miss(PERF_COUNT_HW_CACHE_L1D)},
+  {"llc_misses",    PERF_TYPE_HW_CACHE, perf_cache_miss(PERF_COUNT_HW_CACHE_LL)},
+  {"branch_misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {"dtlb_misses",   PERF_TYPE_HW_CACHE, perf_cache_miss(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+static constexpr size_t PERF_NUM_COUNTERS = sizeof(PERF_COUNTERS) / sizeof(PERF_COUNTERS[0]);
+#else
+static constexpr size_t PERF_NUM_COUNTERS = 0;
+#endif
+
+static bool bench_perf_enabled() {
+  const char* value = std::getenv("PPH_BENCH_PERF");
+  return (value != nullptr) && (value[0] != '\0') && (std::strcmp(value, "0") != 0);
+}
+
+class PerfCounters {
+public:
+  PerfCounters() : running_(false) {
+    for (size_t i = 0; i < PERF_NUM_COUNTERS; i++) {
+      fd_[i]    = -1;
+      count_[i] = 0;
+    }
+
+    if (bench_perf_enabled()) {
+      open();
+    }
+  }
+
+  ~PerfCounters() {
+#ifdef __linux__
+    for (size_t i = 0; i < PERF_NUM_COUNTERS; i++) {
+      if (fd_[i] >= 0) {
+        close(fd_[i]);
+      }
+    }
+#endif
+  }
+
+  PerfCounters(const PerfCounters&) = delete;
+  PerfCounters& operator=(const PerfCounters&) = delete;
+
+  void start() {
+#ifdef __linux__
+    for (size_t i = 0; i < PERF_NUM_COUNTERS; i++) {
+      if (fd_[i] >= 0) {
+        ioctl(fd_[i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd_[i], PERF_EVENT_IOC_ENABLE, 0);
+      }
+    }
+
+    running_ = true;
+#endif
+  }
+
+  void stop() {
+#ifdef __linux__
+    if (!running_) {
+      return;
+    }
+
+    for (size_t i = 0; i < PERF_NUM_COUNTERS; i++) {
+      if (fd_[i] < 0) {
+        continue;
+      }
+
+      ioctl(fd_[i], PERF_EVENT_IOC_DISABLE, 0);
+
+      // value, time enabled, time running
+      uint64_t data[3] = {0, 0, 0};
+
+      if ((read(fd_[i], data, sizeof(data)) == sizeof(data)) && (data[2] != 0)) {
+        count_[i] = static_cast<uint64_t>(data[0] * (static_cast<double>(data[1]) / data[2]));
+      } else {
+        count_[i] = 0;
+      }
+    }
+
+    running_ = false;
+#endif
+  }
+
+  // Adds <counter>_per_<unit> to the results, e.g. cycles_per_lookup
+  void report(benchmark::State& state, uint64_t items, const std::string& unit) {
+#ifdef __linux__
+    stop();
+
+    if (items == 0) {
+      return;
+    }
+
+    for (size_t i = 0; i < PERF_NUM_COUNTERS; i++) {
+      if (fd_[i] >= 0) {
+        state.counters[std::string(PERF_COUNTERS[i].name_) + "_per_" + unit] =
+          static_cast<double>(count_[i]) / items;
+      }
+    }
+#else
+    (void)state;
+    (void)items;
+    (void)unit;
+#endif
+  }
+
+private:
+  void open() {
+#ifdef __linux__
+    int    error  = 0;
+    size_t opened = 0;
+
+    for (size_t i = 0; i < PERF_NUM_COUNTERS; i++) {
+      struct perf_event_attr attr;
+
+      std::memset(&attr, 0, sizeof(attr));
+      attr.size           = sizeof(attr);
+      attr.type           = PERF_COUNTERS[i].type_;
+      attr.config         = PERF_COUNTERS[i].config_;
+      attr.disabled       = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv     = 1;
+      attr.read_format    = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+      fd_[i] = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+
+      if (fd_[i] >= 0) {
+        opened++;
+      } else {
+        error = errno;
+      }
+    }
+
+    if (opened == 0) {
+      warn(error);
+    }
+#endif
+  }
+
+  static void warn(int error) {
+    static bool warned = false;
+
+    if (!warned) {
+      warned = true;
+#ifdef __linux__
+      std::cerr << "PPH_BENCH_PERF: no performance counters available (" << std::strerror(error)
+                << "); check /proc/sys/kernel/perf_event_paranoid" << std::endl;
+#else
+      (void)error;
+#endif
+    }
+  }
+
+  bool     running_;
+  int      fd_[PERF_NUM_COUNTERS + 1];
+  uint64_t count_[PERF_NUM_COUNTERS + 1];
+};
+
+// Number of keys hashed per iteration; large enough that the keys do not
+// all fit in L1 for the longer lengths.
+static constexpr size_t BENCH_KEY_COUNT = 1024;
+
+static std::vector<std::string> random_keys(size_t count, size_t length, uint64_t seed) {
+  pph::XorShift1024Star random_gen(seed);
+  std::uniform_int_distribution<int> dist('!', '~');
+  std::vector<std::string> keys(count);
+
+  for (size_t i = 0; i < count; i++) {
+    keys[i].resize(length);
+
+    for (size_t j = 0; j < length; j++) {
+      keys[i][j] = static_cast<char>(dist(random_gen));
+    }
+  }
+
+  return keys;
+}
+
+// Key function throughput by key length
+
+template <pph::keyfunc_t F>
+static void BM_KeyFunction(benchmark::State& state) {
+  const size_t length = static_cast<size_t>(state.range(0));
+  std::vector<std::string> keys = random_keys(BENCH_KEY_COUNT, length, length);
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      benchmark::DoNotOptimize(F(keys[i], pph::HASH_MULTIPLIER, 0));
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+  state.SetBytesProcessed(state.iterations() * keys.size() * length);
+}
+
+// Scalar fallbacks of the accelerated key functions, for comparison
+
+static uint64_t crc32c_hash_scalar(const std::string& str, uint64_t /*multiplier*/, uint64_t adjustment) {
+  return static_cast<uint64_t>(~pph::crc32c_scalar(str.data(), str.size(), ~UINT32_C(0))) + adjustment;
+}
+
+static uint64_t crc64_clmul_scalar(const std::string& str, uint64_t /*multiplier*/, uint64_t adjustment) {
+  return ~pph::crc64_tables().update(~UINT64_C(0), str.data(), str.size()) + adjustment;
+}
+
+#define BENCHMARK_KEYFUNC(F) \
+  BENCHMARK_TEMPLATE(BM_KeyFunction, F)->RangeMultiplier(2)->Range(4, 1024)
+
+BENCHMARK_KEYFUNC(pph::crc64);
+BENCHMARK_KEYFUNC(pph::djb_hash);
+BENCHMARK_KEYFUNC(pph::fnv64a_hash);
+BENCHMARK_KEYFUNC(pph::oat_hash);
+BENCHMARK_KEYFUNC(pph::spookyV2_hash);
+BENCHMARK_KEYFUNC(pph::crc32c_hash);
+BENCHMARK_KEYFUNC(crc32c_hash_scalar);
+BENCHMARK_KEYFUNC(pph::crc64_clmul);
+BENCHMARK_KEYFUNC(crc64_clmul_scalar);
+BENCHMARK_KEYFUNC(pph::wy_hash);
+BENCHMARK_KEYFUNC(pph::wordmix_hash);
+
+// Batch key function throughput by key length; keys of mixed lengths
+// (length/2 .. length) so grouping by length matters
+
+static void batch_keys(size_t length, std::vector<std::string>& keys,
+                       std::vector<const char*>& ptrs, std::vector<size_t>& lengths) {
+  keys = random_keys(BENCH_KEY_COUNT, length, length);
+  ptrs.resize(keys.size());
+  lengths.resize(keys.size());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    keys[i].resize(length / 2 + (i % (length / 2 + 1)));
+    ptrs[i]    = keys[i].data();
+    lengths[i] = keys[i].size();
+  }
+}
+
+template <pph::batchkeyfunc_t F>
+static void BM_BatchKeyFunction(benchmark::State& state) {
+  std::vector<std::string> keys;
+  std::vector<const char*> ptrs;
+  std::vector<size_t>      lengths;
+
+  batch_keys(static_cast<size_t>(state.range(0)), keys, ptrs, lengths);
+
+  std::vector<uint64_t> multipliers(keys.size(), pph::HASH_MULTIPLIER);
+  std::vector<uint64_t> hashes(keys.size());
+
+  for (auto _ : state) {
+    F(ptrs.data(), lengths.data(), multipliers.data(), keys.size(), hashes.data());
+    benchmark::DoNotOptimize(hashes.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+// Scalar batch functions, for comparison with the SIMD kernels
+
+#define BENCHMARK_BATCH_KEYFUNC(F) \
+  BENCHMARK_TEMPLATE(BM_BatchKeyFunction, F)->RangeMultiplier(2)->Range(4, 1024)
+
+BENCHMARK_BATCH_KEYFUNC(pph::djb_hash_batch);
+BENCHMARK_BATCH_KEYFUNC(pph::bufkeyfunc_batch<pph::djb_hash_buf>);
+BENCHMARK_BATCH_KEYFUNC(pph::fnv64a_hash_batch);
+BENCHMARK_BATCH_KEYFUNC(pph::bufkeyfunc_batch<pph::fnv64a_hash_buf>);
+BENCHMARK_BATCH_KEYFUNC(pph::wordmix_hash_batch);
+BENCHMARK_BATCH_KEYFUNC(pph::bufkeyfunc_batch<pph::wordmix_hash_buf>);
+
+// Table lookups one key at a time and in batches
+
+static void lookup_table(pph::Table& table, std::vector<std::string>& keys, size_t count) {
+  keys = random_keys(count, 12, count);
+
+  std::vector<uint64_t> values(keys.size());
+  std::iota(values.begin(), values.end(), 0);
+
+  table.setup(keys.size(), false, pph::DEFAULT_LOADING_FACTOR);
+  table.load(keys, values);
+}
+
+static void BM_FindVal(benchmark::State& state) {
+  pph::Table table;
+  std::vector<std::string> keys;
+
+  lookup_table(table, keys, static_cast<size_t>(state.range(0)));
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < keys.size(); i++) {
+      benchmark::DoNotOptimize(table.find_val(keys[i]));
+    }
+  }
+
+  perf.report(state, state.iterations() * keys.size(), "lookup");
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+static void BM_FindVals(benchmark::State& state) {
+  pph::Table table;
+  std::vector<std::string> keys;
+
+  lookup_table(table, keys, static_cast<size_t>(state.range(0)));
+
+  std::vector<const char*> ptrs(keys.size());
+  std::vector<size_t>      lengths(keys.size());
+  std::vector<uint64_t>    vals(keys.size());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    ptrs[i]    = keys[i].data();
+    lengths[i] = keys[i].size();
+  }
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    table.find_vals(ptrs.data(), lengths.data(), keys.size(), vals.data());
+    benchmark::DoNotOptimize(vals.data());
+  }
+
+  perf.report(state, state.iterations() * keys.size(), "lookup");
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+BENCHMARK(BM_FindVal)->Arg(1000)->Arg(10000);
+BENCHMARK(BM_FindVals)->Arg(1000)->Arg(10000);
+
+// Build, lookup, serialize and unserialize on the example key files and
+// on synthetic key sets (KeyGenerator) of 10^3 to 10^7 keys. The argument
+// is the index in BENCH_DATASETS and the label is the name of the data set.
+//
+// Building is quadratic in the number of keys (find_r), so synthetic sets
+// larger than PPH_BENCH_MAX_KEYS (default 100000) are skipped.
+
+typedef struct _bench_dataset {
+  const char*      name_;
+  // key file in the examples directory, or nullptr for synthetic keys
+  const char*      file_;
+  pph::key_shape_t shape_;
+  size_t           count_;
+} bench_dataset_t;
+
+static const bench_dataset_t BENCH_DATASETS[] = {
+  {"SQLkeywords",          "SQLkeywords.txt",          pph::KEYS_ASCII,  0},
+  {"wordlist10000",        "wordlist10000.txt",        pph::KEYS_ASCII,  0},
+  {"wordlist10000_sorted", "wordlist10000_sorted.txt", pph::KEYS_ASCII,  0},
+  {"wordlist69903",        "wordlist69903.txt",        pph::KEYS_ASCII,  0},
+  {"skewed1e3",            nullptr,                    pph::KEYS_SKEWED, 1000},
+  {"skewed1e4",            nullptr,                    pph::KEYS_SKEWED, 10000},
+  {"skewed1e5",            nullptr,                    pph::KEYS_SKEWED, 100000},
+  {"skewed1e6",            nullptr,                    pph::KEYS_SKEWED, 1000000},
+  {"skewed1e7",            nullptr,                    pph::KEYS_SKEWED, 10000000},
+  {"url1e4",               nullptr,                    pph::KEYS_URL,    10000},
+  {"uuid1e4",              nullptr,                    pph::KEYS_UUID,   10000},
+  {"numeric1e4",           nullptr,                    pph::KEYS_NUMERIC, 10000},
+  {"path1e4",              nullptr,                    pph::KEYS_PATH,   10000},
+};
+
+static constexpr size_t BENCH_NUM_DATASETS = sizeof(BENCH_DATASETS) / sizeof(BENCH_DATASETS[0]);
+
+static size_t bench_max_keys() {
+  const char* value = std::getenv("PPH_BENCH_MAX_KEYS");
+  return (value != nullptr) ? static_cast<size_t>(std::atoll(value)) : 100000;
+}
+
+static std::string bench_examples_dir() {
+  const char* value = std::getenv("PPH_BENCH_EXAMPLES");
+  return (value != nullptr) ? std::string(value) : std::string(PPH_EXAMPLES_DIR);
+}
+
+// Keys are read the same way as by the pph command
+static std::vector<std::string> read_keys(const std::string& filename) {
+  std::vector<std::string> keys;
+  std::ifstream input_file(filename);
+  std::string line;
+
+  while (std::getline(input_file, line)) {
+    line = pph::trim(line);
+
+    if (line.empty())
+      break;
+
+    keys.push_back(line);
+  }
+
+  return keys;
+}
+
+class Dataset {
+public:
+  explicit Dataset(const bench_dataset_t& dataset) : built_(false), ok_(false) {
+    if (dataset.file_ != nullptr) {
+      keys_ = read_keys(bench_examples_dir() + "/" + dataset.file_);
+    } else {
+      keys_ = pph::generate_keys(dataset.shape_, dataset.count_, dataset.count_, 64);
+    }
+
+    // same lengths, different seed; almost all miss
+    misses_ = random_keys(std::min<size_t>(keys_.size(), BENCH_KEY_COUNT * 16), 16, keys_.size() + 1);
+
+    values_.resize(keys_.size());
+    std::iota(values_.begin(), values_.end(), 0);
+  }
+
+  void setup(pph::Table& table, pph::keyfunc_t key = pph::djb_hash) const {
+    table.setup(keys_.size(), false, pph::DEFAULT_LOADING_FACTOR, UINT64_C(3600000),
+                0, pph::HASH_MULTIPLIER, 0, key);
+  }
+
+  // Table built once and shared by the lookup and serialization benchmarks
+  pph::Table& table() {
+    if (!built_) {
+      setup(table_);
+      ok_    = table_.load(keys_, values_);
+      built_ = true;
+    }
+
+    return table_;
+  }
+
+  bool ok() const {
+    return ok_;
+  }
+
+  std::vector<std::string> keys_;
+  std::vector<std::string> misses_;
+  std::vector<uint64_t>    values_;
+
+private:
+  bool       built_;
+  bool       ok_;
+  pph::Table table_;
+};
+
+// Returns nullptr (and skips the benchmark) if the data set is unavailable
+static Dataset* dataset(benchmark::State& state) {
+  static std::map<size_t, std::unique_ptr<Dataset> > datasets;
+
+  size_t i = static_cast<size_t>(state.range(0));
+  const bench_dataset_t& info = BENCH_DATASETS[i];
+
+  state.SetLabel(info.name_);
+
+  if ((info.file_ == nullptr) && (info.count_ > bench_max_keys())) {
+    state.SkipWithError("more keys than PPH_BENCH_MAX_KEYS");
+    return nullptr;
+  }
+
+  if (datasets.find(i) == datasets.end()) {
+    datasets[i].reset(new Dataset(info));
+  }
+
+  Dataset* data = datasets[i].get();
+
+  if (data->keys_.empty()) {
+    state.SkipWithError("key file not found; set PPH_BENCH_EXAMPLES");
+    return nullptr;
+  }
+
+  return data;
+}
+
+// As dataset(), but also builds the table
+static Dataset* built_dataset(benchmark::State& state) {
+  Dataset* data = dataset(state);
+
+  if (data == nullptr) {
+    return nullptr;
+  }
+
+  data->table();
+
+  if (!data->ok()) {
+    state.SkipWithError("building the table failed");
+    return nullptr;
+  }
+
+  return data;
+}
+
+// bits_per_key is the size of the table frozen into one block, keys included
+static void BM_Build(benchmark::State& state) {
+  Dataset* data = dataset(state);
+
+  if (data == nullptr) {
+    return;
+  }
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    pph::Table table;
+
+    data->setup(table);
+
+    if (!table.load(data->keys_, data->values_)) {
+      state.SkipWithError("building the table failed");
+      break;
+    }
+  }
+
+  perf.report(state, state.iterations() * data->keys_.size(), "key");
+
+  if (state.error_occurred()) {
+    return;
+  }
+
+  const pph::FrozenTable frozen(data->table());
+
+  state.SetItemsProcessed(state.iterations() * data->keys_.size());
+  state.counters["bits_per_key"] = (frozen.bytes() * 8.0) / data->keys_.size();
+}
+
+static void BM_FindValHit(benchmark::State& state) {
+  Dataset* data = built_dataset(state);
+
+  if (data == nullptr) {
+    return;
+  }
+
+  pph::Table& table = data->table();
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < data->keys_.size(); i++) {
+      benchmark::DoNotOptimize(table.find_val(data->keys_[i]));
+    }
+  }
+
+  perf.report(state, state.iterations() * data->keys_.size(), "lookup");
+
+  state.SetItemsProcessed(state.iterations() * data->keys_.size());
+}
+
+static void BM_FindValMiss(benchmark::State& state) {
+  Dataset* data = built_dataset(state);
+
+  if (data == nullptr) {
+    return;
+  }
+
+  pph::Table& table = data->table();
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    for (size_t i = 0; i < data->misses_.size(); i++) {
+      benchmark::DoNotOptimize(table.find_val(data->misses_[i]));
+    }
+  }
+
+  perf.report(state, state.iterations() * data->misses_.size(), "lookup");
+
+  state.SetItemsProcessed(state.iterations() * data->misses_.size());
+}
+
+static void BM_Serialize(benchmark::State& state) {
+  Dataset* data = built_dataset(state);
+
+  if (data == nullptr) {
+    return;
+  }
+
+  pph::Table& table = data->table();
+  size_t bytes = 0;
+
+  for (auto _ : state) {
+    std::ostringstream ostr;
+
+    table.serialize(ostr);
+    bytes = ostr.str().size();
+  }
+
+  state.SetItemsProcessed(state.iterations() * data->keys_.size());
+  state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+static void BM_Unserialize(benchmark::State& state) {
+  Dataset* data = built_dataset(state);
+
+  if (data == nullptr) {
+    return;
+  }
+
+  std::ostringstream ostr;
+  data->table().serialize(ostr);
+  const std::string text = ostr.str();
+
+  for (auto _ : state) {
+    std::istringstream istr(text);
+    pph::Table table;
+
+    benchmark::DoNotOptimize(table.unserialize(istr));
+  }
+
+  state.SetItemsProcessed(state.iterations() * data->keys_.size());
+  state.SetBytesProcessed(state.iterations() * text.size());
+}
+
+static void bench_datasets(benchmark::internal::Benchmark* bench) {
+  for (size_t i = 0; i < BENCH_NUM_DATASETS; i++) {
+    bench->Arg(static_cast<int64_t>(i));
+  }
+}
+
+BENCHMARK(BM_Build)->Apply(bench_datasets)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_FindValHit)->Apply(bench_datasets);
+BENCHMARK(BM_FindValMiss)->Apply(bench_datasets);
+BENCHMARK(BM_Serialize)->Apply(bench_datasets)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_Unserialize)->Apply(bench_datasets)->Unit(benchmark::kMillisecond);
+
+// Build time by key function (wordlist10000)
+
+template <pph::keyfunc_t F>
+static void BM_BuildKeyFunction(benchmark::State& state) {
+  Dataset* data = dataset(state);
+
+  if (data == nullptr) {
+    return;
+  }
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    pph::Table table;
+
+    data->setup(table, F);
+
+    if (!table.load(data->keys_, data->values_)) {
+      state.SkipWithError("building the table failed");
+      break;
+    }
+  }
+
+  perf.report(state, state.iterations() * data->keys_.size(), "key");
+
+  state.SetItemsProcessed(state.iterations() * data->keys_.size());
+}
+
+#define BENCHMARK_BUILD_KEYFUNC(F) \
+  BENCHMARK_TEMPLATE(BM_BuildKeyFunction, F)->Arg(1)->Unit(benchmark::kMillisecond)
+
+BENCHMARK_BUILD_KEYFUNC(pph::crc64);
+BENCHMARK_BUILD_KEYFUNC(pph::djb_hash);
+BENCHMARK_BUILD_KEYFUNC(pph::fnv64a_hash);
+BENCHMARK_BUILD_KEYFUNC(pph::oat_hash);
+BENCHMARK_BUILD_KEYFUNC(pph::spookyV2_hash);
+BENCHMARK_BUILD_KEYFUNC(pph::crc32c_hash);
+BENCHMARK_BUILD_KEYFUNC(pph::crc64_clmul);
+BENCHMARK_BUILD_KEYFUNC(pph::wy_hash);
+BENCHMARK_BUILD_KEYFUNC(pph::wordmix_hash);
+
+// Concurrent lookups in one FrozenTable, from 1 thread up to one per core;
+// items_per_second should grow linearly with the number of threads
+
+class FrozenFixture {
+public:
+  FrozenFixture() {
+    lookup_table(table_, keys_, 10000);
+    frozen_ = pph::FrozenTable(table_);
+  }
+
+  pph::Table               table_;
+  std::vector<std::string> keys_;
+  pph::FrozenTable         frozen_;
+};
+
+static const FrozenFixture& frozen_fixture() {
+  static const FrozenFixture fixture;
+  return fixture;
+}
+
+static void BM_FrozenFindVal(benchmark::State& state) {
+  const FrozenFixture& fixture = frozen_fixture();
+  const std::vector<std::string>& keys = fixture.keys_;
+  size_t i = 0;
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(fixture.frozen_.find_val(keys[i]));
+
+    if (++i == keys.size()) {
+      i = 0;
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+static void BM_FrozenFindVals(benchmark::State& state) {
+  const FrozenFixture& fixture = frozen_fixture();
+  const std::vector<std::string>& keys = fixture.keys_;
+
+  std::vector<const char*> ptrs(keys.size());
+  std::vector<size_t>      lengths(keys.size());
+  std::vector<uint64_t>    vals(keys.size());
+
+  for (size_t i = 0; i < keys.size(); i++) {
+    ptrs[i]    = keys[i].data();
+    lengths[i] = keys[i].size();
+  }
+
+  for (auto _ : state) {
+    fixture.frozen_.find_vals(ptrs.data(), lengths.data(), keys.size(), vals.data());
+    benchmark::DoNotOptimize(vals.data());
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+static const int BENCH_MAX_THREADS = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+
+BENCHMARK(BM_FrozenFindVal)->ThreadRange(1, BENCH_MAX_THREADS)->UseRealTime();
+BENCHMARK(BM_FrozenFindVals)->ThreadRange(1, BENCH_MAX_THREADS)->UseRealTime();
+
+// Same lookups through a TableHandle, taking a ReadGuard for each lookup
+// while each thread republishes the table every 4096 lookups
+
+static void BM_HandleFindVal(benchmark::State& state) {
+  static pph::TableHandle handle(frozen_fixture().frozen_);
+
+  const std::vector<std::string>& keys = frozen_fixture().keys_;
+  size_t i = 0;
+
+  for (auto _ : state) {
+    {
+      pph::TableHandle::ReadGuard guard = handle.read();
+      benchmark::DoNotOptimize(guard->find_val(keys[i]));
+    }
+
+    if (++i == keys.size()) {
+      i = 0;
+    }
+
+    if ((i & 4095) == 0) {
+      handle.publish(frozen_fixture().frozen_);
+    }
+  }
+
+  state.SetItemsProcessed(state.iterations());
+}
+
+BENCHMARK(BM_HandleFindVal)->ThreadRange(1, BENCH_MAX_THREADS)->UseRealTime();
+
+// IntTable: sparse 64-bit ids, built and looked up without strings. The
+// argument is the number of keys; compare with BM_Build and BM_FindVals.
+
+static std::vector<uint64_t> int_keys(size_t count) {
+  pph::KeyGenerator     generator(pph::KEYS_NUMERIC, count, count);
+  std::vector<uint64_t> keys;
+  std::string           key;
+
+  keys.reserve(count);
+
+  while (generator.next(key)) {
+    keys.push_back(std::strtoull(key.c_str(), nullptr, 10));
+  }
+
+  return keys;
+}
+
+static void BM_IntTableBuild(benchmark::State& state) {
+  std::vector<uint64_t> keys = int_keys(static_cast<size_t>(state.range(0)));
+  std::vector<uint64_t> values(keys.size());
+
+  std::iota(values.begin(), values.end(), 0);
+
+  for (auto _ : state) {
+    pph::IntTable table;
+    benchmark::DoNotOptimize(table.load(keys, values));
+  }
+
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+static void BM_IntTableFindVals(benchmark::State& state) {
+  std::vector<uint64_t> keys = int_keys(static_cast<size_t>(state.range(0)));
+  std::vector<uint64_t> values(keys.size());
+  std::vector<uint64_t> vals(keys.size());
+  pph::IntTable         table;
+
+  std::iota(values.begin(), values.end(), 0);
+  table.load(keys, values);
+
+  PerfCounters perf;
+
+  perf.start();
+
+  for (auto _ : state) {
+    table.find_vals(keys.data(), keys.size(), vals.data());
+    benchmark::DoNotOptimize(vals.data());
+  }
+
+  perf.report(state, state.iterations() * keys.size(), "lookup");
+
+  state.counters["bytes_per_key"] = static_cast<double>(table.bytes()) / keys.size();
+  state.SetItemsProcessed(state.iterations() * keys.size());
+}
+
+BENCHMARK(BM_IntTableBuild)->Arg(10000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_IntTableFindVals)->Arg(10000)->Arg(1000000);
+
+BENCHMARK_MAIN();
@@ -0,0 +1,550 @@
+/*
+ * Copyright 2017 Rene Sugar. All rights reserved.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/*
+ * @file pph_compare.cpp
+ * @author Rene Sugar <rene.sugar@gmail.com>
+ * @brief Compares pph lookups with other static string maps
+ */
+
+#include "pph.h"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__GLIBC__) && ((__GLIBC__ > 2) || ((__GLIBC__ == 2) && (__GLIBC_MINOR__ >= 33)))
+#include <malloc.h>
+#define PPH_HEAP_BYTES 1
+#endif
+
+// Bytes allocated on the heap (including large blocks that were mmap'ed), or 0 if unknown
+static uint64_t heap_bytes() {
+#ifdef PPH_HEAP_BYTES
+  struct mallinfo2 info = mallinfo2();
+  return static_cast<uint64_t>(info.uordblks + info.hblkhd);
+#else
+  return 0;
+#endif
+}
+
+// Lookups in a static map; each returns pph::EMPTY_VAL for a missing key
+
+class Contender {
+public:
+  virtual ~Contender() {}
+
+  virtual std::string name() const = 0;
+
+  virtual void build(const std::vector<std::string>& keys, const std::vector<uint64_t>& values) = 0;
+
+  virtual uint64_t find(const std::string& key) = 0;
+};
+
+class PphContender : public Contender {
+public:
+  std::string name() const override {
+    return "pph::Table";
+  }
+
+  void build(const std::vector<std::string>& keys, const std::vector<uint64_t>& values) override {
+    table_.setup(keys.size(), false, pph::DEFAULT_LOADING_FACTOR, UINT64_C(3600000));
+
+    if (!table_.load(keys, values)) {
+      throw std::runtime_error("building the table failed");
+    }
+  }
+
+  uint64_t find(const std::string& key) override {
+    return table_.find_val(key);
+  }
+
+private:
+  pph::Table table_;
+};
+
+class FrozenContender : public Contender {
+public:
+  std::string name() const override {
+    return "pph::FrozenTable";
+  }
+
+  void build(const std::vector<std::string>& keys, const std::vector<uint64_t>& values) override {
+    pph::Table table;
+
+    table.setup(keys.size(), false, pph::DEFAULT_LOADING_FACTOR, UINT64_C(3600000));
+
+    if (!table.load(keys, values)) {
+      throw std::runtime_error("building the table failed");
+    }
+
+    frozen_ = pph::FrozenTable(table);
+  }
+
+  uint64_t find(const std::string& key) override {
+    return frozen_.find_val(key);
+  }
+
+private:
+  pph::FrozenTable frozen_;
+};
+
+class UnorderedMapContender : public Contender {
+public:
+  std::string name() const override {
+    return "std::unordered_map";
+  }
+
+  void build(const std::vector<std::string>& keys, const std::vector<uint64_t>& values) override {
+    map_.reserve(keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      map_.emplace(keys[i], values[i]);
+    }
+  }
+
+  uint64_t find(const std::string& key) override {
+    auto it = map_.find(key);
+    return (it != map_.end()) ? it->second : pph::EMPTY_VAL;
+  }
+
+private:
+  std::unordered_map<std::string, uint64_t> map_;
+};
+
+class SortedVectorContender : public Contender {
+public:
+  std::string name() const override {
+    return "sorted std::vector";
+  }
+
+  void build(const std::vector<std::string>& keys, const std::vector<uint64_t>& values) override {
+    entries_.reserve(keys.size());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      entries_.push_back(std::make_pair(keys[i], values[i]));
+    }
+
+    std::sort(entries_.begin(), entries_.end());
+  }
+
+  uint64_t find(const std::string& key) override {
+    auto it = std::lower_bound(entries_.begin(), entries_.end(), key,
+                               [](const std::pair<std::string, uint64_t>& entry, const std::string& k) {
+                                 return entry.first < k;
+                               });
+
+    return ((it != entries_.end()) && (it->first == key)) ? it->second : pph::EMPTY_VAL;
+  }
+
+private:
+  std::vector<std::pair<std::string, uint64_t> > entries_;
+};
+
+// What gperf generates: hash = length + asso_values of a few characters,
+// then a single length check and memcmp per candidate. gperf searches for
+// asso_values that make the hash perfect at code generation time; here a
+// few random assignments are tried and the one with the shortest longest
+// chain is kept, so large key sets get short chains instead of failing.
+class GperfStyleContender : public Contender {
+public:
+  std::string name() const override {
+    return "gperf-style";
+  }
+
+  void build(const std::vector<std::string>& keys, const std::vector<uint64_t>& values) override {
+    pph::XorShift1024Star random_gen(keys.size());
+    size_t best = SIZE_MAX;
+
+    size_ = 1;
+
+    while (size_ < 2 * keys.size()) {
+      size_ *= 2;
+    }
+
+    for (int attempt = 0; attempt < 16; attempt++) {
+      uint32_t asso[256];
+
+      for (int c = 0; c < 256; c++) {
+        asso[c] = static_cast<uint32_t>(random_gen() & (size_ - 1));
+      }
+
+      std::vector<uint32_t> chains(size_, 0);
+      size_t longest = 0;
+
+      for (const std::string& key : keys) {
+        longest = std::max<size_t>(longest, ++chains[hash(asso, key)]);
+      }
+
+      if (longest < best) {
+        best = longest;
+        std::copy(asso, asso + 256, asso_);
+      }
+    }
+
+    slots_.assign(size_, std::vector<size_t>());
+
+    for (size_t i = 0; i < keys.size(); i++) {
+      slots_[hash(asso_, keys[i])].push_back(entries_.size());
+      entries_.push_back(std::make_pair(keys[i], values[i]));
+    }
+  }
+
+  uint64_t find(const std::string& key) override {
+    for (size_t e : slots_[hash(asso_, key)]) {
+      const std::string& k = entries_[e].first;
+
+      if ((k.size() == key.size()) && (std::memcmp(k.data(), key.data(), key.size()) == 0)) {
+        return entries_[e].second;
+      }
+    }
+
+    return pph::EMPTY_VAL;
+  }
+
+private:
+  // gperf's default key positions: first, middle and last characters
+  size_t hash(const uint32_t* asso, const std::string& key) const {
+    size_t len = key.size();
+
+    if (len == 0) {
+      return 0;
+    }
+
+    return (len + asso[static_cast<uint8_t>(key[0])] +
+            asso[static_cast<uint8_t>(key[len / 2])] +
+            asso[static_cast<uint8_t>(key[len - 1])]) & (size_ - 1);
+  }
+
+  size_t   size_;
+  uint32_t asso_[256];
+  std::vector<std::vector<size_t> > slots_;
+  std::vector<std::pair<std::string, uint64_t> > entries_;
+};
+
+// Evicts the caches by writing a buffer larger than the last level cache
+class CacheEvictor {
+public:
+  explicit CacheEvictor(size_t bytes) : buffer_(bytes, 0), round_(0) {}
+
+  void evict() {
+    round_++;
+
+    for (size_t i = 0; i < buffer_.size(); i += 64) {
+      buffer_[i] = static_cast<char>(round_);
+    }
+  }
+
+private:
+  std::vector<char> buffer_;
+  uint64_t          round_;
+};
+
+typedef struct _compare_options {
+  size_t repeat_;
+  size_t batch_;
+  bool   cold_;
+  size_t evict_bytes_;
+} compare_options_t;
+
+typedef struct _compare_result {
+  std::string name_;
+  double      build_ms_;
+  double      lookups_per_second_;
+  double      misses_per_second_;
+  double      p50_ns_;
+  double      p99_ns_;
+  double      p999_ns_;
+  double      bytes_per_key_;
+  uint64_t    errors_;
+} compare_result_t;
+
+// Time of an empty measurement, subtracted from each lookup
+static uint64_t clock_overhead() {
+  uint64_t best = UINT64_MAX;
+
+  for (int i = 0; i < 1000; i++) {
+    uint64_t t_start = pph::stats_clock();
+    best = std::min(best, pph::stats_clock() - t_start);
+  }
+
+  return best;
+}
+
+// Lookups per second, best of options.repeat_ passes; counts wrong values in errors
+static double throughput(Contender& contender,
+                         const std::vector<std::string>& keys,
+                         const std::vector<uint64_t>& values,
+                         const std::vector<size_t>& order,
+                         const compare_options_t& options,
+                         CacheEvictor& evictor,
+                         uint64_t& errors) {
+  double best = 0;
+
+  for (size_t r = 0; r < options.repeat_; r++) {
+    uint64_t elapsed = 0;
+
+    errors = 0;
+
+    for (size_t base = 0; base < order.size(); base += options.batch_) {
+      size_t end = std::min(order.size(), base + options.batch_);
+
+      if (options.cold_) {
+        evictor.evict();
+      }
+
+      uint64_t t_batch = pph::stats_clock();
+
+      for (size_t i = base; i < end; i++) {
+        if (contender.find(keys[order[i]]) != values[order[i]]) {
+          errors++;
+        }
+      }
+
+      elapsed += pph::stats_clock() - t_batch;
+    }
+
+    best = std::max(best, order.size() / (std::max<uint64_t>(elapsed, 1) / 1e9));
+  }
+
+  return best;
+}
+
+static compare_result_t measure(Contender& contender,
+                                const std::vector<std::string>& keys,
+                                const std::vector<uint64_t>& values,
+                                const std::vector<std::string>& missing,
+                                const std::vector<size_t>& order,
+                                const compare_options_t& options,
+                                CacheEvictor& evictor) {
+  compare_result_t result;
+
+  result.name_   = contender.name();
+  result.errors_ = 0;
+
+  uint64_t heap_start = heap_bytes();
+  uint64_t t_start    = pph::stats_clock();
+
+  contender.build(keys, values);
+
+  result.build_ms_      = (pph::stats_clock() - t_start) / 1000000.0;
+  uint64_t heap_end     = heap_bytes();
+  result.bytes_per_key_ = (heap_end > heap_start) ? static_cast<double>(heap_end - heap_start) / keys.size() : 0;
+
+  // throughput of hits and of misses, without a clock read per lookup
+
+  std::vector<uint64_t> empty(missing.size(), pph::EMPTY_VAL);
+  uint64_t miss_errors = 0;
+
+  result.lookups_per_second_ = throughput(contender, keys, values, order, options, evictor, result.errors_);
+  result.misses_per_second_  = throughput(contender, missing, empty, order, options, evictor, miss_errors);
+  result.errors_ += miss_errors;
+
+  // latency: one clock pair per lookup, less the clock overhead
+
+  uint64_t overhead = clock_overhead();
+  std::shared_ptr<pph::LookupStats> stats = pph::LookupStats::create();
+
+  for (size_t base = 0; base < order.size(); base += options.batch_) {
+    size_t end = std::min(order.size(), base + options.batch_);
+
+    if (options.cold_) {
+      evictor.evict();
+    }
+
+    for (size_t i = base; i < end; i++) {
+      uint64_t t_lookup = pph::stats_clock();
+      uint64_t val      = contender.find(keys[order[i]]);
+      uint64_t ns       = pph::stats_clock() - t_lookup;
+
+      stats->record((ns > overhead) ? ns - overhead : 0, (val != pph::EMPTY_VAL), 0);
+    }
+  }
+
+  pph::lookup_stats_t snapshot = stats->snapshot();
+
+  result.p50_ns_  = snapshot.percentile(0.5);
+  result.p99_ns_  = snapshot.percentile(0.99);
+  result.p999_ns_ = snapshot.percentile(0.999);
+
+  return result;
+}
+
+static void print_results(const std::vector<compare_result_t>& results, size_t count,
+                          const compare_options_t& options) {
+  std::printf("%zu keys, %s caches, batches of %zu lookups\n", count,
+              options.cold_ ? "cold" : "warm", options.batch_);
+  std::printf("%-20s %10s %14s %14s %8s %8s %8s %12s\n", "structure", "build ms",
+              "hits/s", "misses/s", "p50 ns", "p99 ns", "p99.9 ns", "bytes/key");
+
+  for (const compare_result_t& r : results) {
+    std::printf("%-20s %10.2f %14.0f %14.0f %8.0f %8.0f %8.0f ", r.name_.c_str(), r.build_ms_,
+                r.lookups_per_second_, r.misses_per_second_, r.p50_ns_, r.p99_ns_, r.p999_ns_);
+
+#ifdef PPH_HEAP_BYTES
+    std::printf("%12.1f", r.bytes_per_key_);
+#else
+    std::printf("%12s", "n/a");
+#endif
+
+    if (r.errors_ != 0) {
+      std::printf("  (%llu wrong values)", static_cast<unsigned long long>(r.errors_));
+    }
+
+    std::printf("\n");
+  }
+
+  std::printf("\n");
+}
+
+// Keys are read the same way as by the pph command
+static std::vector<std::string> read_keys(const std::string& filename) {
+  std::vector<std::string> keys;
+  std::ifstream input_file(filename);
+  std::string line;
+
+  while (std::getline(input_file, line)) {
+    line = pph::trim(line);
+
+    if (line.empty())
+      break;
+
+    keys.push_back(line);
+  }
+
+  return keys;
+}
+
+static void compare(const std::vector<std::string>& keys, const compare_options_t& options) {
+  std::vector<uint64_t> values(keys.size());
+  std::iota(values.begin(), values.end(), 0);
+
+  // lookups in random order
+  std::vector<size_t> order(keys.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::shuffle(order.begin(), order.end(), pph::XorShift1024Star(keys.size()));
+
+  // keys read from files are trimmed, so none of them ends in a DEL character
+  std::vector<std::string> missing(keys);
+
+  for (std::string& key : missing) {
+    key += '\x7f';
+  }
+
+  CacheEvictor evictor(options.cold_ ? options.evict_bytes_ : 0);
+  std::vector<compare_result_t> results;
+
+  std::unique_ptr<Contender> contenders[] = {
+    std::unique_ptr<Contender>(new PphContender()),
+    std::unique_ptr<Contender>(new FrozenContender()),
+    std::unique_ptr<Contender>(new UnorderedMapContender()),
+    std::unique_ptr<Contender>(new SortedVectorContender()),
+    std::unique_ptr<Contender>(new GperfStyleContender()),
+  };
+
+  for (auto& contender : contenders) {
+    results.push_back(measure(*contender, keys, values, missing, order, options, evictor));
+    contender.reset();
+  }
+
+  print_results(results, keys.size(), options);
+}
+
+int main(int argc, const char** argv) {
+  namespace po = boost::program_options;
+
+  std::vector<std::string> input_files;
+  std::string              shape("skewed");
+  uint64_t                 count    = 0;
+  uint64_t                 seed     = 0;
+  size_t                   evict_mb = 64;
+  compare_options_t        options;
+
+  options.repeat_ = 5;
+  options.batch_  = 64;
+  options.cold_   = false;
+
+  po::options_description desc("Options");
+  desc.add_options()("help,h", "Print help messages");
+  desc.add_options()("input,i", po::value<std::vector<std::string>>(&input_files), "Path to key file(s); each is compared separately");
+  desc.add_options()("count,n", po::value<uint64_t>(&count), "Also compare a synthetic key set of this size");
+  desc.add_options()("shape", po::value<std::string>(&shape), "Shape of the synthetic keys (see pph gen)");
+  desc.add_options()("seed,S", po::value<uint64_t>(&seed), "Seed of the synthetic keys");
+  desc.add_options()("repeat,r", po::value<size_t>(&options.repeat_), "Throughput passes; the best is reported");
+  desc.add_options()("batch,b", po::value<size_t>(&options.batch_), "Lookups per batch");
+  desc.add_options()("cold", "Evict the caches before each batch");
+  desc.add_options()("evict-mb", po::value<size_t>(&evict_mb), "Size of the eviction buffer in MiB (larger than the last level cache)");
+
+  po::positional_options_description positionalOptions;
+  positionalOptions.add("input", -1);
+
+  po::variables_map vm;
+
+  try {
+    po::store(po::command_line_parser(argc, argv).options(desc).positional(positionalOptions).run(), vm);
+    po::notify(vm);
+
+    if (vm.count("help") || (input_files.empty() && (count == 0))) {
+      std::cout << "Usage: pph_compare <key file(s)> [--count <count> [--shape <shape>]] [--cold]" << std::endl;
+      std::cout << std::endl;
+      std::cout << desc << std::endl;
+      return 0;
+    }
+  } catch (boost::program_options::error& e) {
+    std::cerr << "Usage Error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  options.cold_        = (vm.count("cold") != 0);
+  options.evict_bytes_ = evict_mb << 20;
+  options.batch_       = std::max<size_t>(1, options.batch_);
+  options.repeat_      = std::max<size_t>(1, options.repeat_);
+
+  try {
+    for (const std::string& filename : input_files) {
+      std::vector<std::string> keys = read_keys(filename);
+
+      if (keys.empty()) {
+        std::cerr << "No keys in '" << filename << "'" << std::endl;
+        return 1;
+      }
+
+      std::printf("%s: ", filename.c_str());
+      compare(keys, options);
+    }
+
+    if (count != 0) {
+      std::printf("%s (synthetic): ", shape.c_str());
+      compare(pph::generate_keys(pph::key_shape(shape), count, seed, 64), options);
+    }
+  } catch (const std::exception& e) {
+    std::cerr << "Comparison error: " << e.what() << std::endl;
+    return 1;
+  }
+
+  return 0;
+}
@@ -28,6 +28,10 @@ PphKeyFunctions::PphKeyFunctions() {
   m_uuids.push_back("87333E59-7C1A-4613-9C6F-81F1BB1F6AED"); // "fnv64a_hash"
   m_uuids.push_back("3AC2A805-6771-4189-8C62-5F41297126FE"); // "oat_hash"
   m_uuids.push_back("A647F03D-A02E-477F-9635-420F3BCEB394"); // "spookyV2_hash"
+  m_uuids.push_back("B14FD9E5-C32E-4DAE-99B6-16F896FDD34E"); // "crc32c_hash"
+  m_uuids.push_back("FB2B126B-ABFD-488B-AA5B-103C32D34341"); // "crc64_clmul"
+  m_uuids.push_back("AFC54786-F95B-4560-834E-F75B07ED715B"); // "wy_hash"
+  m_uuids.push_back("B7F3DDEA-D10C-467E-A429-7933CE00119B"); // "wordmix_hash"
 }
 
 PphKeyFunctions::~PphKeyFunctions() {
@@ -48,6 +52,14 @@ std::string PphKeyFunctions::name(const std::string& uuid) {
     return "oat_hash";
   } else if (uuid == "A647F03D-A02E-477F-9635-420F3BCEB394") {
     return "spookyV2_hash";
+  } else if (uuid == "B14FD9E5-C32E-4DAE-99B6-16F896FDD34E") {
+    return "crc32c_hash";
+  } else if (uuid == "FB2B126B-ABFD-488B-AA5B-103C32D34341") {
+    return "crc64_clmul";
+  } else if (uuid == "AFC54786-F95B-4560-834E-F75B07ED715B") {
+    return "wy_hash";
+  } else if (uuid == "B7F3DDEA-D10C-467E-A429-7933CE00119B") {
+    return "wordmix_hash";
   }
 
   return "unknown";
@@ -57,6 +69,54 @@ uint64_t PphRandomNumber::next() {
   return dist(random_gen);
 }
 
+// Sets a flag for the life of a scope. It is created and destroyed with
+// the GIL held, so other Python threads see the flag set for as long as
+// the scope runs without the GIL.
+class ScopedFlag {
+public:
+  explicit ScopedFlag(bool& flag) : flag_(flag) {
+    flag_ = true;
+  }
+
+  ~ScopedFlag() {
+    flag_ = false;
+  }
+
+private:
+  bool& flag_;
+};
+
+// Counts a scope that runs without the GIL, like ScopedFlag
+class ScopedCount {
+public:
+  explicit ScopedCount(size_t& count) : count_(count) {
+    count_++;
+  }
+
+  ~ScopedCount() {
+    count_--;
+  }
+
+private:
+  size_t& count_;
+};
+
+// The buffer of obj, which must be C-contiguous: tables and text are read
+// as info.size * info.itemsize bytes from info.ptr
+static py::buffer_info request_contiguous(py::handle obj, const std::string& what) {
+  py::buffer_info info   = py::reinterpret_borrow<py::buffer>(obj).request();
+  ssize_t         stride = info.itemsize;
+
+  for (ssize_t d = info.ndim - 1; d >= 0; d--) {
+    if ((info.shape[d] > 1) && (info.strides[d] != stride)) {
+      throw py::value_error(what + ": the buffer is not C-contiguous");
+    }
+    stride *= info.shape[d];
+  }
+
+  return info;
+}
+
 PphHashTable::PphHashTable() {
   m_table              = new pph::Table();
   m_uuid               = "BCC54D42-34F0-43FF-88EB-59C7B47EE210"; // djb_hash
@@ -67,6 +127,8 @@ PphHashTable::PphHashTable() {
   m_multiplier         = pph::HASH_MULTIPLIER;
   m_adjustment         = 0;
   m_initialized        = false;
+  m_building           = false;
+  m_lookups            = 0;
 }
 
 PphHashTable::~PphHashTable() {
@@ -74,6 +136,17 @@ PphHashTable::~PphHashTable() {
 }
 
 std::vector<std::string> PphHashTable::getKeys() {
+  this->checkNotBuilding("PphHashTable.keys");
+  if (this->m_frozen) {
+    // keys of an attached table, in the order of their values
+    std::vector<std::string> keys(this->m_frozen->size());
+    this->m_frozen->for_each([&keys](const char* key, size_t len, uint64_t val) {
+      if (val < keys.size()) {
+        keys[val].assign(key, len);
+      }
+    });
+    return keys;
+  }
   // return list of keys (wrap std::vector in Python list)
   return this->m_keys;
 }
@@ -126,8 +199,44 @@ void PphHashTable::setAdjustment(uint64_t value) {
   this->m_adjustment = value;
 }
 
+bool PphHashTable::getFoldCase() {
+  if (this->m_frozen) {
+    return this->m_frozen->fold_case();
+  }
+  return this->m_table->fold_case();
+}
+
+void PphHashTable::setFoldCase(bool value) {
+  this->checkNotBuilding("PphHashTable.fold_case");
+  if (this->m_initialized == true) {
+    throw py::value_error("PphHashTable.fold_case: the table is already built");
+  }
+  this->m_table->set_fold_case(value);
+}
+
+void PphHashTable::checkNotBuilding(const char* what) {
+  if (this->m_building == true) {
+    throw py::value_error(std::string(what) + ": the table is being built");
+  }
+}
+
+void PphHashTable::checkNoLookups(const char* what) {
+  if (this->m_lookups != 0) {
+    throw py::value_error(std::string(what) + ": lookups are running without the GIL");
+  }
+}
+
+// Looks up in the attached table, if there is one
+uint64_t PphHashTable::findVal(const std::string& key) {
+  if (this->m_frozen) {
+    return this->m_frozen->find_val(key);
+  }
+  return this->m_table->find_val(key);
+}
+
 bool PphHashTable::contains(std::string& key) {
-  int val = this->m_table->find_val(key);
+  this->checkNotBuilding("PphHashTable.__contains__");
+  uint64_t val = this->findVal(key);
   if (this->m_table->notfound_val(val)) {
     return false;
   }
@@ -135,20 +244,26 @@ bool PphHashTable::contains(std::string& key) {
 }
 
 py::object PphHashTable::getitem(std::string& key) {
+  this->checkNotBuilding("PphHashTable.__getitem__");
   if (this->m_initialized == false) {
     throw pybind11::key_error();
   }
 
-  uint64_t val = this->m_table->find_val(key);
+  uint64_t val = this->findVal(key);
   if (this->m_table->notfound_val(val)) {
     // https://pybind11.readthedocs.io/en/stable/advanced/exceptions.html
     throw pybind11::key_error();
   }
+  if (this->m_values.empty()) {
+    // build() without values
+    return py::int_(val);
+  }
   return this->m_values[val];
 }
 
 void PphHashTable::setitem(std::string& key, py::object value) {
   py::gil_scoped_acquire gil;
+  this->checkNotBuilding("PphHashTable.__setitem__");
   if (this->m_initialized == true) {
     throw pybind11::value_error();
   }
@@ -163,18 +278,26 @@ void PphHashTable::delitem(std::string& key) {
 }
 
 bool PphHashTable::load(py::object pystream) {
+  this->checkNotBuilding("PphHashTable.load");
   if (this->m_initialized == true) {
     // Cannot reuse hash table to create a new one once it has been initialized.
     return false;
   }
-  this->m_initialized = true;
   if (!(py::hasattr(pystream, "readinto"))) {
       throw py::type_error("PphHashTable::load(pystream): incompatible function argument:  `pystream` must be a file-like object, but `"
                           + (std::string)(py::repr(pystream)) + "` provided");
   }
+  // reading the stream runs Python code, which lets other threads run
+  ScopedFlag building(this->m_building);
   py::detail::ipythonbuf buf(pystream);
   std::istream cpp_stream(&buf);
-  bool status = m_table->unserialize(cpp_stream);
+  return this->unserialize(cpp_stream);
+}
+
+// Reads a table; keys are listed in the order of their values
+bool PphHashTable::unserialize(std::istream& istr) {
+  this->m_initialized = true;
+  bool status = m_table->unserialize(istr);
   if (status == true) {
     uint64_t val = 0;
 
@@ -184,8 +307,8 @@ bool PphHashTable::load(py::object pystream) {
     this->m_index_values.reserve(m_table->keys().size());
     this->m_index_values.resize(m_table->keys().size());
 
-    this->m_values.reserve(m_table->keys().size());
-    this->m_values.resize(m_table->keys().size());
+    // Only index values are stored in the hash table; getitem() returns them
+    this->m_values.clear();
 
     for (uint64_t i = 0; i < m_table->keys().size(); i++) {
       val = m_table->find_val(m_table->keys()[i]);
@@ -195,18 +318,170 @@ bool PphHashTable::load(py::object pystream) {
       }
       m_keys.at(val) = m_table->keys()[i];
       m_index_values.at(val) = val;
-      // Only index values are stored in the hash table
-      m_values.at(val) = py::int_(val);
-    }    
+    }
+    this->m_uuid = m_table->uuid();
   }
   return status;
 }
 
+bool PphHashTable::unserialize(const char* data, size_t size) {
+  pph::MemoryStreambuf buf(data, size);
+  std::istream         istr(&buf);
+  return this->unserialize(istr);
+}
+
+std::unique_ptr<PphHashTable> PphHashTable::fromBuffer(py::buffer buffer) {
+  std::unique_ptr<PphHashTable> table(new PphHashTable());
+  py::buffer_info info = request_contiguous(buffer, "PphHashTable.from_buffer");
+  bool status;
+
+  {
+    // the buffer stays exported while it is parsed
+    py::gil_scoped_release release;
+    status = table->unserialize(static_cast<const char*>(info.ptr),
+                                static_cast<size_t>(info.size * info.itemsize));
+  }
+
+  if (status == false) {
+    throw py::value_error("PphHashTable.from_buffer: not a valid table");
+  }
+  return table;
+}
+
+std::unique_ptr<PphHashTable> PphHashTable::open(const std::string& path, bool map) {
+  std::unique_ptr<PphHashTable> table(new PphHashTable());
+  bool status = false;
+
+  {
+    py::gil_scoped_release release;
+
+    if (map == false) {
+      std::ifstream file(path, std::ios::in | std::ios::binary);
+
+      if (!file) {
+        py::gil_scoped_acquire gil;
+        throw py::value_error("PphHashTable.open: cannot open " + path);
+      }
+      status = table->unserialize(file);
+    } else {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      struct stat st;
+
+      if ((fd < 0) || (fstat(fd, &st) != 0)) {
+        if (fd >= 0) {
+          close(fd);
+        }
+        py::gil_scoped_acquire gil;
+        throw py::value_error("PphHashTable.open: cannot open " + path);
+      }
+
+      size_t size = static_cast<size_t>(st.st_size);
+      void*  addr = (size == 0) ? MAP_FAILED : mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+      close(fd);
+
+      if (addr != MAP_FAILED) {
+        madvise(addr, size, MADV_SEQUENTIAL);
+        status = table->unserialize(static_cast<const char*>(addr), size);
+        munmap(addr, size);
+      }
+    }
+  }
+
+  if (status == false) {
+    throw py::value_error("PphHashTable.open: " + path + " is not a valid table");
+  }
+  return table;
+}
+
+bool PphHashTable::publish(const std::string& name) {
+  this->checkNotBuilding("PphHashTable.publish");
+  if (this->m_initialized == false) {
+    throw py::value_error("PphHashTable.publish: the table has not been initialized");
+  }
+
+  py::gil_scoped_release release;
+
+  if (this->m_frozen) {
+    return pph::publish_shared(*this->m_frozen, name);
+  }
+  return this->m_table->publish_shared(name);
+}
+
+std::unique_ptr<PphHashTable> PphHashTable::attach(const std::string& name) {
+  std::unique_ptr<PphHashTable> table(new PphHashTable());
+  std::shared_ptr<pph::FrozenTable> frozen = std::make_shared<pph::FrozenTable>();
+
+  if (!pph::attach_shared(name, *frozen)) {
+    throw py::value_error("PphHashTable.attach: no table published as " + name);
+  }
+
+  table->m_initialized = true;
+  table->m_frozen      = frozen;
+  table->m_shared_name = name;
+  table->m_uuid        = frozen->uuid();
+  return table;
+}
+
+bool PphHashTable::unlink(const std::string& name) {
+  return pph::unlink_shared(name);
+}
+
+py::tuple PphHashTable::getstate() {
+  this->checkNotBuilding("PphHashTable.__getstate__");
+  if (this->m_initialized == false) {
+    throw py::value_error("PphHashTable: cannot pickle a table that has not been initialized");
+  }
+
+  std::ostringstream stream;
+  py::object         values = py::none();
+  py::object         table;
+
+  if (this->m_frozen) {
+    // attached tables are pickled by name and attached again
+    table = py::str(this->m_shared_name);
+  } else {
+    this->m_table->serialize(stream);
+    table = py::bytes(stream.str());
+  }
+
+  if (!this->m_values.empty()) {
+    py::list list;
+    for (const py::object& value : this->m_values) {
+      list.append(value);
+    }
+    values = list;
+  }
+
+  return py::make_tuple(table, values);
+}
+
+std::unique_ptr<PphHashTable> PphHashTable::setstate(py::tuple state) {
+  if (state.size() != 2) {
+    throw py::value_error("PphHashTable: invalid pickle state");
+  }
+
+  std::unique_ptr<PphHashTable> table = PyUnicode_Check(state[0].ptr()) ?
+                                        attach(state[0].cast<std::string>()) :
+                                        fromBuffer(state[0].cast<py::buffer>());
+
+  if (!state[1].is_none()) {
+    for (py::handle value : state[1]) {
+      table->m_values.push_back(py::reinterpret_borrow<py::object>(value));
+    }
+  }
+  return table;
+}
+
 bool PphHashTable::save(py::object pystream) {
+  this->checkNotBuilding("PphHashTable.save");
   if (this->m_initialized == false) {
     // Cannot save hash table that has not been initialized.
     return false;
   }
+  if (this->m_frozen) {
+    throw py::value_error("PphHashTable.save: an attached table cannot be saved; publish it instead");
+  }
   if (!(py::hasattr(pystream, "write") && py::hasattr(pystream, "flush"))) {
       throw py::type_error("PphHashTable::load(pystream): incompatible function argument:  `pystream` must be a file-like object, but `"
                           + (std::string)(py::repr(pystream)) + "` provided");
@@ -221,28 +496,801 @@ bool PphHashTable::save(py::object pystream) {
 
 // Call initialize() before calling getitem()
 bool PphHashTable::initialize() {
-  py::gil_scoped_acquire gil;
+  this->checkNotBuilding("PphHashTable.initialize");
   if (this->m_initialized == true) {
     // Cannot reuse hash table to create a new one once it has been initialized.
     return false;
   }
-  this->m_initialized = true;
+  ScopedFlag building(this->m_building);
+  return this->construct();
+}
+
+// Builds the table from m_keys; values are their indexes. The caller sets
+// m_building, so m_keys does not change while the GIL is released.
+bool PphHashTable::construct() {
   pph::keyfunc_t keyfunc = pph::uuid_to_keyfunc(this->m_uuid);
-  this->m_table->setup(m_keys.size(),
-                      this->m_use_loading_factor,
-                      this->m_loading_factor,
-                      this->m_timeout,
-                      this->m_seed,
-                      this->m_multiplier,
-                      this->m_adjustment,
-                      keyfunc);
-  this->m_table->set_uuid(this->m_uuid);
   this->m_index_values.reserve(m_keys.size());
   this->m_index_values.resize(m_keys.size());
   std::iota(std::begin(this->m_index_values), std::end(this->m_index_values), 0);
-  return this->m_table->load(this->m_keys, this->m_index_values);
+
+  // The table is built aside and put in place with the GIL held
+  std::unique_ptr<pph::Table> table(new pph::Table());
+  bool status;
+
+  table->set_fold_case(this->m_table->fold_case());
+  table->enable_stats(this->m_table->stats_enabled());
+
+  {
+    // Other Python threads run while the table is built
+    py::gil_scoped_release release;
+    table->setup(m_keys.size(),
+                 this->m_use_loading_factor,
+                 this->m_loading_factor,
+                 this->m_timeout,
+                 this->m_seed,
+                 this->m_multiplier,
+                 this->m_adjustment,
+                 keyfunc);
+    table->set_uuid(this->m_uuid);
+    status = table->load(this->m_keys, this->m_index_values);
+  }
+
+  if (status == true) {
+    delete this->m_table;
+    this->m_table       = table.release();
+    this->m_initialized = true;
+  }
+  return status;
+}
+
+void PphHashTable::enableStats(bool enable) {
+  this->checkNotBuilding("PphHashTable.enable_stats");
+  this->checkNoLookups("PphHashTable.enable_stats");
+  this->m_table->enable_stats(enable);
+}
+
+void PphHashTable::resetStats() {
+  this->checkNotBuilding("PphHashTable.reset_stats");
+  this->checkNoLookups("PphHashTable.reset_stats");
+  this->m_table->reset_stats();
+}
+
+py::dict PphHashTable::stats() {
+  this->checkNotBuilding("PphHashTable.stats");
+  pph::lookup_stats_t stats = this->m_table->stats();
+  py::dict result;
+  py::dict latency;
+  py::dict group_size;
+
+  // latency histogram: lower bound of bucket (ns) -> lookups
+  for (size_t b = 0; b < stats.latency_.size(); b++) {
+    if (stats.latency_[b] != 0) {
+      latency[py::int_(pph::latency_bucket_min(b))] = stats.latency_[b];
+    }
+  }
+
+  for (size_t r = 0; r < stats.group_size_.size(); r++) {
+    if (stats.group_size_[r] != 0) {
+      group_size[py::int_(r)] = stats.group_size_[r];
+    }
+  }
+
+  result["enabled"]         = this->m_table->stats_enabled();
+  result["lookups"]         = stats.lookups_;
+  result["hits"]            = stats.hits_;
+  result["misses"]          = stats.misses_;
+  result["hit_ratio"]       = stats.hit_ratio();
+  result["latency_mean_ns"] = stats.mean();
+  result["latency_p50_ns"]  = stats.percentile(0.5);
+  result["latency_p90_ns"]  = stats.percentile(0.9);
+  result["latency_p99_ns"]  = stats.percentile(0.99);
+  result["latency_max_ns"]  = stats.percentile(1.0);
+  result["latency_ns"]      = latency;
+  result["group_size"]      = group_size;
+
+  return result;
+}
+
+bool PphHashTable::checksumsVerified() {
+  return this->m_table->checksums_verified();
+}
+
+
+// Appends code point c as UTF-8
+static void append_utf8(std::string& out, uint32_t c) {
+  if (c < 0x80) {
+    out += static_cast<char>(c);
+  } else if (c < 0x800) {
+    out += static_cast<char>(0xC0 | (c >> 6));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else if (c < 0x10000) {
+    out += static_cast<char>(0xE0 | (c >> 12));
+    out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  } else {
+    out += static_cast<char>(0xF0 | (c >> 18));
+    out += static_cast<char>(0x80 | ((c >> 12) & 0x3F));
+    out += static_cast<char>(0x80 | ((c >> 6) & 0x3F));
+    out += static_cast<char>(0x80 | (c & 0x3F));
+  }
+}
+
+// NumPy dtype kind of an array ('S': bytes, 'U': unicode, ...)
+static std::string array_kind(py::handle arr) {
+  return py::str(arr.attr("dtype").attr("kind"));
+}
+
+// Keys passed from Python as pointers and lengths. The keys stay valid as
+// long as the key_refs_t, so they can be read without the GIL.
+typedef struct _key_refs {
+  std::vector<const char*> ptrs_;
+  std::vector<size_t>      lengths_;
+  // UTF-8 of NumPy unicode keys
+  std::string              utf8_;
+  // arrays and items the keys point into
+  py::list                 items_;
+  std::vector<ssize_t>     shape_;
+
+  size_t size() const {
+    return ptrs_.size();
+  }
+
+  void clear() {
+    ptrs_.clear();
+    lengths_.clear();
+    utf8_.clear();
+    items_ = py::list();
+    shape_.clear();
+  }
+} key_refs_t;
+
+// True for keys that collect_keys() reads without iterating over them
+static bool is_key_array(py::handle keys, py::handle offsets) {
+  return !offsets.is_none() ||
+         (py::isinstance<py::array>(keys) && ((array_kind(keys) == "S") || (array_kind(keys) == "U")));
+}
+
+// Keys of a NumPy 'S' or 'U' array, or of a bytes-like buffer holding key
+// i at data[offsets[i]:offsets[i + 1]]
+static void collect_keys(py::object keys, py::object offsets, key_refs_t& refs) {
+  if (!offsets.is_none()) {
+    py::buffer_info data = request_contiguous(keys, "keys");
+    py::array_t<int64_t, py::array::c_style | py::array::forcecast> offs(offsets);
+
+    if ((offs.ndim() != 1) || (offs.size() < 1)) {
+      throw py::value_error("offsets must have one more entry than there are keys");
+    }
+
+    const char*    base  = static_cast<const char*>(data.ptr);
+    const int64_t* off   = offs.data();
+    int64_t        bytes = static_cast<int64_t>(data.size * data.itemsize);
+    size_t         n     = static_cast<size_t>(offs.size() - 1);
+
+    refs.items_.append(keys);
+    refs.ptrs_.resize(n);
+    refs.lengths_.resize(n);
+
+    for (size_t i = 0; i < n; i++) {
+      if ((off[i] < 0) || (off[i] > off[i + 1]) || (off[i + 1] > bytes)) {
+        throw py::value_error("offsets out of order or outside the data");
+      }
+
+      refs.ptrs_[i]    = base + off[i];
+      refs.lengths_[i] = static_cast<size_t>(off[i + 1] - off[i]);
+    }
+
+    refs.shape_.push_back(static_cast<ssize_t>(n));
+    return;
+  }
+
+  py::array arr = py::array::ensure(keys, py::array::c_style);
+  // the buffer protocol gives the item size with any NumPy version
+  py::buffer_info info = arr.request();
+  size_t          n    = static_cast<size_t>(info.size);
+  size_t          w    = static_cast<size_t>(info.itemsize);
+  const char*     base = static_cast<const char*>(info.ptr);
+
+  refs.items_.append(arr);
+  refs.ptrs_.resize(n);
+  refs.lengths_.resize(n);
+
+  if (array_kind(arr) == "S") {
+    // fixed width, padded with NULs
+    for (size_t i = 0; i < n; i++) {
+      const char* item = base + (i * w);
+      refs.ptrs_[i]    = item;
+      refs.lengths_[i] = strnlen(item, w);
+    }
+  } else {
+    // fixed width UCS-4, padded with NULs
+    std::vector<size_t> utf8_offsets(n + 1, 0);
+
+    for (size_t i = 0; i < n; i++) {
+      const char* item = base + (i * w);
+
+      for (size_t j = 0; j < w / 4; j++) {
+        uint32_t c;
+        std::memcpy(&c, item + (j * 4), sizeof(c));
+
+        if (c == 0) {
+          break;
+        }
+
+        append_utf8(refs.utf8_, c);
+      }
+
+      utf8_offsets[i + 1] = refs.utf8_.size();
+    }
+
+    for (size_t i = 0; i < n; i++) {
+      refs.ptrs_[i]    = refs.utf8_.data() + utf8_offsets[i];
+      refs.lengths_[i] = utf8_offsets[i + 1] - utf8_offsets[i];
+    }
+  }
+
+  refs.shape_ = info.shape;
+}
+
+// Adds up to limit str or bytes keys from an iterator; false at its end
+static bool collect_keys(py::iterator& it, size_t limit, key_refs_t& refs) {
+  for (size_t i = 0; i < limit; i++, ++it) {
+    if (it == py::iterator::sentinel()) {
+      return false;
+    }
+
+    py::handle  item = *it;
+    const char* data = nullptr;
+    ssize_t     size = 0;
+
+    if (PyUnicode_Check(item.ptr())) {
+      data = PyUnicode_AsUTF8AndSize(item.ptr(), &size);
+
+      if (data == nullptr) {
+        throw py::error_already_set();
+      }
+    } else if (PyBytes_Check(item.ptr())) {
+      char* bytes = nullptr;
+      PyBytes_AsStringAndSize(item.ptr(), &bytes, &size);
+      data = bytes;
+    } else {
+      throw py::type_error("keys must be str or bytes, not " +
+                           std::string(py::str(item.get_type().attr("__name__"))));
+    }
+
+    refs.items_.append(item);
+    refs.ptrs_.push_back(data);
+    refs.lengths_.push_back(static_cast<size_t>(size));
+  }
+
+  return (it != py::iterator::sentinel());
 }
 
+bool PphHashTable::build(py::object keys, py::object values, py::object offsets, size_t chunk_size) {
+  this->checkNotBuilding("build");
+  if (this->m_initialized == true) {
+    // Cannot reuse hash table to create a new one once it has been initialized.
+    return false;
+  }
+  if (!this->m_keys.empty()) {
+    throw py::value_error("build: keys were already added with __setitem__; call initialize()");
+  }
+  if (chunk_size == 0) {
+    throw py::value_error("build: chunk_size must be positive");
+  }
+
+  // iterating over keys runs Python code, which lets other threads run
+  ScopedFlag building(this->m_building);
+
+  // keys and values are collected aside, so that a failed build can be
+  // retried
+  std::vector<std::string> key_list;
+  std::vector<py::object>  value_list;
+  key_refs_t               refs;
+
+  if (is_key_array(keys, offsets)) {
+    collect_keys(keys, offsets, refs);
+    key_list.reserve(refs.size());
+
+    for (size_t i = 0; i < refs.size(); i++) {
+      key_list.emplace_back(refs.ptrs_[i], refs.lengths_[i]);
+    }
+  } else {
+    // Copy chunk_size keys at a time so that the Python objects of only
+    // one chunk are referenced at once
+    py::iterator it = py::iter(keys);
+    bool         more = true;
+
+    if (py::hasattr(keys, "__len__")) {
+      key_list.reserve(py::len(keys));
+    }
+
+    while (more) {
+      more = collect_keys(it, chunk_size, refs);
+
+      for (size_t i = 0; i < refs.size(); i++) {
+        key_list.emplace_back(refs.ptrs_[i], refs.lengths_[i]);
+      }
+
+      refs.clear();
+    }
+  }
+
+  refs.clear();
+
+  if (!values.is_none()) {
+    for (py::handle value : values) {
+      value_list.push_back(py::reinterpret_borrow<py::object>(value));
+    }
+
+    if (value_list.size() != key_list.size()) {
+      throw py::value_error("build: " + std::to_string(value_list.size()) + " values for " +
+                            std::to_string(key_list.size()) + " keys");
+    }
+  }
+
+  this->m_keys   = std::move(key_list);
+  this->m_values = std::move(value_list);
+
+  bool status = false;
+
+  try {
+    status = this->construct();
+  } catch (...) {
+    this->m_keys.clear();
+    this->m_values.clear();
+    throw;
+  }
+
+  if (status == false) {
+    this->m_keys.clear();
+    this->m_values.clear();
+  }
+
+  return status;
+}
+
+py::array_t<uint64_t> PphHashTable::lookupMany(py::object keys, py::object offsets, uint64_t miss, size_t threads) {
+  this->checkNotBuilding("lookup_many");
+  if (this->m_initialized == false) {
+    throw py::value_error("lookup_many: the table has not been initialized");
+  }
+
+  key_refs_t refs;
+
+  if (is_key_array(keys, offsets)) {
+    collect_keys(keys, offsets, refs);
+  } else {
+    py::iterator it = py::iter(keys);
+    collect_keys(it, SIZE_MAX, refs);
+    refs.shape_.push_back(static_cast<ssize_t>(refs.size()));
+  }
+
+  const std::vector<const char*>& ptrs    = refs.ptrs_;
+  const std::vector<size_t>&      lengths = refs.lengths_;
+  const std::vector<ssize_t>&     shape   = refs.shape_;
+
+  py::array_t<uint64_t> result(shape);
+  uint64_t*             vals  = result.mutable_data();
+  size_t                count = ptrs.size();
+
+  {
+    // the lookups read the table's statistics
+    ScopedCount lookups(this->m_lookups);
+    py::gil_scoped_release release;
+
+    if (threads == 0) {
+      threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // no more threads than blocks of SIMD_GROUP_SIZE keys
+    threads = std::max<size_t>(1, std::min(threads, count / pph::SIMD_GROUP_SIZE));
+
+    size_t range = (count + threads - 1) / threads;
+    std::vector<std::thread> workers;
+
+    auto lookup_range = [&](size_t t) {
+      size_t first = std::min(count, t * range);
+      size_t last  = std::min(count, first + range);
+
+      if (this->m_frozen) {
+        this->m_frozen->find_vals(ptrs.data() + first, lengths.data() + first, last - first, vals + first);
+      } else {
+        this->m_table->find_vals(ptrs.data() + first, lengths.data() + first, last - first, vals + first);
+      }
+
+      for (size_t i = first; i < last; i++) {
+        if (this->m_table->notfound_val(vals[i])) {
+          vals[i] = miss;
+        }
+      }
+    };
+
+    for (size_t t = 1; t < threads; t++) {
+      workers.push_back(std::thread(lookup_range, t));
+    }
+
+    lookup_range(0);
+
+    for (auto& worker : workers) {
+      worker.join();
+    }
+  }
+
+  return result;
+}
+
+py::array_t<uint64_t> PphHashTable::tokenize(py::object text, py::object token_chars, uint64_t miss) {
+  this->checkNotBuilding("tokenize");
+  if (this->m_initialized == false) {
+    throw py::value_error("tokenize: the table has not been initialized");
+  }
+
+  pph::CharClass chars;
+
+  try {
+    chars = token_chars.is_none() ? pph::CharClass::identifier() :
+                                    pph::CharClass::parse(token_chars.cast<std::string>());
+  } catch (const std::invalid_argument& e) {
+    throw py::value_error(std::string("tokenize: ") + e.what());
+  }
+
+  std::string     encoded;
+  py::buffer_info info;
+  const char*     data;
+  size_t          size;
+
+  if (PyUnicode_Check(text.ptr())) {
+    encoded = text.cast<std::string>();
+    data    = encoded.data();
+    size    = encoded.size();
+  } else {
+    info = request_contiguous(text, "tokenize");
+    data = static_cast<const char*>(info.ptr);
+    size = static_cast<size_t>(info.size * info.itemsize);
+  }
+
+  std::vector<pph::token_t> tokens;
+
+  {
+    ScopedCount lookups(this->m_lookups);
+    py::gil_scoped_release release;
+    pph::Tokenizer tokenizer(chars);
+
+    if (this->m_frozen) {
+      tokens = tokenizer.scan(*this->m_frozen, data, size);
+    } else {
+      tokens = tokenizer.scan(*this->m_table, data, size);
+    }
+  }
+
+  py::array_t<uint64_t> result(std::vector<ssize_t>{static_cast<ssize_t>(tokens.size()), 3});
+  uint64_t*             out = result.mutable_data();
+
+  for (const pph::token_t& token : tokens) {
+    *out++ = token.offset_;
+    *out++ = token.length_;
+    *out++ = this->m_table->notfound_val(token.val_) ? miss : token.val_;
+  }
+
+  return result;
+}
+
+// One value per key for IntTable and FingerprintTable: values, or the
+// position of each key if values is None
+static std::vector<uint64_t> int_table_values(py::object values, size_t count) {
+  std::vector<uint64_t> result;
+
+  if (values.is_none()) {
+    result.resize(count);
+    std::iota(result.begin(), result.end(), 0);
+    return result;
+  }
+
+  py::array_t<uint64_t, py::array::c_style | py::array::forcecast> value_array(values);
+
+  if (static_cast<size_t>(value_array.size()) != count) {
+    throw py::value_error("build: " + std::to_string(value_array.size()) + " values for " +
+                          std::to_string(count) + " keys");
+  }
+
+  result.assign(value_array.data(), value_array.data() + count);
+  return result;
+}
+
+static py::array_t<uint64_t> collision_array(const std::vector<pph::int_collision_t>& collisions) {
+  py::array_t<uint64_t> result(std::vector<ssize_t>{static_cast<ssize_t>(collisions.size()), 2});
+  uint64_t*             out = result.mutable_data();
+
+  for (const pph::int_collision_t& collision : collisions) {
+    *out++ = collision.first_;
+    *out++ = collision.second_;
+  }
+
+  return result;
+}
+
+typedef py::array_t<uint64_t, py::array::c_style | py::array::forcecast> uint64_array_t;
+
+// Rows (high, low) of an (n, 2) array have the layout of fingerprint128_t
+static uint64_array_t fingerprint_array(py::object fingerprints) {
+  uint64_array_t result(fingerprints);
+
+  if ((result.size() != 0) && ((result.ndim() != 2) || (result.shape(1) != 2))) {
+    throw py::value_error("fingerprints must be an (n, 2) array of uint64 (high, low)");
+  }
+
+  return result;
+}
+
+static const pph::fingerprint128_t* fingerprint_data(const uint64_array_t& arr) {
+  return reinterpret_cast<const pph::fingerprint128_t*>(arr.data());
+}
+
+// False if fingerprint is not an int from 0 to 2^128 - 1
+static bool to_fingerprint(py::int_ fingerprint, pph::fingerprint128_t& result) {
+  py::int_ low_bits(UINT64_MAX);
+
+  if ((fingerprint < py::int_(0)) || (fingerprint.attr("bit_length")().cast<uint64_t>() > 128)) {
+    return false;
+  }
+
+  result.hi_ = fingerprint.attr("__rshift__")(64).cast<uint64_t>();
+  result.lo_ = fingerprint.attr("__and__")(low_bits).cast<uint64_t>();
+  return true;
+}
+
+PphIntTable::PphIntTable() {
+  m_initialized = false;
+  m_building    = false;
+}
+
+void PphIntTable::checkBuilt(const char* what) {
+  if (this->m_building == true) {
+    throw py::value_error(std::string(what) + ": the table is being built");
+  }
+  if (this->m_initialized == false) {
+    throw py::value_error(std::string(what) + ": the table has not been built");
+  }
+}
+
+bool PphIntTable::build(py::object keys, py::object values, uint64_t seed) {
+  if (this->m_building == true) {
+    throw py::value_error("build: the table is being built");
+  }
+  if (this->m_initialized == true) {
+    return false;
+  }
+
+  ScopedFlag building(this->m_building);
+  py::array_t<uint64_t, py::array::c_style | py::array::forcecast> key_array(keys);
+  size_t                count        = static_cast<size_t>(key_array.size());
+  std::vector<uint64_t> value_vector = int_table_values(values, count);
+  // built aside and put in place with the GIL held
+  pph::IntTable         table;
+  bool status;
+
+  {
+    py::gil_scoped_release release;
+    status = table.load(key_array.data(), value_vector.data(), count, seed);
+  }
+
+  // a table that failed to build keeps its collisions
+  this->m_table       = std::move(table);
+  this->m_initialized = status;
+  return status;
+}
+
+bool PphIntTable::contains(uint64_t key) {
+  this->checkBuilt("PphIntTable.__contains__");
+  return !this->m_table.notfound_val(this->m_table.find_val(key));
+}
+
+uint64_t PphIntTable::getitem(uint64_t key) {
+  this->checkBuilt("PphIntTable.__getitem__");
+  uint64_t val = this->m_table.find_val(key);
+
+  if (this->m_table.notfound_val(val)) {
+    throw pybind11::key_error(std::to_string(key));
+  }
+  return val;
+}
+
+uint64_t PphIntTable::len() {
+  if (this->m_building == true) {
+    throw py::value_error("PphIntTable.__len__: the table is being built");
+  }
+  return this->m_table.size();
+}
+
+py::array_t<uint64_t> PphIntTable::lookupMany(py::object keys, uint64_t miss) {
+  this->checkBuilt("lookup_many");
+  py::array_t<uint64_t, py::array::c_style | py::array::forcecast> key_array(keys);
+  py::array_t<uint64_t> result(std::vector<ssize_t>(key_array.shape(), key_array.shape() + key_array.ndim()));
+  uint64_t*             vals  = result.mutable_data();
+  size_t                count = static_cast<size_t>(key_array.size());
+
+  {
+    py::gil_scoped_release release;
+
+    this->m_table.find_vals(key_array.data(), count, vals);
+
+    for (size_t i = 0; i < count; i++) {
+      if (this->m_table.notfound_val(vals[i])) {
+        vals[i] = miss;
+      }
+    }
+  }
+
+  return result;
+}
+
+uint64_t PphIntTable::nbytes() {
+  this->checkBuilt("PphIntTable.nbytes");
+  return this->m_table.bytes();
+}
+
+py::bytes PphIntTable::toBytes() {
+  this->checkBuilt("PphIntTable.to_bytes");
+  std::ostringstream stream;
+
+  this->m_table.serialize(stream);
+  return py::bytes(stream.str());
+}
+
+std::unique_ptr<PphIntTable> PphIntTable::fromBytes(py::buffer buffer) {
+  std::unique_ptr<PphIntTable> table(new PphIntTable());
+  py::buffer_info info = request_contiguous(buffer, "PphIntTable.from_bytes");
+  bool status;
+
+  {
+    py::gil_scoped_release release;
+    status = table->m_table.unserialize(static_cast<const char*>(info.ptr),
+                                        static_cast<size_t>(info.size * info.itemsize));
+  }
+
+  if (status == false) {
+    throw py::value_error("PphIntTable.from_bytes: not a valid table");
+  }
+
+  table->m_initialized = true;
+  return table;
+}
+
+py::array_t<uint64_t> PphIntTable::collisions() {
+  if (this->m_building == true) {
+    throw py::value_error("PphIntTable.collisions: the table is being built");
+  }
+  return collision_array(this->m_table.collisions());
+}
+
+PphFingerprintTable::PphFingerprintTable() {
+  m_initialized = false;
+  m_building    = false;
+}
+
+void PphFingerprintTable::checkBuilt(const char* what) {
+  if (this->m_building == true) {
+    throw py::value_error(std::string(what) + ": the table is being built");
+  }
+  if (this->m_initialized == false) {
+    throw py::value_error(std::string(what) + ": the table has not been built");
+  }
+}
+
+bool PphFingerprintTable::build(py::object fingerprints, py::object values, uint64_t seed) {
+  if (this->m_building == true) {
+    throw py::value_error("build: the table is being built");
+  }
+  if (this->m_initialized == true) {
+    return false;
+  }
+
+  ScopedFlag            building(this->m_building);
+  auto                  key_array    = fingerprint_array(fingerprints);
+  size_t                count        = static_cast<size_t>(key_array.size() / 2);
+  std::vector<uint64_t> value_vector = int_table_values(values, count);
+  pph::FingerprintTable table;
+  bool status;
+
+  {
+    py::gil_scoped_release release;
+    status = table.load(fingerprint_data(key_array), value_vector.data(), count, seed);
+  }
+
+  this->m_table       = std::move(table);
+  this->m_initialized = status;
+  return status;
+}
+
+bool PphFingerprintTable::contains(py::int_ fingerprint) {
+  this->checkBuilt("PphFingerprintTable.__contains__");
+  pph::fingerprint128_t key;
+
+  return to_fingerprint(fingerprint, key) && !this->m_table.notfound_val(this->m_table.find_val(key));
+}
+
+uint64_t PphFingerprintTable::getitem(py::int_ fingerprint) {
+  this->checkBuilt("PphFingerprintTable.__getitem__");
+  pph::fingerprint128_t key;
+  uint64_t val = pph::EMPTY_VAL;
+
+  if (to_fingerprint(fingerprint, key)) {
+    val = this->m_table.find_val(key);
+  }
+
+  if (this->m_table.notfound_val(val)) {
+    throw pybind11::key_error(py::str(fingerprint));
+  }
+  return val;
+}
+
+uint64_t PphFingerprintTable::len() {
+  if (this->m_building == true) {
+    throw py::value_error("PphFingerprintTable.__len__: the table is being built");
+  }
+  return this->m_table.size();
+}
+
+py::array_t<uint64_t> PphFingerprintTable::lookupMany(py::object fingerprints, uint64_t miss) {
+  this->checkBuilt("lookup_many");
+  auto                  key_array = fingerprint_array(fingerprints);
+  size_t                count     = static_cast<size_t>(key_array.size() / 2);
+  py::array_t<uint64_t> result(std::vector<ssize_t>{static_cast<ssize_t>(count)});
+  uint64_t*             vals      = result.mutable_data();
+
+  {
+    py::gil_scoped_release release;
+
+    this->m_table.find_vals(fingerprint_data(key_array), count, vals);
+
+    for (size_t i = 0; i < count; i++) {
+      if (this->m_table.notfound_val(vals[i])) {
+        vals[i] = miss;
+      }
+    }
+  }
+
+  return result;
+}
+
+uint64_t PphFingerprintTable::nbytes() {
+  this->checkBuilt("PphFingerprintTable.nbytes");
+  return this->m_table.bytes();
+}
+
+py::bytes PphFingerprintTable::toBytes() {
+  this->checkBuilt("PphFingerprintTable.to_bytes");
+  std::ostringstream stream;
+
+  this->m_table.serialize(stream);
+  return py::bytes(stream.str());
+}
+
+std::unique_ptr<PphFingerprintTable> PphFingerprintTable::fromBytes(py::buffer buffer) {
+  std::unique_ptr<PphFingerprintTable> table(new PphFingerprintTable());
+  py::buffer_info info = request_contiguous(buffer, "PphFingerprintTable.from_bytes");
+  bool status;
+
+  {
+    py::gil_scoped_release release;
+    status = table->m_table.unserialize(static_cast<const char*>(info.ptr),
+                                        static_cast<size_t>(info.size * info.itemsize));
+  }
+
+  if (status == false) {
+    throw py::value_error("PphFingerprintTable.from_bytes: not a valid table");
+  }
+
+  table->m_initialized = true;
+  return table;
+}
+
+py::array_t<uint64_t> PphFingerprintTable::collisions() {
+  if (this->m_building == true) {
+    throw py::value_error("PphFingerprintTable.collisions: the table is being built");
+  }
+  return collision_array(this->m_table.collisions());
+}
 
 PYBIND11_MODULE(pph, m) {
   m.doc() = "Practical Perfect Hashing module";
@@ -267,13 +1315,62 @@ PYBIND11_MODULE(pph, m) {
     .def_property("seed", &PphHashTable::getSeed, &PphHashTable::setSeed)
     .def_property("multiplier", &PphHashTable::getMultiplier, &PphHashTable::setMultiplier)
     .def_property("adjustment", &PphHashTable::getAdjustment, &PphHashTable::setAdjustment)
+    .def_property("fold_case", &PphHashTable::getFoldCase, &PphHashTable::setFoldCase)
     .def("__contains__", &PphHashTable::contains)
     .def("__getitem__", &PphHashTable::getitem)
     .def("__setitem__", &PphHashTable::setitem)
     .def("__delitem__", &PphHashTable::delitem)
     .def("load", &PphHashTable::load)
+    .def_static("from_buffer", &PphHashTable::fromBuffer, py::arg("buffer"))
+    .def_static("open", &PphHashTable::open, py::arg("path"), py::arg("mmap") = true)
+    .def("publish", &PphHashTable::publish, py::arg("name"))
+    .def_static("attach", &PphHashTable::attach, py::arg("name"))
+    .def_static("unlink", &PphHashTable::unlink, py::arg("name"))
+    .def(py::pickle([](PphHashTable& table) { return table.getstate(); },
+                    [](py::tuple state) { return PphHashTable::setstate(state); }))
     .def("save", &PphHashTable::save)
     .def("initialize", &PphHashTable::initialize)
+    .def("build", &PphHashTable::build, py::arg("keys"), py::arg("values") = py::none(),
+         py::arg("offsets") = py::none(), py::arg("chunk_size") = 65536)
+    .def("enable_stats", &PphHashTable::enableStats, py::arg("enable") = true)
+    .def("reset_stats", &PphHashTable::resetStats)
+    .def("stats", &PphHashTable::stats)
+    .def_property("checksums_verified", &PphHashTable::checksumsVerified, nullptr)
+    .def("lookup_many", &PphHashTable::lookupMany, py::arg("keys"), py::arg("offsets") = py::none(),
+         py::arg("miss") = pph::EMPTY_VAL, py::arg("threads") = 1)
+    .def("tokenize", &PphHashTable::tokenize, py::arg("text"), py::arg("token_chars") = py::none(),
+         py::arg("miss") = pph::EMPTY_VAL)
+    ;
+
+  py::class_<PphIntTable>(m, "PphIntTable")
+    .def(py::init<>())
+    .def("build", &PphIntTable::build, py::arg("keys"), py::arg("values") = py::none(), py::arg("seed") = 0)
+    .def("__contains__", &PphIntTable::contains)
+    .def("__getitem__", &PphIntTable::getitem)
+    .def("__len__", &PphIntTable::len)
+    .def("lookup_many", &PphIntTable::lookupMany, py::arg("keys"), py::arg("miss") = pph::EMPTY_VAL)
+    .def_property("nbytes", &PphIntTable::nbytes, nullptr)
+    .def("to_bytes", &PphIntTable::toBytes)
+    .def_static("from_bytes", &PphIntTable::fromBytes, py::arg("buffer"))
+    .def("collisions", &PphIntTable::collisions)
+    .def(py::pickle([](PphIntTable& table) { return table.toBytes(); },
+                    [](py::bytes state) { return PphIntTable::fromBytes(state); }))
+    ;
+
+  py::class_<PphFingerprintTable>(m, "PphFingerprintTable")
+    .def(py::init<>())
+    .def("build", &PphFingerprintTable::build, py::arg("fingerprints"), py::arg("values") = py::none(),
+         py::arg("seed") = 0)
+    .def("__contains__", &PphFingerprintTable::contains)
+    .def("__getitem__", &PphFingerprintTable::getitem)
+    .def("__len__", &PphFingerprintTable::len)
+    .def("lookup_many", &PphFingerprintTable::lookupMany, py::arg("fingerprints"), py::arg("miss") = pph::EMPTY_VAL)
+    .def_property("nbytes", &PphFingerprintTable::nbytes, nullptr)
+    .def("to_bytes", &PphFingerprintTable::toBytes)
+    .def_static("from_bytes", &PphFingerprintTable::fromBytes, py::arg("buffer"))
+    .def("collisions", &PphFingerprintTable::collisions)
+    .def(py::pickle([](PphFingerprintTable& table) { return table.toBytes(); },
+                    [](py::bytes state) { return PphFingerprintTable::fromBytes(state); }))
     ;
 
   m.attr("__version__") = py::make_tuple(0, 2, 0, "alpha", 0);
@@ -35,9 +35,16 @@
 #include <list>
 #include <memory>
 #include <string>
+#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #include "pybind11/stl.h"
 #include "pybind11/iostream.h"
+#include "pybind11/numpy.h"
 
 namespace py = pybind11;
 
@@ -102,6 +109,12 @@ public:
 
   void setAdjustment(uint64_t value);
 
+  // Keys are case-insensitive for ASCII letters; set before the table is
+  // built (tables that are loaded or attached keep their own setting)
+  bool getFoldCase();
+
+  void setFoldCase(bool value);
+
   bool contains(std::string& key);
 
   py::object getitem(std::string& key);
@@ -112,12 +125,78 @@ public:
 
   bool load(py::object pystream);
 
+  // A table read from any object with the buffer protocol (bytes,
+  // memoryview, mmap.mmap) without Python-level reads
+  static std::unique_ptr<PphHashTable> fromBuffer(py::buffer buffer);
+
+  // A table read from a file, mapped into memory if map is true
+  static std::unique_ptr<PphHashTable> open(const std::string& path, bool map);
+
+  // Publishes the table in shared memory under name: a POSIX shared
+  // memory object, or a file for names with a directory (SharedTable.h)
+  bool publish(const std::string& name);
+
+  // A table published by another process, mapped read-only. Values are
+  // the indexes of the keys.
+  static std::unique_ptr<PphHashTable> attach(const std::string& name);
+
+  static bool unlink(const std::string& name);
+
+  // Pickle support: the serialized table (the name of an attached table)
+  // and the values (None if they are the indexes)
+  py::tuple getstate();
+
+  static std::unique_ptr<PphHashTable> setstate(py::tuple state);
+
   bool save(py::object pystream);
 
   // Call initialize() before calling getitem()
   bool initialize();
 
+  // Builds the table from keys in one call instead of __setitem__ and
+  // initialize(). keys is an iterable of str or bytes (read chunk_size at a
+  // time), a NumPy 'S' or 'U' array, or a bytes-like buffer with offsets as
+  // in lookupMany(). values is None (a key's value is its index) or one
+  // value per key. The table is built without the GIL.
+  bool build(py::object keys, py::object values, py::object offsets, size_t chunk_size);
+
+  void enableStats(bool enable);
+
+  void resetStats();
+
+  py::dict stats();
+
+  // True if load() read a table with checksums and they matched
+  bool checksumsVerified();
+
+  // Values of many keys at once, as a NumPy uint64 array. keys is an
+  // iterable of str or bytes, a NumPy 'S' or 'U' array, or (with offsets)
+  // a bytes-like buffer holding key i at data[offsets[i]:offsets[i + 1]].
+  // Missing keys get miss. Lookups run without the GIL on threads threads
+  // (0: one per core).
+  py::array_t<uint64_t> lookupMany(py::object keys, py::object offsets, uint64_t miss, size_t threads);
+
+  // Splits text (str, as UTF-8, or a bytes-like buffer) into the runs of
+  // bytes in token_chars (None: letters, digits and '_'; see
+  // pph::CharClass::parse) and looks them up. Returns a NumPy uint64 array
+  // with a row of byte offset, length and value (miss if it is not a
+  // key) per token. Runs without the GIL.
+  py::array_t<uint64_t> tokenize(py::object text, py::object token_chars, uint64_t miss);
+
 private:
+  bool construct();
+
+  // Raises ValueError, naming what, while another thread builds the table
+  void checkNotBuilding(const char* what);
+  // Raises ValueError while lookup_many() or tokenize() run in another thread
+  void checkNoLookups(const char* what);
+
+  uint64_t findVal(const std::string& key);
+
+  bool unserialize(std::istream& istr);
+
+  bool unserialize(const char* data, size_t size);
+
   pph::Table *              m_table;
   std::vector<std::string>  m_keys;
   std::vector<uint64_t>     m_index_values;
@@ -130,5 +209,97 @@ private:
   uint64_t                  m_seed;
   uint64_t                  m_multiplier;
   uint64_t                  m_adjustment;
+  // set when a table is in place, after it is built or read
   bool                      m_initialized;
-};
\ No newline at end of file
+  // set, with the GIL held, while build() or initialize() runs
+  bool                      m_building;
+  // calls of lookup_many() and tokenize() running without the GIL
+  size_t                    m_lookups;
+  // set by attach()
+  std::shared_ptr<pph::FrozenTable> m_frozen;
+  std::string               m_shared_name;
+};
+// A table with 64-bit integer keys (pph::IntTable)
+class PphIntTable {
+public:
+  PphIntTable();
+
+  // Builds the table from keys (any sequence or array of integers, cast to
+  // uint64). values is None (a key's value is its index) or one value per
+  // key. False if the table was already built or keys has duplicates. The
+  // table is built without the GIL.
+  bool build(py::object keys, py::object values, uint64_t seed);
+
+  bool contains(uint64_t key);
+
+  uint64_t getitem(uint64_t key);
+
+  uint64_t len();
+
+  // Values of many keys at once, as a NumPy uint64 array of the shape of
+  // keys; missing keys get miss
+  py::array_t<uint64_t> lookupMany(py::object keys, uint64_t miss);
+
+  // Bytes of the table in memory
+  uint64_t nbytes();
+
+  // The serialized table, and a table read from any object with the
+  // buffer protocol
+  py::bytes toBytes();
+
+  static std::unique_ptr<PphIntTable> fromBytes(py::buffer buffer);
+
+  // Pairs of positions (earlier, repeat) of the keys that made the last
+  // build() fail, as an (n, 2) NumPy uint64 array
+  py::array_t<uint64_t> collisions();
+
+private:
+  // Raises ValueError, naming what, while the table is being built or
+  // before it is built
+  void checkBuilt(const char* what);
+
+  pph::IntTable m_table;
+  // set when a table is in place, after it is built or read
+  bool          m_initialized;
+  // set, with the GIL held, while build() runs
+  bool          m_building;
+};
+
+// A table over 128-bit fingerprints that were computed elsewhere. A
+// fingerprint is a Python int below 2^128, and many fingerprints are an
+// (n, 2) array of uint64 rows (high, low).
+class PphFingerprintTable {
+public:
+  PphFingerprintTable();
+
+  // Builds the table from fingerprints, an (n, 2) array. values is None (a
+  // fingerprint's value is its index) or one value per fingerprint. False
+  // if the table was already built or two fingerprints are equal, which
+  // collisions() then lists. The table is built without the GIL.
+  bool build(py::object fingerprints, py::object values, uint64_t seed);
+
+  bool contains(py::int_ fingerprint);
+
+  uint64_t getitem(py::int_ fingerprint);
+
+  uint64_t len();
+
+  // Values of an (n, 2) array of fingerprints, as a NumPy uint64 array of
+  // n values; missing fingerprints get miss
+  py::array_t<uint64_t> lookupMany(py::object fingerprints, uint64_t miss);
+
+  uint64_t nbytes();
+
+  py::bytes toBytes();
+
+  static std::unique_ptr<PphFingerprintTable> fromBytes(py::buffer buffer);
+
+  py::array_t<uint64_t> collisions();
+
+private:
+  void checkBuilt(const char* what);
+
+  pph::FingerprintTable m_table;
+  bool                  m_initialized;
+  bool                  m_building;
+};
@@ -30,6 +30,8 @@ ext_modules = [
             # Path to pybind11 headers
             get_pybind_include(),
         ],
+        # shm_open and shm_unlink are in librt before glibc 2.34
+        libraries=['rt'] if sys.platform.startswith('linux') else [],
         language='c++'
     ),
 ]
@@ -80,7 +82,7 @@ class BuildExt(build_ext):
     }
     l_opts = {
         'msvc': [],
-        'unix': [],
+        'unix': ['-pthread'],
     }
 
     if sys.platform == 'darwin':
@@ -115,6 +117,8 @@ setup(
     long_description_content_type="text/markdown",
     ext_modules=ext_modules,
     setup_requires=['pybind11>=2.5.0'],
+    extras_require={'numpy': ['numpy']},
+    tests_require=['pytest', 'numpy'],
     cmdclass={'build_ext': BuildExt},
     zip_safe=False,
 )
@@ -0,0 +1,683 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	simd_hash.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Hashes several keys at once in SIMD lanes (AVX2, AVX-512)
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _SIMD_HASH_H
+#define _SIMD_HASH_H
+
+// A batch key function hashes count keys at once. hashes[i] is the value
+// of the scalar key function for keys[i] with multipliers[i] and an
+// adjustment of 0; the caller adds the adjustment.
+//
+// The AVX2 and AVX-512 kernels hash 8 and 16 keys at a time, as two
+// interleaved vectors of 4 or 8 lanes (one vector alone is bound by the
+// latency of the multiply). The results are bit-identical to the scalar
+// functions. Keys are grouped by length so that the lanes of a group
+// share most of their bytes: the common prefix is hashed without masks
+// and only the remaining bytes are masked per lane.
+
+typedef void (*batchkeyfunc_t)(const char* const* keys, const size_t* lengths,
+                               const uint64_t* multipliers, size_t count, uint64_t* hashes);
+
+// Hashes the keys selected by lanes (one group of 8 or 16 keys)
+typedef void (*lanekernel_t)(const char* const* keys, const size_t* lengths,
+                             const uint64_t* multipliers, const uint32_t* lanes, uint64_t* hashes);
+
+enum SimdLevel {
+  SIMD_SCALAR = 0,
+  SIMD_AVX2   = 1,
+  SIMD_AVX512 = 2
+};
+
+inline SimdLevel simd_level() {
+  static const SimdLevel level = cpu_has_avx512() ? SIMD_AVX512 :
+                                 (cpu_has_avx2() ? SIMD_AVX2 : SIMD_SCALAR);
+  return level;
+}
+
+// Keys are grouped by length within blocks of this many keys
+static constexpr size_t SIMD_GROUP_SIZE     = 64;
+
+// Blocks of keys shorter than this are hashed with the scalar function;
+// gathering the lanes costs more than it saves
+static constexpr size_t SIMD_MIN_LENGTH     = 8;
+
+// Length classes used for grouping: number of 8 byte words, capped
+static constexpr size_t SIMD_LENGTH_CLASSES = 17;
+
+inline size_t length_class(size_t len) {
+  return std::min((len + 7) >> 3, SIMD_LENGTH_CLASSES - 1);
+}
+
+// Counting sort on the length class; order holds indices relative to lengths
+inline void order_by_length(const size_t* lengths, size_t count, uint32_t* order) {
+  uint32_t start[SIMD_LENGTH_CLASSES + 1] = {0};
+
+  for (size_t i = 0; i < count; i++) {
+    start[length_class(lengths[i]) + 1]++;
+  }
+
+  for (size_t c = 1; c <= SIMD_LENGTH_CLASSES; c++) {
+    start[c] += start[c-1];
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    order[start[length_class(lengths[i])]++] = static_cast<uint32_t>(i);
+  }
+}
+
+// 0, 1, 2, ... for blocks that need no grouping
+inline const uint32_t* identity_order() {
+  static const struct Identity {
+    Identity() {
+      for (uint32_t i = 0; i < SIMD_GROUP_SIZE; i++) {
+        order_[i] = i;
+      }
+    }
+
+    uint32_t order_[SIMD_GROUP_SIZE];
+  } identity;
+
+  return identity.order_;
+}
+
+inline uint64_t read_word(const char* data) {
+  uint64_t word;
+  std::memcpy(&word, data, sizeof(word));
+  return word;
+}
+
+// Little-endian word at offset, zero padded past the end of the key.
+// Short reads overlap instead of calling memcpy with a variable size.
+inline uint64_t load_word(const char* data, size_t len, size_t offset) {
+  if (offset >= len) {
+    return 0;
+  }
+
+  const uint8_t* p = reinterpret_cast<const uint8_t*>(data + offset);
+  size_t         n = len - offset;
+
+  if (n >= 8) {
+    return read_word(data + offset);
+  }
+
+  if (n >= 4) {
+    uint32_t lo;
+    uint32_t hi;
+    std::memcpy(&lo, p, sizeof(lo));
+    std::memcpy(&hi, p + n - 4, sizeof(hi));
+    return static_cast<uint64_t>(lo) | (static_cast<uint64_t>(hi) << (8*(n - 4)));
+  }
+
+  return static_cast<uint64_t>(p[0]) |
+         (static_cast<uint64_t>(p[n >> 1]) << (8*(n >> 1))) |
+         (static_cast<uint64_t>(p[n - 1]) << (8*(n - 1)));
+}
+
+inline void batch_hash(const char* const* keys, const size_t* lengths,
+                       const uint64_t* multipliers, size_t count, uint64_t* hashes,
+                       bufkeyfunc_t scalar, lanekernel_t kernel, size_t width) {
+  uint32_t sorted[SIMD_GROUP_SIZE];
+
+  for (size_t base = 0; base < count; base += SIMD_GROUP_SIZE) {
+    size_t          n     = std::min(SIMD_GROUP_SIZE, count - base);
+    size_t          g     = 0;
+    const uint32_t* order = identity_order();
+
+    if ((kernel != nullptr) && (n >= width)) {
+      size_t min_len = SIZE_MAX;
+      size_t max_len = 0;
+
+      for (size_t i = 0; i < n; i++) {
+        min_len = std::min(min_len, lengths[base + i]);
+        max_len = std::max(max_len, lengths[base + i]);
+      }
+
+      // keys within a word of each other need no grouping
+      if (max_len - min_len >= 8) {
+        order_by_length(lengths + base, n, sorted);
+        order = sorted;
+      }
+
+      if (max_len >= SIMD_MIN_LENGTH) {
+        for (; g + width <= n; g += width) {
+          kernel(keys + base, lengths + base, multipliers + base, order + g, hashes + base);
+        }
+      }
+    }
+
+    for (; g < n; g++) {
+      size_t i = base + order[g];
+      hashes[i] = scalar(keys[i], lengths[i], multipliers[i], 0);
+    }
+  }
+}
+
+template <bufkeyfunc_t F>
+void bufkeyfunc_batch(const char* const* keys, const size_t* lengths,
+                      const uint64_t* multipliers, size_t count, uint64_t* hashes) {
+  for (size_t i = 0; i < count; i++) {
+    hashes[i] = F(keys[i], lengths[i], multipliers[i], 0);
+  }
+}
+
+// SIMD-friendly key function: mixes one 8 byte word per step using only
+// xor, shift and a 64-bit multiply, so every step maps onto vector
+// instructions. The multiplier is used as the seed.
+
+static constexpr uint64_t WORDMIX_K0 = UINT64_C(0x9e3779b97f4a7c15);
+static constexpr uint64_t WORDMIX_K1 = UINT64_C(0xbf58476d1ce4e5b9);
+static constexpr uint64_t WORDMIX_K2 = UINT64_C(0x94d049bb133111eb);
+
+inline uint64_t wordmix_hash_buf(const char* data, size_t len, uint64_t multiplier, uint64_t adjustment) {
+  uint64_t h      = multiplier ^ (static_cast<uint64_t>(len) * WORDMIX_K0);
+  size_t   offset = 0;
+
+  for (; offset + 8 <= len; offset += 8) {
+    h = (h ^ read_word(data + offset)) * WORDMIX_K1;
+    h ^= h >> 32;
+  }
+
+  if (offset < len) {
+    h = (h ^ load_word(data, len, offset)) * WORDMIX_K1;
+    h ^= h >> 32;
+  }
+
+  h ^= h >> 29;
+  h *= WORDMIX_K2;
+  h ^= h >> 32;
+
+  return h + adjustment;
+}
+
+// UUID: B7F3DDEA-D10C-467E-A429-7933CE00119B
+uint64_t wordmix_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return wordmix_hash_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
+// Keys of a group of W lanes
+template <size_t W>
+class LaneGroup {
+public:
+  LaneGroup(const char* const* keys, const size_t* lengths,
+            const uint64_t* multipliers, const uint32_t* lanes) :
+    min_len_(SIZE_MAX), max_len_(0) {
+    for (size_t l = 0; l < W; l++) {
+      ptr_[l]  = keys[lanes[l]];
+      len_[l]  = lengths[lanes[l]];
+      mult_[l] = multipliers[lanes[l]];
+      min_len_ = std::min(min_len_, len_[l]);
+      max_len_ = std::max(max_len_, len_[l]);
+    }
+  }
+
+  // Word at offset of lane l; full is true below min_len_
+  uint64_t word(size_t l, size_t offset, bool full) const {
+    return full ? read_word(ptr_[l] + offset) : load_word(ptr_[l], len_[l], offset);
+  }
+
+  const char* ptr_[W];
+  size_t      len_[W];
+  uint64_t    mult_[W];
+  size_t      min_len_;
+  size_t      max_len_;
+};
+
+#if defined(PPH_X86)
+
+//
+// AVX2: 2 x 4 lanes
+//
+
+#define PPH_AVX2 "avx2"
+
+// AVX2 has no 64-bit multiply; build it from three 32x32->64 multiplies
+PPH_TARGET(PPH_AVX2)
+inline __m256i mullo64_avx2(__m256i a, __m256i b) {
+  __m256i lo    = _mm256_mul_epu32(a, b);
+  __m256i cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(a, 32), b),
+                                   _mm256_mul_epu32(a, _mm256_srli_epi64(b, 32)));
+  return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+// Low byte of each lane, sign extended like static_cast<uint64_t>(char)
+PPH_TARGET(PPH_AVX2)
+inline __m256i byte_avx2(__m256i words) {
+  const __m256i sign = _mm256_set1_epi64x(0x80);
+  __m256i c = _mm256_and_si256(words, _mm256_set1_epi64x(0xff));
+  return _mm256_sub_epi64(_mm256_xor_si256(c, sign), sign);
+}
+
+// Lanes [4v, 4v+4) of a per-lane array
+PPH_TARGET(PPH_AVX2)
+inline __m256i lanes_avx2(const uint64_t* values, size_t v) {
+  return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(values + 4*v));
+}
+
+PPH_TARGET(PPH_AVX2)
+inline __m256i words_avx2(const LaneGroup<8>& g, size_t v, size_t offset, bool full) {
+  return _mm256_set_epi64x(static_cast<int64_t>(g.word(4*v + 3, offset, full)),
+                           static_cast<int64_t>(g.word(4*v + 2, offset, full)),
+                           static_cast<int64_t>(g.word(4*v + 1, offset, full)),
+                           static_cast<int64_t>(g.word(4*v,     offset, full)));
+}
+
+PPH_TARGET(PPH_AVX2)
+inline void store_avx2(const __m256i* h, const uint32_t* lanes, uint64_t* hashes) {
+  uint64_t out[8];
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), h[0]);
+  _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + 4), h[1]);
+
+  for (size_t l = 0; l < 8; l++) {
+    hashes[lanes[l]] = out[l];
+  }
+}
+
+struct Fnv64aAvx2 {
+  PPH_TARGET(PPH_AVX2)
+  static inline __m256i init(__m256i /*mult*/) {
+    return _mm256_set1_epi64x(static_cast<int64_t>(FNV1A_64_INIT));
+  }
+
+  // FNV_64_PRIME = 2^40 + 0x1b3
+  PPH_TARGET(PPH_AVX2)
+  static inline __m256i step(__m256i h, __m256i c, __m256i /*mult*/) {
+    const __m256i prime = _mm256_set1_epi64x(FNV_64_PRIME & UINT64_C(0xffffffff));
+    __m256i x  = _mm256_xor_si256(h, c);
+    __m256i lo = _mm256_add_epi64(_mm256_mul_epu32(x, prime),
+                                  _mm256_slli_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), prime), 32));
+    return _mm256_add_epi64(_mm256_slli_epi64(x, 40), lo);
+  }
+};
+
+struct DjbAvx2 {
+  PPH_TARGET(PPH_AVX2)
+  static inline __m256i init(__m256i /*mult*/) {
+    return _mm256_setzero_si256();
+  }
+
+  PPH_TARGET(PPH_AVX2)
+  static inline __m256i step(__m256i h, __m256i c, __m256i mult) {
+    return _mm256_xor_si256(mullo64_avx2(h, mult), c);
+  }
+};
+
+// Byte at a time key functions
+template <typename Step>
+PPH_TARGET(PPH_AVX2)
+void bytes_avx2(const char* const* keys, const size_t* lengths,
+                const uint64_t* multipliers, const uint32_t* lanes, uint64_t* hashes) {
+  LaneGroup<8> g(keys, lengths, multipliers, lanes);
+  uint64_t     len[8];
+  __m256i      mult[2], vlen[2], h[2], w[2];
+
+  std::copy(g.len_, g.len_ + 8, len);
+
+  for (size_t v = 0; v < 2; v++) {
+    mult[v] = lanes_avx2(g.mult_, v);
+    vlen[v] = lanes_avx2(len, v);
+    h[v]    = Step::init(mult[v]);
+  }
+
+  size_t offset = 0;
+
+  // bytes every lane has
+  for (; offset + 8 <= g.min_len_; offset += 8) {
+    for (size_t v = 0; v < 2; v++) {
+      w[v] = words_avx2(g, v, offset, true);
+    }
+
+    for (size_t b = 0; b < 8; b++) {
+      for (size_t v = 0; v < 2; v++) {
+        h[v] = Step::step(h[v], byte_avx2(w[v]), mult[v]);
+        w[v] = _mm256_srli_epi64(w[v], 8);
+      }
+    }
+  }
+
+  // lanes stop at their own length
+  for (; offset < g.max_len_; offset += 8) {
+    size_t end = std::min(offset + 8, g.max_len_);
+
+    for (size_t v = 0; v < 2; v++) {
+      w[v] = words_avx2(g, v, offset, false);
+    }
+
+    size_t i = offset;
+
+    for (; i < std::min(end, g.min_len_); i++) {
+      for (size_t v = 0; v < 2; v++) {
+        h[v] = Step::step(h[v], byte_avx2(w[v]), mult[v]);
+        w[v] = _mm256_srli_epi64(w[v], 8);
+      }
+    }
+
+    for (; i < end; i++) {
+      const __m256i pos = _mm256_set1_epi64x(static_cast<int64_t>(i));
+
+      for (size_t v = 0; v < 2; v++) {
+        __m256i next   = Step::step(h[v], byte_avx2(w[v]), mult[v]);
+        __m256i active = _mm256_cmpgt_epi64(vlen[v], pos);
+        h[v] = _mm256_blendv_epi8(h[v], next, active);
+        w[v] = _mm256_srli_epi64(w[v], 8);
+      }
+    }
+  }
+
+  store_avx2(h, lanes, hashes);
+}
+
+PPH_TARGET(PPH_AVX2)
+void wordmix_hash_avx2(const char* const* keys, const size_t* lengths,
+                       const uint64_t* multipliers, const uint32_t* lanes, uint64_t* hashes) {
+  LaneGroup<8> g(keys, lengths, multipliers, lanes);
+  uint64_t     len[8], seed[8];
+  __m256i      vlen[2], h[2];
+
+  for (size_t l = 0; l < 8; l++) {
+    len[l]  = g.len_[l];
+    seed[l] = g.mult_[l] ^ (static_cast<uint64_t>(g.len_[l]) * WORDMIX_K0);
+  }
+
+  const __m256i k1 = _mm256_set1_epi64x(static_cast<int64_t>(WORDMIX_K1));
+  const __m256i k2 = _mm256_set1_epi64x(static_cast<int64_t>(WORDMIX_K2));
+
+  for (size_t v = 0; v < 2; v++) {
+    vlen[v] = lanes_avx2(len, v);
+    h[v]    = lanes_avx2(seed, v);
+  }
+
+  size_t offset = 0;
+
+  for (; offset + 8 <= g.min_len_; offset += 8) {
+    for (size_t v = 0; v < 2; v++) {
+      __m256i x = mullo64_avx2(_mm256_xor_si256(h[v], words_avx2(g, v, offset, true)), k1);
+      h[v] = _mm256_xor_si256(x, _mm256_srli_epi64(x, 32));
+    }
+  }
+
+  for (; offset < g.max_len_; offset += 8) {
+    const __m256i pos = _mm256_set1_epi64x(static_cast<int64_t>(offset));
+
+    for (size_t v = 0; v < 2; v++) {
+      __m256i x = mullo64_avx2(_mm256_xor_si256(h[v], words_avx2(g, v, offset, false)), k1);
+      x = _mm256_xor_si256(x, _mm256_srli_epi64(x, 32));
+      h[v] = _mm256_blendv_epi8(h[v], x, _mm256_cmpgt_epi64(vlen[v], pos));
+    }
+  }
+
+  for (size_t v = 0; v < 2; v++) {
+    h[v] = _mm256_xor_si256(h[v], _mm256_srli_epi64(h[v], 29));
+    h[v] = mullo64_avx2(h[v], k2);
+    h[v] = _mm256_xor_si256(h[v], _mm256_srli_epi64(h[v], 32));
+  }
+
+  store_avx2(h, lanes, hashes);
+}
+
+//
+// AVX-512: 2 x 8 lanes
+//
+
+#define PPH_AVX512 "avx512f,avx512dq"
+
+// The unmasked _mm512_srli_epi64, _mm512_slli_epi64 and _mm512_mul_epu32
+// merge into an undefined vector that GCC 12 reports as uninitialized
+// (-Wall); with every lane selected the zero-masking form is the same
+// instruction.
+PPH_TARGET(PPH_AVX512)
+inline __m512i srli64_avx512(__m512i x, unsigned int n) {
+  return _mm512_maskz_srli_epi64(static_cast<__mmask8>(0xff), x, n);
+}
+
+PPH_TARGET(PPH_AVX512)
+inline __m512i slli64_avx512(__m512i x, unsigned int n) {
+  return _mm512_maskz_slli_epi64(static_cast<__mmask8>(0xff), x, n);
+}
+
+PPH_TARGET(PPH_AVX512)
+inline __m512i mul_epu32_avx512(__m512i a, __m512i b) {
+  return _mm512_maskz_mul_epu32(static_cast<__mmask8>(0xff), a, b);
+}
+
+PPH_TARGET(PPH_AVX512)
+inline __m512i byte_avx512(__m512i words) {
+  const __m512i sign = _mm512_set1_epi64(0x80);
+  __m512i c = _mm512_and_si512(words, _mm512_set1_epi64(0xff));
+  return _mm512_sub_epi64(_mm512_xor_si512(c, sign), sign);
+}
+
+// Lanes [8v, 8v+8) of a per-lane array
+PPH_TARGET(PPH_AVX512)
+inline __m512i lanes_avx512(const uint64_t* values, size_t v) {
+  return _mm512_loadu_si512(values + 8*v);
+}
+
+PPH_TARGET(PPH_AVX512)
+inline __m512i words_avx512(const LaneGroup<16>& g, size_t v, size_t offset, bool full) {
+  return _mm512_set_epi64(static_cast<int64_t>(g.word(8*v + 7, offset, full)),
+                          static_cast<int64_t>(g.word(8*v + 6, offset, full)),
+                          static_cast<int64_t>(g.word(8*v + 5, offset, full)),
+                          static_cast<int64_t>(g.word(8*v + 4, offset, full)),
+                          static_cast<int64_t>(g.word(8*v + 3, offset, full)),
+                          static_cast<int64_t>(g.word(8*v + 2, offset, full)),
+                          static_cast<int64_t>(g.word(8*v + 1, offset, full)),
+                          static_cast<int64_t>(g.word(8*v,     offset, full)));
+}
+
+PPH_TARGET(PPH_AVX512)
+inline void store_avx512(const __m512i* h, const uint32_t* lanes, uint64_t* hashes) {
+  uint64_t out[16];
+  _mm512_storeu_si512(out, h[0]);
+  _mm512_storeu_si512(out + 8, h[1]);
+
+  for (size_t l = 0; l < 16; l++) {
+    hashes[lanes[l]] = out[l];
+  }
+}
+
+struct Fnv64aAvx512 {
+  PPH_TARGET(PPH_AVX512)
+  static inline __m512i init(__m512i /*mult*/) {
+    return _mm512_set1_epi64(static_cast<int64_t>(FNV1A_64_INIT));
+  }
+
+  // FNV_64_PRIME = 2^40 + 0x1b3; shorter latency than vpmullq
+  PPH_TARGET(PPH_AVX512)
+  static inline __m512i step(__m512i h, __m512i c, __m512i /*mult*/) {
+    const __m512i prime = _mm512_set1_epi64(FNV_64_PRIME & UINT64_C(0xffffffff));
+    __m512i x  = _mm512_xor_si512(h, c);
+    __m512i lo = _mm512_add_epi64(mul_epu32_avx512(x, prime),
+                                  slli64_avx512(mul_epu32_avx512(srli64_avx512(x, 32), prime), 32));
+    return _mm512_add_epi64(slli64_avx512(x, 40), lo);
+  }
+};
+
+struct DjbAvx512 {
+  PPH_TARGET(PPH_AVX512)
+  static inline __m512i init(__m512i /*mult*/) {
+    return _mm512_setzero_si512();
+  }
+
+  PPH_TARGET(PPH_AVX512)
+  static inline __m512i step(__m512i h, __m512i c, __m512i mult) {
+    return _mm512_xor_si512(_mm512_mullo_epi64(h, mult), c);
+  }
+};
+
+template <typename Step>
+PPH_TARGET(PPH_AVX512)
+void bytes_avx512(const char* const* keys, const size_t* lengths,
+                  const uint64_t* multipliers, const uint32_t* lanes, uint64_t* hashes) {
+  LaneGroup<16> g(keys, lengths, multipliers, lanes);
+  uint64_t      len[16];
+  __m512i       mult[2], vlen[2], h[2], w[2];
+
+  std::copy(g.len_, g.len_ + 16, len);
+
+  for (size_t v = 0; v < 2; v++) {
+    mult[v] = lanes_avx512(g.mult_, v);
+    vlen[v] = lanes_avx512(len, v);
+    h[v]    = Step::init(mult[v]);
+  }
+
+  size_t offset = 0;
+
+  for (; offset + 8 <= g.min_len_; offset += 8) {
+    for (size_t v = 0; v < 2; v++) {
+      w[v] = words_avx512(g, v, offset, true);
+    }
+
+    for (size_t b = 0; b < 8; b++) {
+      for (size_t v = 0; v < 2; v++) {
+        h[v] = Step::step(h[v], byte_avx512(w[v]), mult[v]);
+        w[v] = srli64_avx512(w[v], 8);
+      }
+    }
+  }
+
+  for (; offset < g.max_len_; offset += 8) {
+    size_t end = std::min(offset + 8, g.max_len_);
+
+    for (size_t v = 0; v < 2; v++) {
+      w[v] = words_avx512(g, v, offset, false);
+    }
+
+    size_t i = offset;
+
+    for (; i < std::min(end, g.min_len_); i++) {
+      for (size_t v = 0; v < 2; v++) {
+        h[v] = Step::step(h[v], byte_avx512(w[v]), mult[v]);
+        w[v] = srli64_avx512(w[v], 8);
+      }
+    }
+
+    for (; i < end; i++) {
+      const __m512i pos = _mm512_set1_epi64(static_cast<int64_t>(i));
+
+      for (size_t v = 0; v < 2; v++) {
+        __mmask8 active = _mm512_cmpgt_epi64_mask(vlen[v], pos);
+        h[v] = _mm512_mask_mov_epi64(h[v], active, Step::step(h[v], byte_avx512(w[v]), mult[v]));
+        w[v] = srli64_avx512(w[v], 8);
+      }
+    }
+  }
+
+  store_avx512(h, lanes, hashes);
+}
+
+PPH_TARGET(PPH_AVX512)
+void wordmix_hash_avx512(const char* const* keys, const size_t* lengths,
+                         const uint64_t* multipliers, const uint32_t* lanes, uint64_t* hashes) {
+  LaneGroup<16> g(keys, lengths, multipliers, lanes);
+  uint64_t      len[16], seed[16];
+  __m512i       vlen[2], h[2];
+
+  for (size_t l = 0; l < 16; l++) {
+    len[l]  = g.len_[l];
+    seed[l] = g.mult_[l] ^ (static_cast<uint64_t>(g.len_[l]) * WORDMIX_K0);
+  }
+
+  const __m512i k1 = _mm512_set1_epi64(static_cast<int64_t>(WORDMIX_K1));
+  const __m512i k2 = _mm512_set1_epi64(static_cast<int64_t>(WORDMIX_K2));
+
+  for (size_t v = 0; v < 2; v++) {
+    vlen[v] = lanes_avx512(len, v);
+    h[v]    = lanes_avx512(seed, v);
+  }
+
+  size_t offset = 0;
+
+  for (; offset + 8 <= g.min_len_; offset += 8) {
+    for (size_t v = 0; v < 2; v++) {
+      __m512i x = _mm512_mullo_epi64(_mm512_xor_si512(h[v], words_avx512(g, v, offset, true)), k1);
+      h[v] = _mm512_xor_si512(x, srli64_avx512(x, 32));
+    }
+  }
+
+  for (; offset < g.max_len_; offset += 8) {
+    const __m512i pos = _mm512_set1_epi64(static_cast<int64_t>(offset));
+
+    for (size_t v = 0; v < 2; v++) {
+      __m512i x = _mm512_mullo_epi64(_mm512_xor_si512(h[v], words_avx512(g, v, offset, false)), k1);
+      x = _mm512_xor_si512(x, srli64_avx512(x, 32));
+      h[v] = _mm512_mask_mov_epi64(h[v], _mm512_cmpgt_epi64_mask(vlen[v], pos), x);
+    }
+  }
+
+  for (size_t v = 0; v < 2; v++) {
+    h[v] = _mm512_xor_si512(h[v], srli64_avx512(h[v], 29));
+    h[v] = _mm512_mullo_epi64(h[v], k2);
+    h[v] = _mm512_xor_si512(h[v], srli64_avx512(h[v], 32));
+  }
+
+  store_avx512(h, lanes, hashes);
+}
+
+#endif  // PPH_X86
+
+// Runtime dispatch to the widest instruction set available
+
+inline void batch_dispatch(const char* const* keys, const size_t* lengths,
+                           const uint64_t* multipliers, size_t count, uint64_t* hashes,
+                           bufkeyfunc_t scalar, lanekernel_t avx2, lanekernel_t avx512) {
+  switch (simd_level()) {
+    case SIMD_AVX512:
+      batch_hash(keys, lengths, multipliers, count, hashes, scalar, avx512, 16);
+      break;
+    case SIMD_AVX2:
+      batch_hash(keys, lengths, multipliers, count, hashes, scalar, avx2, 8);
+      break;
+    default:
+      batch_hash(keys, lengths, multipliers, count, hashes, scalar, nullptr, 1);
+      break;
+  }
+}
+
+#if defined(PPH_X86)
+#define PPH_LANE_KERNELS(avx2, avx512) avx2, avx512
+#else
+#define PPH_LANE_KERNELS(avx2, avx512) nullptr, nullptr
+#endif
+
+inline void fnv64a_hash_batch(const char* const* keys, const size_t* lengths,
+                              const uint64_t* multipliers, size_t count, uint64_t* hashes) {
+  batch_dispatch(keys, lengths, multipliers, count, hashes, fnv64a_hash_buf,
+                 PPH_LANE_KERNELS(bytes_avx2<Fnv64aAvx2>, bytes_avx512<Fnv64aAvx512>));
+}
+
+inline void djb_hash_batch(const char* const* keys, const size_t* lengths,
+                           const uint64_t* multipliers, size_t count, uint64_t* hashes) {
+  batch_dispatch(keys, lengths, multipliers, count, hashes, djb_hash_buf,
+                 PPH_LANE_KERNELS(bytes_avx2<DjbAvx2>, bytes_avx512<DjbAvx512>));
+}
+
+inline void wordmix_hash_batch(const char* const* keys, const size_t* lengths,
+                               const uint64_t* multipliers, size_t count, uint64_t* hashes) {
+  batch_dispatch(keys, lengths, multipliers, count, hashes, wordmix_hash_buf,
+                 PPH_LANE_KERNELS(wordmix_hash_avx2, wordmix_hash_avx512));
+}
+
+#endif  // _SIMD_HASH_H
@@ -0,0 +1,62 @@
+import threading
+import pytest
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT",
+            "INSERT", "UPDATE", "DELETE", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER"]
+
+# lookup statistics
+def test_00004():
+  mydict = PphHashTable()
+  for key in keywords:
+    mydict[key] = key
+  assert mydict.initialize() == True
+
+  stats = mydict.stats()
+  assert stats["enabled"] == False
+  assert stats["lookups"] == 0
+
+  mydict.enable_stats()
+
+  for key in keywords:
+    assert key in mydict
+  assert ("MISSING" in mydict) == False
+
+  stats = mydict.stats()
+  assert stats["enabled"] == True
+  assert stats["lookups"] == len(keywords) + 1
+  assert stats["hits"] == len(keywords)
+  assert stats["misses"] == 1
+  assert sum(stats["latency_ns"].values()) == stats["lookups"]
+  assert sum(stats["group_size"].values()) == stats["lookups"]
+  assert stats["latency_p50_ns"] <= stats["latency_max_ns"]
+
+  mydict.reset_stats()
+  assert mydict.stats()["lookups"] == 0
+
+  mydict.enable_stats(False)
+  assert mydict.stats()["enabled"] == False
+
+  # the statistics are not switched while lookups run without the GIL
+  keys   = ["key%d" % i for i in range(20000)]
+  mydict = PphHashTable()
+  assert mydict.build(keys) == True
+  mydict.enable_stats()
+
+  done    = threading.Event()
+  refused = []
+
+  def toggle():
+    while not done.is_set():
+      for call in [mydict.reset_stats, lambda: mydict.enable_stats(False), mydict.enable_stats]:
+        try:
+          call()
+        except ValueError:
+          refused.append(1)
+
+  toggler = threading.Thread(target=toggle)
+  toggler.start()
+  for _ in range(20):
+    assert mydict.lookup_many(keys)[-1] == len(keys) - 1
+  done.set()
+  toggler.join()
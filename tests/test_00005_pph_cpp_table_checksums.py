@@ -0,0 +1,53 @@
+import pytest
+from io import BytesIO, StringIO
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT",
+            "INSERT", "UPDATE", "DELETE", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER"]
+
+def saved_table():
+  mydict = PphHashTable()
+  for key in keywords:
+    mydict[key] = key
+  assert mydict.initialize() == True
+
+  stream = StringIO()
+  assert mydict.save(stream) == True
+  return stream.getvalue()
+
+def load_table(text):
+  mydict = PphHashTable()
+  status = mydict.load(BytesIO(text.encode('utf-8')))
+  return status, mydict
+
+# section checksums
+def test_00005():
+  text = saved_table()
+  assert "\nchecksums\n" in text
+
+  status, mydict = load_table(text)
+  assert status == True
+  assert mydict.checksums_verified == True
+  for key in keywords:
+    assert key in mydict
+
+  # a changed value no longer matches the data checksum
+  corrupt = text.replace(" SELECT 0 ", " SELECT 1 ")
+  assert corrupt != text
+  status, mydict = load_table(corrupt)
+  assert status == False
+
+  # tables of this version must have their checksums, and all of their data
+  assert text.startswith("pph version 1.1.0\n")
+  without = text[:text.index("checksums\n")]
+  status, mydict = load_table(without)
+  assert status == False
+  status, mydict = load_table(without[:len(without) // 2])
+  assert status == False
+
+  # files of version 1.0.0, written before checksums were added, still load
+  status, mydict = load_table(without.replace("pph version 1.1.0", "pph version 1.0.0", 1))
+  assert status == True
+  assert mydict.checksums_verified == False
+  for key in keywords:
+    assert key in mydict
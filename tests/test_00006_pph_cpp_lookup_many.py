@@ -0,0 +1,44 @@
+import pytest
+import numpy as np
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT",
+            "INSERT", "UPDATE", "DELETE", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER"]
+
+MISS = np.iinfo(np.uint64).max
+
+# vectorized lookups
+def test_00006():
+  mydict = PphHashTable()
+  for key in keywords:
+    mydict[key] = key
+  assert mydict.initialize() == True
+
+  queries  = keywords * 100 + ["MISSING", ""]
+  expected = np.array([keywords.index(k) if k in keywords else MISS for k in queries], dtype=np.uint64)
+
+  # list of str, list of bytes
+  result = mydict.lookup_many(queries)
+  assert result.dtype == np.uint64
+  assert np.array_equal(result, expected)
+  assert np.array_equal(mydict.lookup_many([k.encode('utf-8') for k in queries]), expected)
+
+  # NumPy unicode and bytes arrays, with the shape of the input
+  assert np.array_equal(mydict.lookup_many(np.array(queries)), expected)
+  assert np.array_equal(mydict.lookup_many(np.array(queries, dtype='S')), expected)
+  assert mydict.lookup_many(np.array(queries).reshape(2, -1)).shape == (2, len(queries) // 2)
+
+  # data buffer and offsets
+  data    = b"".join(k.encode('utf-8') for k in queries)
+  offsets = np.cumsum([0] + [len(k) for k in queries])
+  assert np.array_equal(mydict.lookup_many(data, offsets=offsets), expected)
+
+  # miss value and threads
+  result = mydict.lookup_many(queries, miss=7, threads=4)
+  assert np.array_equal(result, np.where(expected == MISS, 7, expected))
+
+  with pytest.raises(TypeError):
+    mydict.lookup_many([1, 2, 3])
+
+  with pytest.raises(ValueError):
+    mydict.lookup_many(data, offsets=[0, len(data) + 1])
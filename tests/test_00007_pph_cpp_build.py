@@ -0,0 +1,91 @@
+import threading
+import pytest
+import numpy as np
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT",
+            "INSERT", "UPDATE", "DELETE", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER"]
+
+# build from iterables and arrays
+def test_00007():
+  # generator read in small chunks; values are indexes
+  mydict = PphHashTable()
+  assert mydict.build((k for k in keywords), chunk_size=3) == True
+  assert mydict.keys == keywords
+  for i, key in enumerate(keywords):
+    assert mydict[key] == i
+
+  # values
+  mydict = PphHashTable()
+  assert mydict.build([k.encode('utf-8') for k in keywords], values=[k.lower() for k in keywords]) == True
+  for key in keywords:
+    assert mydict[key] == key.lower()
+
+  # NumPy arrays and data buffer with offsets
+  for keys, offsets in [(np.array(keywords), None),
+                        (np.array(keywords, dtype='S'), None),
+                        (b"".join(k.encode('utf-8') for k in keywords),
+                         np.cumsum([0] + [len(k) for k in keywords]))]:
+    mydict = PphHashTable()
+    assert mydict.build(keys, offsets=offsets) == True
+    assert np.array_equal(mydict.lookup_many(keywords), np.arange(len(keywords), dtype=np.uint64))
+
+  # a built table cannot be built again
+  assert mydict.build(keywords) == False
+
+  with pytest.raises(ValueError):
+    PphHashTable().build(keywords, values=[1, 2])
+
+  with pytest.raises(TypeError):
+    PphHashTable().build([1, 2, 3])
+
+  # a failed build can be retried
+  mydict = PphHashTable()
+  with pytest.raises(ValueError):
+    mydict.build(keywords, values=[1, 2])
+  with pytest.raises(TypeError):
+    mydict.build(["SELECT", 2])
+  # equal keys never get a hash function; give up after 100 ms
+  mydict.timeout = 100
+  assert mydict.build(["SELECT", "SELECT"]) == False
+  assert mydict.build(keywords) == True
+  assert mydict["OUTER"] == keywords.index("OUTER")
+
+  # other threads run during the build
+  ticks  = []
+  done   = threading.Event()
+  keys   = ["key%d" % i for i in range(3000)]
+
+  def tick():
+    while not done.is_set():
+      ticks.append(1)
+      done.wait(0.001)
+
+  ticker = threading.Thread(target=tick)
+  ticker.start()
+  mydict = PphHashTable()
+  assert mydict.build(keys) == True
+  done.set()
+  ticker.join()
+  assert len(ticks) > 1
+  assert mydict["key2999"] == 2999
+
+  # reads from other threads raise until the built table is in place
+  keys    = ["key%07d" % i for i in range(20000)]
+  mydict  = PphHashTable()
+  results = []
+  worker  = threading.Thread(target=lambda: results.append(mydict.build(keys)))
+  worker.start()
+  while worker.is_alive():
+    for read in [lambda: mydict["key0000001"], lambda: "key0000001" in mydict,
+                 lambda: mydict.lookup_many(["key0000001"]), lambda: mydict.tokenize("key0000001"),
+                 lambda: mydict.__setitem__("other", 1)]:
+      try:
+        read()
+      except (KeyError, ValueError):
+        pass
+    done.wait(0.001)
+  worker.join()
+  assert results == [True]
+  assert mydict["key0000001"] == 1
+  assert mydict.lookup_many(["key0019999"])[0] == 19999
@@ -0,0 +1,65 @@
+import mmap
+import os
+import pickle
+import tempfile
+import pytest
+from io import StringIO
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT",
+            "INSERT", "UPDATE", "DELETE", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER"]
+
+def check(mydict):
+  assert mydict.keys == keywords
+  for i, key in enumerate(keywords):
+    assert mydict[key] == i
+  assert "MISSING" not in mydict
+
+# load from buffers and files, and pickle
+def test_00008():
+  mydict = PphHashTable()
+  assert mydict.build(keywords) == True
+
+  stream = StringIO()
+  assert mydict.save(stream) == True
+  data = stream.getvalue().encode('utf-8')
+
+  check(PphHashTable.from_buffer(data))
+  check(PphHashTable.from_buffer(memoryview(data)))
+  check(PphHashTable.from_buffer(bytearray(data)))
+
+  with pytest.raises(ValueError):
+    PphHashTable.from_buffer(b"not a table")
+
+  # a strided view is not read as if it were contiguous
+  with pytest.raises(ValueError):
+    PphHashTable.from_buffer(memoryview(data + data)[::2])
+
+  fd, path = tempfile.mkstemp(suffix=".hash")
+  try:
+    with os.fdopen(fd, "wb") as f:
+      f.write(data)
+
+    check(PphHashTable.open(path))
+    check(PphHashTable.open(path, mmap=False))
+
+    with open(path, "rb") as f:
+      with mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ) as m:
+        check(PphHashTable.from_buffer(m))
+  finally:
+    os.remove(path)
+
+  with pytest.raises(ValueError):
+    PphHashTable.open(path)
+
+  # pickle keeps the values
+  check(pickle.loads(pickle.dumps(mydict)))
+
+  mydict = PphHashTable()
+  assert mydict.build(keywords, values=[k.lower() for k in keywords]) == True
+  copy = pickle.loads(pickle.dumps(mydict))
+  for key in keywords:
+    assert copy[key] == key.lower()
+
+  with pytest.raises(ValueError):
+    pickle.dumps(PphHashTable())
@@ -0,0 +1,74 @@
+import multiprocessing
+import os
+import pickle
+import struct
+import tempfile
+import pytest
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT",
+            "INSERT", "UPDATE", "DELETE", "JOIN", "LEFT", "RIGHT", "INNER", "OUTER"]
+
+def lookup(args):
+  table, key = args
+  return table[key]
+
+def attach_and_lookup(name):
+  table = PphHashTable.attach(name)
+  return [table[key] for key in keywords]
+
+# publish in shared memory, attach from other processes
+def test_00009():
+  mydict = PphHashTable()
+  assert mydict.build(keywords) == True
+
+  name = "pph-test-%d" % os.getpid()
+  path = os.path.join(tempfile.gettempdir(), "pph-test-%d.pph" % os.getpid())
+
+  try:
+    for shared in [name, path]:
+      assert mydict.publish(shared) == True
+
+      attached = PphHashTable.attach(shared)
+      assert attached.keys == keywords
+      for i, key in enumerate(keywords):
+        assert attached[key] == i
+      assert "MISSING" not in attached
+      assert attached.build(keywords) == False
+
+      with pytest.raises(ValueError):
+        attached.save(None)
+
+      # workers attach instead of copying the table
+      ctx = multiprocessing.get_context("spawn")
+      with ctx.Pool(2) as pool:
+        assert pool.map(attach_and_lookup, [shared, shared]) == [list(range(len(keywords)))] * 2
+        assert pool.map(lookup, [(attached, k) for k in keywords]) == list(range(len(keywords)))
+
+      # a pickled attached table attaches again
+      assert pickle.loads(pickle.dumps(attached))["OUTER"] == keywords.index("OUTER")
+
+      # republishing does not disturb tables already attached
+      assert mydict.publish(shared) == True
+      assert attached["WHERE"] == keywords.index("WHERE")
+
+      assert PphHashTable.unlink(shared) == True
+      assert attached["JOIN"] == keywords.index("JOIN")
+
+      with pytest.raises(ValueError):
+        PphHashTable.attach(shared)
+
+    # a corrupted block is refused: no key functions, groups past the end
+    for offset, value in [(48, 0), (88, 1 << 40)]:
+      assert mydict.publish(path) == True
+      with open(path, "r+b") as f:
+        f.seek(offset)
+        f.write(struct.pack("<Q", value))
+      with pytest.raises(ValueError):
+        PphHashTable.attach(path)
+  finally:
+    for shared in [name, path]:
+      PphHashTable.unlink(shared)
+
+  with pytest.raises(ValueError):
+    PphHashTable().publish(name)
@@ -0,0 +1,45 @@
+from io import BytesIO, StringIO
+import pickle
+import pytest
+from pph import PphHashTable
+
+keywords = ["Select", "FROM", "where", "Group", "ORDER", "by", "Having", "LIMIT",
+            "a_very_long_keyword_that_spans_several_words"]
+
+# case-insensitive keys
+def test_00010():
+  mydict = PphHashTable()
+  assert mydict.fold_case == False
+  mydict.fold_case = True
+  assert mydict.build(keywords) == True
+  assert mydict.fold_case == True
+
+  with pytest.raises(ValueError):
+    mydict.fold_case = False
+
+  for i, key in enumerate(keywords):
+    assert mydict[key] == i
+    assert mydict[key.upper()] == i
+    assert mydict[key.lower()] == i
+    assert mydict[key.swapcase()] == i
+  assert "SeLeCt" in mydict
+  assert "selects" not in mydict
+
+  queries = [key.swapcase() for key in keywords] + ["missing"]
+  assert list(mydict.lookup_many(queries, miss=99)) == list(range(len(keywords))) + [99]
+
+  # the mode is saved with the table
+  stream = StringIO()
+  assert mydict.save(stream) == True
+  loaded = PphHashTable()
+  assert loaded.load(BytesIO(stream.getvalue().encode('utf-8'))) == True
+  assert loaded.fold_case == True
+  assert loaded["group"] == keywords.index("Group")
+
+  assert pickle.loads(pickle.dumps(mydict))["HAVING"] == keywords.index("Having")
+
+  # other tables are case-sensitive
+  plain = PphHashTable()
+  assert plain.build(keywords) == True
+  assert plain.fold_case == False
+  assert "select" not in plain
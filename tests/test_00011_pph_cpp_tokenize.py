@@ -0,0 +1,40 @@
+import numpy as np
+import pytest
+from pph import PphHashTable
+
+keywords = ["SELECT", "FROM", "WHERE", "GROUP", "ORDER", "BY", "HAVING", "LIMIT"]
+
+# split text into tokens and look them up
+def test_00011():
+  mydict = PphHashTable()
+  assert mydict.build(keywords) == True
+
+  sql = "SELECT a_1, b FROM t WHERE x = 'WHERE';\n"
+  tokens = mydict.tokenize(sql, miss=99)
+  assert tokens.dtype == np.uint64
+  assert tokens.tolist() == [[0, 6, 0], [7, 3, 99], [12, 1, 99], [14, 4, 1], [19, 1, 99],
+                             [21, 5, 2], [27, 1, 99], [32, 5, 2]]
+
+  # bytes-like text and other character classes
+  assert mydict.tokenize(sql.encode('utf-8'), miss=99).tolist() == tokens.tolist()
+  assert mydict.tokenize(memoryview(b"GROUP,BY;ORDER"), token_chars="^,;").tolist() == \
+         [[0, 5, 3], [6, 2, 5], [9, 5, 4]]
+  with pytest.raises(ValueError):
+    mydict.tokenize(memoryview(sql.encode('utf-8'))[::2])
+
+  # blocks of text longer than a batch of lookups
+  text = sql * 500
+  many = mydict.tokenize(text, miss=99)
+  assert many.shape == (8 * 500, 3)
+  assert np.array_equal(many[8:16, 0] - len(sql), tokens[:, 0])
+  for offset, length, value in many[::37]:
+    token = text[offset:offset + length]
+    assert value == (keywords.index(token) if token in keywords else 99)
+
+  assert mydict.tokenize("").shape == (0, 3)
+
+  with pytest.raises(ValueError):
+    mydict.tokenize(sql, token_chars="z-a")
+
+  with pytest.raises(ValueError):
+    PphHashTable().tokenize(sql)
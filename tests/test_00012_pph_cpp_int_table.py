@@ -0,0 +1,83 @@
+import pickle
+import threading
+import numpy as np
+import pytest
+from pph import PphIntTable
+
+# 64-bit integer keys
+def test_00012():
+  rng = np.random.default_rng(12)
+  ids = np.unique(rng.integers(0, 2**64 - 1, size=20000, dtype=np.uint64, endpoint=True))
+  rng.shuffle(ids)
+
+  table = PphIntTable()
+  assert table.build(ids) == True
+  assert len(table) == len(ids)
+  assert table.nbytes > 0
+  for i in range(0, len(ids), 97):
+    assert table[int(ids[i])] == i
+    assert int(ids[i]) in table
+
+  missing = np.setdiff1d(rng.integers(0, 2**64 - 1, size=1000, dtype=np.uint64, endpoint=True), ids)
+  assert not any(int(k) in table for k in missing)
+  with pytest.raises(KeyError):
+    table[int(missing[0])]
+
+  assert np.array_equal(table.lookup_many(ids), np.arange(len(ids), dtype=np.uint64))
+  assert np.all(table.lookup_many(missing, miss=7) == 7)
+  assert table.lookup_many(ids[:6].reshape(2, 3)).shape == (2, 3)
+
+  # a built table cannot be built again
+  assert table.build(ids) == False
+
+  # values, small keys and Python lists
+  small = PphIntTable()
+  assert small.build([0, 1, 5, 2**63], values=[10, 11, 15, 99]) == True
+  assert [small[k] for k in [0, 1, 5, 2**63]] == [10, 11, 15, 99]
+  assert 2 not in small
+
+  # duplicate keys
+  assert PphIntTable().build([3, 4, 3]) == False
+
+  with pytest.raises(ValueError):
+    PphIntTable().build([1, 2], values=[1])
+
+  # serialized tables
+  data = table.to_bytes()
+  copy = PphIntTable.from_bytes(data)
+  assert np.array_equal(copy.lookup_many(ids), np.arange(len(ids), dtype=np.uint64))
+  assert pickle.loads(pickle.dumps(small))[2**63] == 99
+
+  # a flipped bit in the contents, or in the seed, n or s of the header
+  for offset in [len(data) // 2, 16, 24, 32]:
+    corrupt = bytearray(data)
+    corrupt[offset] ^= 1
+    with pytest.raises(ValueError):
+      PphIntTable.from_bytes(corrupt)
+
+  with pytest.raises(ValueError):
+    PphIntTable.from_bytes(memoryview(data + data)[::2])
+
+  # an unbuilt table has nothing to read
+  empty = PphIntTable()
+  with pytest.raises(ValueError):
+    0 in empty
+  with pytest.raises(ValueError):
+    empty.lookup_many([0])
+  assert len(empty) == 0
+
+  # reads from other threads raise until the built table is in place
+  many    = np.arange(1, 2**63, 2**63 // 1000000, dtype=np.uint64)
+  table   = PphIntTable()
+  results = []
+  worker  = threading.Thread(target=lambda: results.append(table.build(many)))
+  worker.start()
+  while worker.is_alive():
+    for read in [lambda: table[int(many[1])], lambda: table.lookup_many(many[:10]), lambda: len(table)]:
+      try:
+        read()
+      except ValueError:
+        pass
+  worker.join()
+  assert results == [True]
+  assert np.array_equal(table.lookup_many(many[:10]), np.arange(10, dtype=np.uint64))
@@ -0,0 +1,82 @@
+import hashlib
+import pickle
+import threading
+import numpy as np
+import pytest
+from pph import PphFingerprintTable, PphIntTable
+
+def fingerprint(key):
+  return int.from_bytes(hashlib.blake2b(key.encode(), digest_size=16).digest(), "big")
+
+def rows(fingerprints):
+  return np.array([[f >> 64, f & (2**64 - 1)] for f in fingerprints], dtype=np.uint64)
+
+# tables built from fingerprints computed before the keys reach the table
+def test_00013():
+  keys = ["key%d" % i for i in range(20000)]
+  prints = [fingerprint(k) for k in keys]
+
+  table = PphFingerprintTable()
+  assert table.build(rows(prints)) == True
+  assert len(table) == len(keys)
+  assert table.nbytes > 0
+  for i in range(0, len(keys), 89):
+    assert table[prints[i]] == i
+    assert prints[i] in table
+
+  assert fingerprint("not a key") not in table
+  assert -1 not in table
+  assert 2**128 not in table
+  with pytest.raises(KeyError):
+    table[fingerprint("not a key")]
+
+  assert np.array_equal(table.lookup_many(rows(prints)), np.arange(len(keys), dtype=np.uint64))
+  assert np.all(table.lookup_many(rows([fingerprint("x"), fingerprint("y")]), miss=5) == 5)
+  with pytest.raises(ValueError):
+    table.lookup_many(np.zeros(6, dtype=np.uint64))
+
+  # fingerprints that differ in one half only
+  halves = PphFingerprintTable()
+  assert halves.build(rows([1 << 64 | 2, 1 << 64 | 3, 4 << 64 | 2]), values=[7, 8, 9]) == True
+  assert [halves[f] for f in [1 << 64 | 2, 1 << 64 | 3, 4 << 64 | 2]] == [7, 8, 9]
+  assert (4 << 64 | 3) not in halves
+
+  copy = PphFingerprintTable.from_bytes(table.to_bytes())
+  assert copy[prints[123]] == 123
+  with pytest.raises(ValueError):
+    PphFingerprintTable.from_bytes(memoryview(table.to_bytes() * 2)[::2])
+  copy = pickle.loads(pickle.dumps(table))
+  assert np.array_equal(copy.lookup_many(rows(prints[:100])), np.arange(100, dtype=np.uint64))
+  with pytest.raises(ValueError):
+    ids = PphIntTable()
+    ids.build([1, 2, 3])
+    PphFingerprintTable.from_bytes(ids.to_bytes())
+
+  # equal fingerprints are reported by position
+  repeated = PphFingerprintTable()
+  assert repeated.build(rows(prints[:10] + [prints[3], prints[7], prints[3]])) == False
+  assert repeated.collisions().tolist() == [[3, 10], [7, 11], [10, 12]]
+  assert len(repeated) == 0
+  assert table.collisions().shape == (0, 2)
+
+  ids = PphIntTable()
+  assert ids.build([5, 9, 5, 12]) == False
+  assert ids.collisions().tolist() == [[0, 2]]
+
+  # reads from other threads raise until the built table is in place
+  with pytest.raises(ValueError):
+    fingerprint("a") in PphFingerprintTable()
+  many    = np.random.default_rng(13).integers(0, 2**64 - 1, size=(1000000, 2), dtype=np.uint64, endpoint=True)
+  table   = PphFingerprintTable()
+  results = []
+  worker  = threading.Thread(target=lambda: results.append(table.build(many)))
+  worker.start()
+  while worker.is_alive():
+    for read in [lambda: table[1], lambda: table.lookup_many(many[:10]), lambda: len(table)]:
+      try:
+        read()
+      except (KeyError, ValueError):
+        pass
+  worker.join()
+  assert results == [True]
+  assert np.array_equal(table.lookup_many(many[:10]), np.arange(10, dtype=np.uint64))
@@ -0,0 +1,141 @@
+/*
+ * Copyright 2017 Rene Sugar
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ *
+ */
+
+/**
+ * @file	wyhash.h
+ * @author	Rene Sugar <rene.sugar@gmail.com>
+ * @brief	Word-at-a-time key function based on wyhash
+ *
+ * Copyright (c) 2017 Rene Sugar.  All rights reserved.
+ **/
+
+#ifndef _WYHASH_H
+#define _WYHASH_H
+
+// wyhash (final version 4) by Wang Yi, released into the public domain
+// (The Unlicense). Reads 4, 8 or 16 bytes per step and mixes them with
+// a 64x64->128 bit multiply.
+//
+// https://github.com/wangyi-fudan/wyhash
+
+static constexpr uint64_t WYHASH_SECRET[4] = {
+  UINT64_C(0x2d358dccaa6c78a5), UINT64_C(0x8bb84b93962eacc9),
+  UINT64_C(0x4b33a62ed433d4a3), UINT64_C(0x4d5a2da51de1aa47)
+};
+
+inline void wy_mum(uint64_t* a, uint64_t* b) {
+#if defined(__SIZEOF_INT128__)
+  __uint128_t r = *a;
+  r *= *b;
+  *a = static_cast<uint64_t>(r);
+  *b = static_cast<uint64_t>(r >> 64);
+#else
+  uint64_t ha = *a >> 32, hb = *b >> 32, la = static_cast<uint32_t>(*a), lb = static_cast<uint32_t>(*b);
+  uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+  uint64_t t = rl + (rm0 << 32), c = t < rl;
+  uint64_t lo = t + (rm1 << 32);
+  c += lo < t;
+  uint64_t hi = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+  *a = lo;
+  *b = hi;
+#endif
+}
+
+inline uint64_t wy_mix(uint64_t a, uint64_t b) {
+  wy_mum(&a, &b);
+  return a ^ b;
+}
+
+inline uint64_t wy_r8(const uint8_t* p) {
+  uint64_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t wy_r4(const uint8_t* p) {
+  uint32_t v;
+  std::memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+inline uint64_t wy_r3(const uint8_t* p, size_t k) {
+  return (static_cast<uint64_t>(p[0]) << 16) | (static_cast<uint64_t>(p[k >> 1]) << 8) | p[k - 1];
+}
+
+inline uint64_t wyhash(const char* key, size_t len, uint64_t seed) {
+  const uint8_t*  p      = reinterpret_cast<const uint8_t*>(key);
+  const uint64_t* secret = WYHASH_SECRET;
+  uint64_t        a      = 0;
+  uint64_t        b      = 0;
+
+  seed ^= wy_mix(seed ^ secret[0], secret[1]);
+
+  if (len <= 16) {
+    if (len >= 4) {
+      a = (wy_r4(p) << 32) | wy_r4(p + ((len >> 3) << 2));
+      b = (wy_r4(p + len - 4) << 32) | wy_r4(p + len - 4 - ((len >> 3) << 2));
+    } else if (len > 0) {
+      a = wy_r3(p, len);
+      b = 0;
+    }
+  } else {
+    size_t i = len;
+
+    if (i > 48) {
+      uint64_t see1 = seed;
+      uint64_t see2 = seed;
+
+      do {
+        seed = wy_mix(wy_r8(p) ^ secret[1], wy_r8(p + 8) ^ seed);
+        see1 = wy_mix(wy_r8(p + 16) ^ secret[2], wy_r8(p + 24) ^ see1);
+        see2 = wy_mix(wy_r8(p + 32) ^ secret[3], wy_r8(p + 40) ^ see2);
+        p += 48;
+        i -= 48;
+      } while (i > 48);
+
+      seed ^= see1 ^ see2;
+    }
+
+    while (i > 16) {
+      seed = wy_mix(wy_r8(p) ^ secret[1], wy_r8(p + 8) ^ seed);
+      i -= 16;
+      p += 16;
+    }
+
+    a = wy_r8(p + i - 16);
+    b = wy_r8(p + i - 8);
+  }
+
+  a ^= secret[1];
+  b ^= seed;
+  wy_mum(&a, &b);
+
+  return wy_mix(a ^ secret[0] ^ len, b ^ secret[1]);
+}
+
+// The multiplier is used as the seed.
+inline uint64_t wy_hash_buf(const char* data, size_t len, uint64_t multiplier, uint64_t adjustment) {
+  return wyhash(data, len, multiplier) + adjustment;
+}
+
+// UUID: AFC54786-F95B-4560-834E-F75B07ED715B
+uint64_t wy_hash(const std::string& str, uint64_t multiplier, uint64_t adjustment) {
+  return wy_hash_buf(str.data(), str.size(), multiplier, adjustment);
+}
+
+#endif  // _WYHASH_H